@@ -17,8 +17,8 @@ Universita' degli Studi di Milano
 
 // vertex position in world coordinates
 layout (location = 0) in vec3 position;
-// vertex normal in world coordinate
-layout (location = 1) in vec3 normal;
+// vertex normal in world coordinate, octahedral encoded (see Vertex::SetNormal)
+layout (location = 1) in vec2 encodedNormal;
 
 // model matrix
 uniform mat4 modelMatrix;
@@ -40,6 +40,16 @@ out vec3 lightDir;
 // this means that the normal values in each vertex will be interpolated on each fragment created during rasterization between two vertices
 out vec3 vNormal;
 
+// the octahedron is unfolded back to the unit sphere: the points of its lower half were folded over the upper one
+vec3 decodeNormal(vec2 e)
+{
+  vec3 n = vec3( e.x, e.y, 1.0 - abs( e.x ) - abs( e.y ) );
+  float fold = max( -n.z, 0.0 );
+  n.x += n.x >= 0.0 ? -fold : fold;
+  n.y += n.y >= 0.0 ? -fold : fold;
+  return normalize( n );
+}
+
 void main()
 {
   // vertex position in ModelView coordinate (see the last line for the application of projection)
@@ -51,7 +61,7 @@ void main()
   lightDir = lightPos.xyz - mvPosition.xyz;
 
   // transformations are applied to the normal
-  vNormal = normalize( normalMatrix * normal );
+  vNormal = normalize( normalMatrix * decodeNormal( encodedNormal ) );
 
   // we apply the projection transformation
   gl_Position = projectionMatrix * mvPosition;
@@ -7,6 +7,8 @@ the scene object methods(inside the draw loop).
     #define __USE_MINGW_ANSI_STDIO 0
 #endif
 #include <list>
+#include <new>
+#include <atomic>
 #include <time.h>
 #include <string>
 #include <cstdlib>
@@ -22,29 +24,91 @@ the scene object methods(inside the draw loop).
 #include <utils/model.h>
 #include <utils/physics.h>
 #include <utils/scene.h>
+#include <utils/stream.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #define N_MODELS 15
+//The swipe is sampled each time the cursor moves by this distance in ndc space, up to a maximum number of points.
+#define SWIPE_SAMPLE_DISTANCE 0.03f
+#define MAX_SWIPE_POINTS 256
+//Rounds of cuts of GL_Ninja --check-arenas; the first one warms the arenas up.
+#define ARENA_CHECK_ROUNDS 4
 
 GLuint screenWidth = 1280, screenHeight = 720;
 void drawIndicatorLine(Shader lineShader);
 void calculateCutNDCCoordinates(int i);
+vector<SwipePoint> currentSwipe();
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void bakeFractures(const vector<string> & paths);
+bool checkArenas(const vector<string> & paths);
+int streamCut(int argc, char** argv);
 bool stop=false;
 bool pressing = false;
 bool cut=false;
+bool asyncCut=true;
+bool speculativeCut=true;
+bool decimation=true;
+bool preFracture=true;
+bool slabCut=false;
 GLboolean wireframe = GL_FALSE;
 unsigned int VAOCut, VBOCut;
 bool keys[1024];
 glm::vec3 cutVerticesNDC[] = {glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 0.f, 1.f)};
+//The points sampled while the mouse button is held; the current position of the cursor is not included.
+vector<SwipePoint> swipe;
 GLFWwindow* window;
+//Calls of the global operator new while newCounting is set: GL_Ninja --check-arenas sets it once the cutter has been warmed up.
+atomic<bool> newCounting(false);
+atomic<size_t> newCount(0);
 
-int main()
+//The global operator new, replaced so that the arena check can count its calls; operator new[] and the sized and array
+//deletes call these ones.
+void* operator new(size_t size)
 {
+	if(newCounting.load(memory_order_relaxed))
+		newCount++;
+	void* block=malloc(size>0? size : 1);
+	if(!block)
+		throw bad_alloc();
+	return block;
+}
+
+void operator delete(void* block) noexcept
+{
+	free(block);
+}
+
+//GL_Ninja --bake [models...] bakes the fracture and the mesh file of the given models (all the ones of the application, if
+//none is given) next to their OBJ files, then exits; the window is hidden, since loading the models needs a GL context.
+//GL_Ninja --check-arenas [models...] repeats the same cuts of the given models, and fails if the arenas of the cutter still
+//take memory from the heap once they have been warmed up (see Arena), or if anything calls operator new meanwhile.
+//GL_Ninja --stream-cut <file.mesh> nx ny nz px py pz cuts a baked mesh file by the plane of normal n through p (see streamCut).
+int main(int argc, char** argv)
+{
+	//These are the models cyclically loaded in the application.
+	array<string, N_MODELS> modelPaths={"../../models/car.obj",
+										"../../models/cube.obj",
+										"../../models/rook.obj",
+										"../../models/pedestal.obj",
+										"../../models/horse.obj",
+										"../../models/icosphere.obj",
+										"../../models/bishop.obj",
+										"../../models/cylinder.obj",
+										"../../models/pawn.obj",
+										"../../models/cone.obj",
+										"../../models/barrel.obj",
+										"../../models/king.obj",
+										"../../models/sphere.obj",
+										"../../models/queen.obj",
+										"../../models/monkey.obj"};
+	bool bake=argc>1 && string(argv[1])=="--bake";
+	bool check=argc>1 && string(argv[1])=="--check-arenas";
+	if(argc>1 && string(argv[1])=="--stream-cut")
+		return streamCut(argc, argv);
 	srand(time(0));
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -52,6 +116,8 @@ int main()
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+	if(bake || check)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 	
     window = glfwCreateWindow(screenWidth, screenHeight, "GL_Ninja", nullptr, nullptr);
     if (!window)
@@ -69,6 +135,20 @@ int main()
         std::cout << "Failed to initialize OpenGL context" << std::endl;
         return -1;
     }
+	
+	if(bake || check)
+	{
+		vector<string> paths(argv+2, argv+argc);
+		if(paths.empty())
+			paths.assign(modelPaths.begin(), modelPaths.end());
+		bool passed=true;
+		if(bake)
+			bakeFractures(paths);
+		else
+			passed=checkArenas(paths);
+		glfwTerminate();
+		return passed? 0 : -1;
+	}
 
     glViewport(0, 0, screenWidth, screenHeight);
 
@@ -80,23 +160,6 @@ int main()
 	
 	glm::mat4 projection = glm::perspective(45.0f, (float)screenWidth/(float)screenHeight, 0.1f, 15.0f);
 	glm::mat4 view = glm::lookAt(glm::vec3(0.f, 0.f, 7.f), glm::vec3(0.f, 0.f, 6.f), glm::vec3(0.f, 1.f, 0.f));
-	//These are the models cyclically loaded in the application.
-	array<string, N_MODELS> modelPaths={"../../models/car.obj",
-										"../../models/cube.obj",
-										"../../models/rook.obj",
-										"../../models/pedestal.obj",
-										"../../models/horse.obj",
-										"../../models/icosphere.obj",
-										"../../models/bishop.obj",
-										"../../models/cylinder.obj",
-										"../../models/pawn.obj",
-										"../../models/cone.obj",
-										"../../models/barrel.obj",
-										"../../models/king.obj",
-										"../../models/sphere.obj",
-										"../../models/queen.obj",
-										"../../models/monkey.obj"};
-										
 	int modelIndex=0;
 	
 	Scene scene=Scene(projection, view);
@@ -109,7 +172,7 @@ int main()
 	glGenBuffers(1, &VBOCut);
 	glBindVertexArray(VAOCut);
 	glBindBuffer(GL_ARRAY_BUFFER, VBOCut);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cutVerticesNDC), cutVerticesNDC, GL_DYNAMIC_DRAW);		
+	glBufferData(GL_ARRAY_BUFFER, MAX_SWIPE_POINTS*sizeof(glm::vec3), NULL, GL_DYNAMIC_DRAW);		
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 	glEnableVertexAttribArray(0);  
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -147,6 +210,11 @@ int main()
 			startTime=glfwGetTime();
 		}
 		
+		//The cuts completed in background are committed before the simulation step, so the new pieces are simulated from this frame on.
+		scene.SetDecimation(decimation);
+		scene.SetPreFracture(preFracture);
+		scene.SetSlabCut(slabCut);
+		scene.CommitCuts();
 		if(!stop)
 			scene.SimulationStep();
 			
@@ -157,22 +225,36 @@ int main()
 			modelIndex = modelIndex%N_MODELS;
 		}
 		
-		//By pressing the right mouse button, the line shader draws a line segment between two points in ndc space.
+		//By pressing the right mouse button, the line shader draws the swipe: a polyline in ndc space, from the first point
+		//to the cursor.
 		if(pressing)
 		{		
 			calculateCutNDCCoordinates(1);
+			if(glm::distance(swipe.back().positionNDC, cutVerticesNDC[1])>=SWIPE_SAMPLE_DISTANCE && swipe.size()<MAX_SWIPE_POINTS-1)
+			{
+				SwipePoint point={cutVerticesNDC[1], glfwGetTime()};
+				swipe.push_back(point);
+			}
+			vector<SwipePoint> swipePoints=currentSwipe();
+			//Meanwhile, the meshes crossed by the swipe are cut in background, so the cut is often ready on release.
+			scene.SetSpeculativeCut(speculativeCut);
+			scene.UpdateSpeculativeCut(swipePoints);
+			vector<glm::vec3> lineVertices(swipePoints.size());
+			for(unsigned int i=0;i<swipePoints.size();i++)
+				lineVertices[i]=swipePoints[i].positionNDC;
 			lineShader.Use();
 			glBindVertexArray(VAOCut);
 			glBindBuffer(GL_ARRAY_BUFFER, VBOCut);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(cutVerticesNDC), cutVerticesNDC);	
-			glDrawArrays(GL_LINES, 0, 2);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, lineVertices.size()*sizeof(glm::vec3), lineVertices.data());	
+			glDrawArrays(GL_LINE_STRIP, 0, lineVertices.size());
 		}
 		else if(cut)
 		{
 			//By releasing the right mouse button, the application tries to perform a cut, passing to the cut method
-			//the cut points that define the cut segment.
+			//the points of the swipe.
 			cut=false;
-			scene.Cut(cutVerticesNDC[0], cutVerticesNDC[1]);
+			scene.SetAsyncCut(asyncCut);
+			scene.Cut(currentSwipe());
 		}
 		scene.DrawScene();
         glfwSwapBuffers(window);
@@ -180,6 +262,7 @@ int main()
 	
 	printf("Min fps %d\n",minFps);
 	printf("Max fps %d\n",maxFps);
+	printf("Grazes %u\n",scene.GetGrazes());
 	glDeleteVertexArrays(1, &VAOCut);
     glDeleteBuffers(1, &VBOCut);
 	scene.Clear();
@@ -198,6 +281,21 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	
 	if(key == GLFW_KEY_SPACE && action == GLFW_PRESS)
 		stop=!stop;
+	
+	if(key == GLFW_KEY_A && action == GLFW_PRESS)
+		asyncCut=!asyncCut;
+	
+	if(key == GLFW_KEY_S && action == GLFW_PRESS)
+		speculativeCut=!speculativeCut;
+	
+	if(key == GLFW_KEY_D && action == GLFW_PRESS)
+		decimation=!decimation;
+	
+	if(key == GLFW_KEY_F && action == GLFW_PRESS)
+		preFracture=!preFracture;
+	
+	if(key == GLFW_KEY_G && action == GLFW_PRESS)
+		slabCut=!slabCut;
 		
     if(action == GLFW_PRESS)
         keys[key] = true;
@@ -216,12 +314,27 @@ void calculateCutNDCCoordinates(int i)
 	cutVerticesNDC[i]=glm::vec3(2.0f*(x/screenWidth) - 1.0f, (-1)*2.0f*(y/screenHeight) + 1.0f, 0);
 }
 
+//The sampled points of the swipe, followed by the last position of the cursor.
+vector<SwipePoint> currentSwipe()
+{
+	vector<SwipePoint> swipePoints=swipe;
+	if(!swipePoints.empty() && swipePoints.back().positionNDC!=cutVerticesNDC[1])
+	{
+		SwipePoint point={cutVerticesNDC[1], glfwGetTime()};
+		swipePoints.push_back(point);
+	}
+	return swipePoints;
+}
+
 //This callback function handles mouse inputs (right mouse button pressing and release).
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
 	{
 		calculateCutNDCCoordinates(0);
+		cutVerticesNDC[1]=cutVerticesNDC[0];
+		SwipePoint point={cutVerticesNDC[0], glfwGetTime()};
+		swipe.assign(1, point);
 		pressing=true;
 	}
 	else if(button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE)
@@ -229,4 +342,120 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 		pressing=false;
 		cut=true;
 	}
-}
\ No newline at end of file
+}
+
+//Bakes the fracture of each model and saves it next to its OBJ file, where Scene::AddMesh looks for it.
+void bakeFractures(const vector<string> & paths)
+{
+	ThreadPool threadPool;
+	for(unsigned int i=0;i<paths.size();i++)
+	{
+		Model model(paths[i]);
+		if(model.meshes.size()!=1)
+		{
+			cout << "Skipping " << paths[i] << ": only models made of a single mesh are baked" << endl;
+			if(!model.meshes.empty())
+				delete model.shape;
+			continue;
+		}
+		FractureBaker baker;
+		baker.Bake(model.meshes[0], model.shape, &threadPool);
+		string bakedPath=FractureHierarchy::BakedPath(paths[i]);
+		if(baker.Hierarchy().Save(bakedPath))
+			printf("Baked %s: pieces %d, vertices %d\n", bakedPath.c_str(), (int)baker.Hierarchy().nodes.size()-1, (int)baker.Hierarchy().pool->vertices.size());
+		else
+			cout << "Failed to write " << bakedPath << endl;
+		vector<Vertex> scratch;
+		const Mesh & mesh=model.meshes[0];
+		string meshPath=MeshWriter::BakedPath(paths[i]);
+		if(!MeshWriter::Write(meshPath, mesh.LocalVertices(scratch), mesh.vertexCount, mesh.indices.data(), mesh.indices.size(), mesh.attributes))
+			cout << "Failed to write " << meshPath << endl;
+		delete model.shape;
+	}
+}
+
+//Cuts each mesh of the models by the same planes through its center, ARENA_CHECK_ROUNDS times, by Mesh::CutGeometry with the
+//same cutter and the same result; the first round warms the arenas up, and the others must not take any block from the heap
+//nor call operator new.
+bool checkArenas(const vector<string> & paths)
+{
+	const glm::vec3 normals[]={glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(1.f, 1.f, 0.f),
+								glm::vec3(0.f, 1.f, 1.f), glm::vec3(1.f, 0.f, 1.f), glm::vec3(1.f, 1.f, 1.f), glm::vec3(1.f, -2.f, 3.f)};
+	bool passed=true;
+	for(unsigned int i=0;i<paths.size();i++)
+	{
+		Model model(paths[i]);
+		for(unsigned int m=0;m<model.meshes.size();m++)
+		{
+			Mesh & mesh=model.meshes[m];
+			vector<Vertex> scratch;
+			const Vertex* vertices=mesh.LocalVertices(scratch);
+			glm::vec3 center(0.0f);
+			for(size_t v=0;v<mesh.vertexCount;v++)
+				center+=vertices[v].Position/(float)mesh.vertexCount;
+			MeshCutter cutter;
+			CutResult result;
+			size_t warmAllocations=0;
+			newCount=0;
+			for(int round=0;round<ARENA_CHECK_ROUNDS;round++)
+			{
+				for(unsigned int n=0;n<sizeof(normals)/sizeof(normals[0]);n++)
+				{
+					CutPlane plane;
+					plane.normal=glm::normalize(normals[n]);
+					plane.point=center;
+					mesh.CutGeometry(cutter, result, plane);
+				}
+				if(round==0)
+				{
+					warmAllocations=Arena::GetHeapAllocationCount();
+					newCounting=true;
+				}
+			}
+			newCounting=false;
+			size_t allocations=Arena::GetHeapAllocationCount()-warmAllocations;
+			printf("%s, mesh %u: %d arena blocks allocated, %d calls of operator new after warm-up\n", paths[i].c_str(), m, (int)allocations, (int)newCount.load());
+			passed=passed && allocations==0 && newCount==0;
+		}
+		if(!model.meshes.empty())
+			delete model.shape;
+	}
+	cout << (passed? "Arena check passed" : "Arena check failed") << endl;
+	return passed;
+}
+
+//Cuts a baked mesh file without loading it (see StreamingCutter), writing the sides next to it as <name>.positive.mesh and
+//<name>.negative.mesh; no GL context is needed.
+int streamCut(int argc, char** argv)
+{
+	if(argc!=9)
+	{
+		cout << "Usage: GL_Ninja --stream-cut <file.mesh> nx ny nz px py pz" << endl;
+		return -1;
+	}
+	string path=argv[2];
+	CutPlane plane;
+	plane.normal=glm::normalize(glm::vec3(atof(argv[3]), atof(argv[4]), atof(argv[5])));
+	plane.point=glm::vec3(atof(argv[6]), atof(argv[7]), atof(argv[8]));
+	MeshReader reader;
+	if(!reader.Open(path))
+		return -1;
+	string base=path.substr(0, path.find_last_of('.'));
+	StreamingCutter cutter;
+	CutResult result;
+	if(!cutter.Cut(reader, plane, base+".positive.mesh", base+".negative.mesh", result))
+	{
+		cout << "Failed to cut " << path << endl;
+		return -1;
+	}
+	if(result.grazed)
+	{
+		printf("The plane doesn't cross %s\n", path.c_str());
+		return 0;
+	}
+	const CutSide* sides[2]={&result.positive, &result.negative};
+	for(int s=0;s<2;s++)
+		printf("%s side: area %f, volume %f, centroid (%f, %f, %f), hull points %d\n", s==0? "Positive" : "Negative", sides[s]->area, sides[s]->volume,
+			sides[s]->centroid.x, sides[s]->centroid.y, sides[s]->centroid.z, (int)sides[s]->hullPoints.size());
+	return 0;
+}
@@ -38,8 +38,8 @@ positive Z axis points "outside" the screen
 
 // vertex position in world coordinates
 layout (location = 0) in vec3 position;
-// vertex normal in world coordinate
-layout (location = 1) in vec3 normal;
+// vertex normal in world coordinate, octahedral encoded (see Vertex::SetNormal)
+layout (location = 1) in vec2 encodedNormal;
 // UV coordinates
 layout (location = 2) in vec2 UV;
 
@@ -71,6 +71,16 @@ out vec3 vViewPosition;
 out vec2 interp_UV;
 
 
+// the octahedron is unfolded back to the unit sphere: the points of its lower half were folded over the upper one
+vec3 decodeNormal(vec2 e)
+{
+  vec3 n = vec3( e.x, e.y, 1.0 - abs( e.x ) - abs( e.y ) );
+  float fold = max( -n.z, 0.0 );
+  n.x += n.x >= 0.0 ? -fold : fold;
+  n.y += n.y >= 0.0 ? -fold : fold;
+  return normalize( n );
+}
+
 void main(){
 
   // vertex position in ModelView coordinate (see the last line for the application of projection)
@@ -81,7 +91,7 @@ void main(){
   vViewPosition = -mvPosition.xyz;
 
   // transformations are applied to the normal
-  vNormal = normalize( normalMatrix * normal );
+  vNormal = normalize( normalMatrix * decodeNormal( encodedNormal ) );
 
   // light incidence directions for all the lights (in view coordinate)
   for (int i=0;i<NR_LIGHTS;i++)
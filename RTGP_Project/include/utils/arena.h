@@ -0,0 +1,202 @@
+/*
+Arena class:
+A monotonic allocator for the scratch data of a cut. Memory is taken from large blocks by moving an offset, and it is all released
+at once by Reset, which keeps the blocks for the next cut; so, once the blocks have grown to the size needed by the cuts, a cut
+doesn't allocate heap memory for its scratch data anymore. Only trivially destructible types can be stored, since nothing is
+destroyed on Reset.
+ArenaHashMap class:
+An open addressing hash table (linear probing) whose slots are taken from an arena; it replaces the node based unordered_map,
+which allocates each element on its own. Elements can't be removed, and the table is valid until the arena is reset.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+
+//Minimum size of a block of an arena, in bytes.
+#define ARENA_BLOCK_SIZE (1<<20)
+
+class Arena
+{
+public:
+	Arena(): current(0), offset(0) {}
+	~Arena()
+	{
+		for(unsigned int i=0;i<blocks.size();i++)
+			free(blocks[i].data);
+	}
+	Arena(const Arena &)=delete;
+	Arena & operator=(const Arena &)=delete;
+
+	//Uninitialised memory for count objects of type T, valid until the next Reset.
+	template<class T>
+	T* Allocate(size_t count)
+	{
+		static_assert(is_trivially_destructible<T>::value, "Objects in an arena are never destroyed");
+		return (T*)AllocateBytes(count*sizeof(T), alignof(T));
+	}
+	//Releases everything allocated so far; the blocks are kept.
+	void Reset()
+	{
+		current=0;
+		offset=0;
+	}
+	//Number of blocks taken from the heap by all the arenas since the start of the program: once the cuts reach their steady
+	//state, it doesn't grow anymore.
+	static size_t GetHeapAllocationCount()
+	{
+		return HeapAllocations().load();
+	}
+
+private:
+	struct Block
+	{
+		char* data;
+		size_t size;
+	};
+
+	vector<Block> blocks;
+	size_t current;
+	size_t offset;
+
+	static atomic<size_t> & HeapAllocations()
+	{
+		static atomic<size_t> heapAllocations(0);
+		return heapAllocations;
+	}
+	void* AllocateBytes(size_t size, size_t alignment)
+	{
+		for(;current<blocks.size();current++,offset=0)
+		{
+			size_t start=(offset+alignment-1) & ~(alignment-1);
+			if(start+size<=blocks[current].size)
+			{
+				offset=start+size;
+				return blocks[current].data+start;
+			}
+		}
+		//The blocks are aligned by malloc to the largest fundamental alignment, which is enough for all the stored types.
+		Block block;
+		block.size=size>ARENA_BLOCK_SIZE? size : ARENA_BLOCK_SIZE;
+		block.data=(char*)malloc(block.size);
+		blocks.push_back(block);
+		HeapAllocations()++;
+		current=blocks.size()-1;
+		offset=size;
+		return block.data;
+	}
+};
+
+template<class K, class V, class H=hash<K>>
+class ArenaHashMap
+{
+public:
+	ArenaHashMap(): arena(nullptr), slots(nullptr), capacity(0), bits(0), size(0) {}
+
+	//Empties the table, taking from the arena room for about expectedCount elements.
+	void Reset(Arena* arena, size_t expectedCount)
+	{
+		this->arena=arena;
+		size_t minCapacity=expectedCount*2;
+		bits=4;
+		while(((size_t)1<<bits)<minCapacity)
+			bits++;
+		capacity=(size_t)1<<bits;
+		slots=NewSlots(capacity);
+		size=0;
+	}
+	V* Find(const K & key)
+	{
+		for(size_t i=Index(key);slots[i].used;i=(i+1) & (capacity-1))
+			if(slots[i].key==key)
+				return &slots[i].value;
+		return nullptr;
+	}
+	//Returns the value of the key, adding it (with an uninitialised value) if it is new; isNew tells whether it was added.
+	V & Insert(const K & key, bool & isNew)
+	{
+		if((size+1)*2>capacity)
+			Grow();
+		size_t i=Index(key);
+		for(;slots[i].used;i=(i+1) & (capacity-1))
+		{
+			if(slots[i].key==key)
+			{
+				isNew=false;
+				return slots[i].value;
+			}
+		}
+		slots[i].used=true;
+		slots[i].key=key;
+		size++;
+		isNew=true;
+		return slots[i].value;
+	}
+	size_t Size() const
+	{
+		return size;
+	}
+	//Calls function(key, value) for each element, in no particular order.
+	template<class F>
+	void ForEach(F function)
+	{
+		for(size_t i=0;i<capacity;i++)
+			if(slots[i].used)
+				function(slots[i].key, slots[i].value);
+	}
+
+private:
+	struct Slot
+	{
+		K key;
+		V value;
+		bool used;
+	};
+
+	Arena* arena;
+	Slot* slots;
+	size_t capacity;
+	unsigned int bits;
+	size_t size;
+
+	//The hash is spread by a multiplication (Fibonacci hashing), since hashes of integers are often the integers themselves.
+	size_t Index(const K & key) const
+	{
+		uint64_t spread=(uint64_t)H()(key)*0x9E3779B97F4A7C15ULL;
+		return (size_t)(spread>>(64-bits));
+	}
+
+	Slot* NewSlots(size_t count)
+	{
+		Slot* newSlots=arena->Allocate<Slot>(count);
+		for(size_t i=0;i<count;i++)
+			newSlots[i].used=false;
+		return newSlots;
+	}
+	//The old slots stay in the arena until it is reset.
+	void Grow()
+	{
+		Slot* oldSlots=slots;
+		size_t oldCapacity=capacity;
+		bits++;
+		capacity=(size_t)1<<bits;
+		slots=NewSlots(capacity);
+		for(size_t i=0;i<oldCapacity;i++)
+		{
+			if(!oldSlots[i].used)
+				continue;
+			size_t j=Index(oldSlots[i].key);
+			while(slots[j].used)
+				j=(j+1) & (capacity-1);
+			slots[j]=oldSlots[i];
+		}
+	}
+};
@@ -0,0 +1,250 @@
+/*
+PlaneClassifier class:
+This class computes, in a single pass, the signed distance from a plane of every vertex of a mesh.
+The distance of the vertex v from the plane (n, p) is calculated as dot(n, v)-dot(n, p); a positive value means the vertex lies
+in the positive half space.
+The loop is vectorised with SSE2 (4 vertices at a time) or AVX2 (8 vertices at a time); the kernel is chosen at runtime,
+according to the features of the cpu. All kernels perform the same operations in the same order, so they produce the
+same distances.
+The kernels also keep the smallest and the largest distance, so the caller knows for free whether the plane crosses the mesh.
+The sign of the distances is exact, as the sides of the vertices are decided by it: the float distances come with an error
+bound, and the few ones within it from zero are evaluated again with exact arithmetic (see ExactPredicates). So a vertex
+lying almost on the plane is put on the side it really lies on, whatever the order of the float operations.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <stddef.h>
+#include <float.h>
+#include <glm/glm.hpp>
+#include <utils/vertex.h>
+#include <utils/predicates.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+	#define CLASSIFY_SSE2
+	#include <emmintrin.h>
+	#if defined(__GNUC__) || defined(_MSC_VER)
+		#define CLASSIFY_AVX2
+		#include <immintrin.h>
+	#endif
+	#if defined(_MSC_VER) && !defined(__GNUC__)
+		#include <intrin.h>
+	#endif
+#endif
+
+#if defined(__GNUC__)
+	#define CLASSIFY_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+	#define CLASSIFY_TARGET_AVX2
+#endif
+
+//Number of floats between the positions of two consecutive vertices.
+#define VERTEX_STRIDE (sizeof(Vertex)/sizeof(float))
+
+class PlaneClassifier
+{
+public:
+	enum Kernel
+	{
+		KERNEL_SCALAR=0,
+		KERNEL_SSE2=1,
+		KERNEL_AVX2=2
+	};
+
+	//Writes in distances the signed distance of each one of the count vertices from the plane.
+	static void SignedDistances(const Vertex* vertices, size_t count, glm::vec3 planeNormal, glm::vec3 planePoint, float* distances)
+	{
+		float minDistance, maxDistance;
+		SignedDistances(vertices, count, planeNormal, planePoint, distances, minDistance, maxDistance);
+	}
+	//Same as above, also giving the range of the distances; with no vertices, minDistance is FLT_MAX and maxDistance -FLT_MAX.
+	static void SignedDistances(const Vertex* vertices, size_t count, glm::vec3 planeNormal, glm::vec3 planePoint, float* distances, float & minDistance, float & maxDistance)
+	{
+		float planeOffset=glm::dot(planeNormal, planePoint);
+		size_t i=0;
+		minDistance=FLT_MAX;
+		maxDistance=-FLT_MAX;
+		float maxCoordinate=0.0f;
+		switch(GetKernel())
+		{
+#ifdef CLASSIFY_AVX2
+			case KERNEL_AVX2:
+				i=SignedDistancesAVX2(vertices, count, planeNormal, planeOffset, distances, minDistance, maxDistance, maxCoordinate);
+				break;
+#endif
+#ifdef CLASSIFY_SSE2
+			case KERNEL_SSE2:
+				i=SignedDistancesSSE2(vertices, count, planeNormal, planeOffset, distances, minDistance, maxDistance, maxCoordinate);
+				break;
+#endif
+			default:
+				break;
+		}
+		//Remaining vertices
+		for(;i<count;i++)
+		{
+			glm::vec3 position=vertices[i].Position;
+			distances[i]=SignedDistance(position, planeNormal, planeOffset);
+			minDistance=min(minDistance, distances[i]);
+			maxDistance=max(maxDistance, distances[i]);
+			maxCoordinate=max(maxCoordinate, max(glm::abs(position.x), max(glm::abs(position.y), glm::abs(position.z))));
+		}
+		//Filter: a single bound for all vertices, from the largest coordinate of the mesh.
+		glm::vec3 absNormal=glm::abs(planeNormal);
+		float bound=PREDICATE_DISTANCE_ERROR*((absNormal.x+absNormal.y+absNormal.z)*maxCoordinate+glm::dot(absNormal, glm::abs(planePoint)));
+		if(minDistance>bound || maxDistance<-bound)
+			return;
+		bool exact=false;
+		for(i=0;i<count;i++)
+		{
+			if(glm::abs(distances[i])<=bound)
+			{
+				ExactPredicates::PlaneSide(planeNormal, planePoint, vertices[i].Position, distances[i]);
+				exact=true;
+			}
+		}
+		//The smallest or the largest distance may have been one of the ones evaluated again.
+		if(exact && (minDistance>=-bound || maxDistance<=bound))
+		{
+			minDistance=FLT_MAX;
+			maxDistance=-FLT_MAX;
+			for(i=0;i<count;i++)
+			{
+				minDistance=min(minDistance, distances[i]);
+				maxDistance=max(maxDistance, distances[i]);
+			}
+		}
+	}
+	//The kernel is detected once, at the first call.
+	static Kernel GetKernel()
+	{
+		static Kernel kernel=DetectKernel();
+		return kernel;
+	}
+
+private:
+	static Kernel DetectKernel()
+	{
+#if defined(CLASSIFY_AVX2) && defined(__GNUC__)
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+			return KERNEL_AVX2;
+#elif defined(CLASSIFY_AVX2)
+		//AVX2 is bit 5 of EBX in leaf 7; the os must also save the AVX registers (OSXSAVE and AVX in ECX of leaf 1, and the
+		//SSE and AVX states enabled in XCR0).
+		int info[4];
+		__cpuid(info, 0);
+		if(info[0]>=7)
+		{
+			__cpuid(info, 1);
+			bool avx=(info[2] & (1<<27)) && (info[2] & (1<<28)) && (_xgetbv(0) & 6)==6;
+			__cpuidex(info, 7, 0);
+			if(avx && (info[1] & (1<<5)))
+				return KERNEL_AVX2;
+		}
+#endif
+#ifdef CLASSIFY_SSE2
+		return KERNEL_SSE2;
+#else
+		return KERNEL_SCALAR;
+#endif
+	}
+
+	static float SignedDistance(glm::vec3 position, glm::vec3 planeNormal, float planeOffset)
+	{
+		return ((planeNormal.x*position.x+planeNormal.y*position.y)+planeNormal.z*position.z)-planeOffset;
+	}
+
+#ifdef CLASSIFY_SSE2
+	//Each vertex is loaded with a single unaligned load (x, y, z and the first component of the normal);
+	//four of them are then transposed, to get the x, y and z coordinates of four vertices in three registers.
+	static size_t SignedDistancesSSE2(const Vertex* vertices, size_t count, glm::vec3 planeNormal, float planeOffset, float* distances, float & minDistance, float & maxDistance, float & maxCoordinate)
+	{
+		const float* data=(const float*)vertices;
+		__m128 nx=_mm_set1_ps(planeNormal.x);
+		__m128 ny=_mm_set1_ps(planeNormal.y);
+		__m128 nz=_mm_set1_ps(planeNormal.z);
+		__m128 offset=_mm_set1_ps(planeOffset);
+		__m128 low=_mm_set1_ps(minDistance);
+		__m128 high=_mm_set1_ps(maxDistance);
+		__m128 signMask=_mm_set1_ps(-0.0f);
+		__m128 coordinate=_mm_setzero_ps();
+		size_t i=0;
+		for(;i+4<=count;i+=4)
+		{
+			__m128 x=_mm_loadu_ps(data+(i+0)*VERTEX_STRIDE);
+			__m128 y=_mm_loadu_ps(data+(i+1)*VERTEX_STRIDE);
+			__m128 z=_mm_loadu_ps(data+(i+2)*VERTEX_STRIDE);
+			__m128 w=_mm_loadu_ps(data+(i+3)*VERTEX_STRIDE);
+			_MM_TRANSPOSE4_PS(x, y, z, w);
+			__m128 distance=_mm_add_ps(_mm_mul_ps(nx, x), _mm_mul_ps(ny, y));
+			distance=_mm_sub_ps(_mm_add_ps(distance, _mm_mul_ps(nz, z)), offset);
+			_mm_storeu_ps(distances+i, distance);
+			low=_mm_min_ps(low, distance);
+			high=_mm_max_ps(high, distance);
+			coordinate=_mm_max_ps(coordinate, _mm_max_ps(_mm_andnot_ps(signMask, x), _mm_max_ps(_mm_andnot_ps(signMask, y), _mm_andnot_ps(signMask, z))));
+		}
+		minDistance=HorizontalMin(low);
+		maxDistance=HorizontalMax(high);
+		maxCoordinate=HorizontalMax(coordinate);
+		return i;
+	}
+	static float HorizontalMin(__m128 values)
+	{
+		values=_mm_min_ps(values, _mm_shuffle_ps(values, values, _MM_SHUFFLE(1, 0, 3, 2)));
+		values=_mm_min_ps(values, _mm_shuffle_ps(values, values, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(values);
+	}
+	static float HorizontalMax(__m128 values)
+	{
+		values=_mm_max_ps(values, _mm_shuffle_ps(values, values, _MM_SHUFFLE(1, 0, 3, 2)));
+		values=_mm_max_ps(values, _mm_shuffle_ps(values, values, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(values);
+	}
+#endif
+
+#ifdef CLASSIFY_AVX2
+	//Same as the SSE2 kernel, but the low and high lanes hold vertices i..i+3 and i+4..i+7.
+	CLASSIFY_TARGET_AVX2
+	static size_t SignedDistancesAVX2(const Vertex* vertices, size_t count, glm::vec3 planeNormal, float planeOffset, float* distances, float & minDistance, float & maxDistance, float & maxCoordinate)
+	{
+		const float* data=(const float*)vertices;
+		__m256 nx=_mm256_set1_ps(planeNormal.x);
+		__m256 ny=_mm256_set1_ps(planeNormal.y);
+		__m256 nz=_mm256_set1_ps(planeNormal.z);
+		__m256 offset=_mm256_set1_ps(planeOffset);
+		__m256 low=_mm256_set1_ps(minDistance);
+		__m256 high=_mm256_set1_ps(maxDistance);
+		__m256 signMask=_mm256_set1_ps(-0.0f);
+		__m256 coordinate=_mm256_setzero_ps();
+		size_t i=0;
+		for(;i+8<=count;i+=8)
+		{
+			__m256 r0=_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(data+(i+0)*VERTEX_STRIDE)), _mm_loadu_ps(data+(i+4)*VERTEX_STRIDE), 1);
+			__m256 r1=_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(data+(i+1)*VERTEX_STRIDE)), _mm_loadu_ps(data+(i+5)*VERTEX_STRIDE), 1);
+			__m256 r2=_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(data+(i+2)*VERTEX_STRIDE)), _mm_loadu_ps(data+(i+6)*VERTEX_STRIDE), 1);
+			__m256 r3=_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(data+(i+3)*VERTEX_STRIDE)), _mm_loadu_ps(data+(i+7)*VERTEX_STRIDE), 1);
+			//4x4 transpose inside each lane
+			__m256 t0=_mm256_unpacklo_ps(r0, r1);
+			__m256 t1=_mm256_unpackhi_ps(r0, r1);
+			__m256 t2=_mm256_unpacklo_ps(r2, r3);
+			__m256 t3=_mm256_unpackhi_ps(r2, r3);
+			__m256 x=_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 y=_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+			__m256 z=_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 distance=_mm256_add_ps(_mm256_mul_ps(nx, x), _mm256_mul_ps(ny, y));
+			distance=_mm256_sub_ps(_mm256_add_ps(distance, _mm256_mul_ps(nz, z)), offset);
+			_mm256_storeu_ps(distances+i, distance);
+			low=_mm256_min_ps(low, distance);
+			high=_mm256_max_ps(high, distance);
+			coordinate=_mm256_max_ps(coordinate, _mm256_max_ps(_mm256_andnot_ps(signMask, x), _mm256_max_ps(_mm256_andnot_ps(signMask, y), _mm256_andnot_ps(signMask, z))));
+		}
+		minDistance=HorizontalMin(_mm_min_ps(_mm256_castps256_ps128(low), _mm256_extractf128_ps(low, 1)));
+		maxDistance=HorizontalMax(_mm_max_ps(_mm256_castps256_ps128(high), _mm256_extractf128_ps(high, 1)));
+		maxCoordinate=HorizontalMax(_mm_max_ps(_mm256_castps256_ps128(coordinate), _mm256_extractf128_ps(coordinate, 1)));
+		return i;
+	}
+#endif
+};
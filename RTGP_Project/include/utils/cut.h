@@ -0,0 +1,1201 @@
+/*
+MeshCutter class:
+This class implements the cut on the cpu side only: it takes the vertices and indices of a triangular mesh
+together with the cutting plane, and it returns the geometry of the positive and negative meshes, their centroids,
+their areas, volumes and inertia tensors, and the points needed to build their convex hulls.
+No OpenGL call is issued here, so the cut can run (and be profiled) without a GL context; the upload of the
+produced geometry on the gpu is a separate stage, performed by the Mesh class.
+With the half-edge adjacency of the cut mesh (HalfEdgeMesh), the cut walks the mesh instead of visiting the triangles in order,
+and the adjacency of the two parts is derived from it. With its TriangleTree, the clusters of triangles lying on a side of the
+plane are copied to that side at once.
+The section is capped by chaining the segments of the cut triangles into closed loops, which are triangulated by ear clipping
+(see PolygonTriangulator): so sections with holes and with several islands are capped correctly, even when they are concave.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <algorithm>
+#include <stdint.h>
+#include <limits.h>
+#include <glm/glm.hpp>
+#include <utils/log.h>
+#include <utils/vertex.h>
+#include <utils/classify.h>
+#include <utils/integrals.h>
+#include <utils/tree.h>
+#include <utils/threadpool.h>
+#include <utils/hull.h>
+#include <utils/arena.h>
+#include <utils/halfedge.h>
+#include <utils/triangulate.h>
+
+//The triangles of the cut mesh are processed in chunks of this size; the chunks are the same whether the cut runs on
+//one or more threads, so the result doesn't depend on the number of threads.
+#define CUT_CHUNK_TRIANGLES 4096
+//Meshes with fewer triangles are always cut on the calling thread.
+#define CUT_PARALLEL_MIN_TRIANGLES 16384
+//Each chunk must be a cluster of the TriangleTree.
+static_assert(CUT_CHUNK_TRIANGLES%TREE_LEAF_TRIANGLES==0 && ((CUT_CHUNK_TRIANGLES/TREE_LEAF_TRIANGLES) & (CUT_CHUNK_TRIANGLES/TREE_LEAF_TRIANGLES-1))==0,
+				"CUT_CHUNK_TRIANGLES must be TREE_LEAF_TRIANGLES times a power of two");
+
+//Each vertex referenced by the triangles of a chunk is identified by a key: the two highest bits tell its type,
+//the others hold the index of the source vertex or the key of the cut edge.
+#define CUT_KEY_VERTEX 0ULL
+#define CUT_KEY_EDGE (1ULL<<62)
+#define CUT_KEY_TYPE (3ULL<<62)
+
+//With adjacency, each corner of the triangles of a chunk is paired with a key telling how to find the twin of the half-edge
+//leaving it: the two highest bits tell where the half-edge lies, the others hold a half-edge of the cut mesh, the key of a cut
+//edge or a corner of the chunk.
+//The part, on the same side, of a half-edge of the cut mesh: its twin is the part of the twin half-edge.
+#define CUT_TWIN_PIECE 0ULL
+//An edge of the surface along the section, on the segment starting from the vertex of the given cut edge (see SectionVertex):
+//its twin is the edge of the section's face on the same segment.
+#define CUT_TWIN_SEGMENT (1ULL<<62)
+//An edge inside a split triangle: its twin is the given corner of the chunk.
+#define CUT_TWIN_LOCAL (2ULL<<62)
+#define CUT_TWIN_TYPE (3ULL<<62)
+
+//Sides with a smaller volume are treated as open surfaces: their mass properties fall back on the area and the convex hull.
+#define CUT_MIN_VOLUME 1e-6f
+//Intersections closer than this to a vertex of their edge (in object space) are moved onto the vertex, so that repeated cuts
+//don't produce needle triangles and vertices almost on top of each other.
+#define CUT_SNAP_EPSILON 1e-5f
+//Marks the end of an open chain of section segments.
+#define CUT_NO_EDGE (~0ULL)
+
+//The cutting plane, expressed in the object space of the mesh that is going to be cut.
+struct CutPlane
+{
+	glm::vec3 normal;
+	glm::vec3 point;
+};
+
+//One of the two meshes produced by a cut.
+//The vertices and the centroid are in the frame of the vertices of the cut mesh, so the vertices copied from it are unchanged
+//and the pieces can share them (see VertexPool); the centroid is the center of mass of the enclosed volume, or the area
+//weighted center of the triangles if the side doesn't enclose a volume. The points of the convex hull are expressed with
+//respect to the centroid.
+struct CutSide
+{
+	vector<Vertex> vertices;
+	vector<unsigned int> indices;
+	//For each vertex, the index of the vertex of the cut mesh it is a copy of, or -1 if the cut has created it; empty if the
+	//side doesn't track them (MeshSlicer).
+	vector<int> sources;
+	glm::vec3 centroid;
+	float area;
+	//Enclosed volume, 0 if the side is not closed.
+	float volume;
+	//Inertia tensor of the enclosed volume with respect to the centroid, for a unit mass.
+	glm::mat3 inertia;
+	vector<glm::vec3> hullPoints;
+	//Fraction of the volume of the convex hull lost to keep it within HULL_POINT_BUDGET points.
+	float hullVolumeError;
+	//Adjacency of the triangles, only if the cut mesh has one.
+	HalfEdgeMesh adjacency;
+	//Tree of the triangles, only if the cut mesh has one and this side has at least TREE_MIN_TRIANGLES triangles.
+	shared_ptr<TriangleTree> tree;
+
+	CutSide(): centroid(0.0f), area(0.0f), volume(0.0f), inertia(0.0f), hullVolumeError(0.0f) {}
+};
+
+//Vertex generated by the intersection between the cutting plane and an edge of the mesh.
+//All triangles that share the edge share this vertex too; it is stored once per side, both as
+//a vertex of the surface and as a vertex of the section's face (which has a different normal).
+//The owner is the first chunk referencing the edge, which is the one that adds the vertices.
+//Each triangle crossed by the plane adds a segment of the section, between the vertices of its two cut edges; walked in the
+//direction of the positive side's face, each vertex of a closed section starts one segment and ends another: next and previous
+//are the keys of the edges at the other end of these segments (CUT_NO_EDGE if none), and they chain the segments into the
+//loops of the section.
+//With adjacency, the corners of each side leaving the segment starting here, on the surface and on the section's face, are
+//recorded too.
+struct SectionVertex
+{
+	int surface[2];
+	int section[2];
+	size_t owner;
+	unsigned long long next;
+	unsigned long long previous;
+	bool chained;
+	int border[2];
+	int face[2];
+};
+
+//A triangle produced by the split of a triangle of the cut mesh, before it is added to a chunk.
+struct SplitPart
+{
+	int side;
+	unsigned long long keys[3];
+	unsigned long long twinKeys[3];
+};
+
+struct CutResult
+{
+	CutSide positive;
+	CutSide negative;
+	//The plane has missed the mesh, or only touched it: all vertices lie on one side, and both sides are left empty.
+	bool grazed;
+
+	CutResult(): grazed(false) {}
+};
+
+//Part of the triangles of the cut mesh, with everything a thread produces from them.
+struct CutChunk
+{
+	size_t begin;
+	size_t end;
+	//Keys of the triangles generated for each side, three for each triangle, in the order they are generated.
+	vector<unsigned long long> keys[2];
+	//With adjacency, the twin key (CUT_TWIN_*) of each corner of keys.
+	vector<unsigned long long> twinKeys[2];
+	//With adjacency, the segments of the section left without a surface triangle along them on a side, because the triangle
+	//collapsed: pairs of the twin key of the segment and the one of the part of a half-edge of the cut mesh that takes its place.
+	vector<unsigned long long> collapsed[2];
+	//Keys of the edges crossed by the plane, in the order they are reached: two for each cut triangle, the first and the last
+	//vertex of its segment of the section, in the direction of the positive side's face.
+	vector<unsigned long long> edges;
+	glm::vec3 centroid[2];
+	float area[2];
+	//With the origin of object space as apex, like the sums of the clusters of the TriangleTree. The section's face is added
+	//as a fan around the point of the cutting plane: since the section is closed, this gives the same integrals as its
+	//triangulation, which is known only at the end.
+	VolumeIntegrals integrals[2];
+	size_t vertexCount[2];
+	size_t vertexOffset[2];
+	size_t indexOffset[2];
+};
+
+class MeshCutter
+{
+public:
+	enum Side
+	{
+		POSITIVE=0,
+		NEGATIVE=1
+	};
+
+	MeshCutter(): threadPool(nullptr), hull(nullptr), hullOrigin(0.0f), hullAxes(1.0f), twins(nullptr), tree(nullptr), attributes(VERTEX_ALL_ATTRIBUTES), chunkCount(0) {}
+
+	//With a thread pool, meshes with at least CUT_PARALLEL_MIN_TRIANGLES triangles are split by all its threads.
+	void SetThreadPool(ThreadPool* threadPool)
+	{
+		this->threadPool=threadPool;
+	}
+	//With the convex hull of the cut mesh, the hulls of the two parts are obtained by clipping it (see HullClipper) instead of
+	//collecting all their vertices. The points of the hull are in the frame of the rigid body: relative to its center of mass,
+	//which lies at origin in the frame of the vertices, along the axes (see Mesh::origin and Mesh::axes).
+	void SetHull(const btConvexHullShape* hull, glm::vec3 origin=glm::vec3(0.0f), glm::mat3 axes=glm::mat3(1.0f))
+	{
+		this->hull=hull;
+		hullOrigin=origin;
+		hullAxes=axes;
+	}
+	//With the twins of the half-edges of the cut mesh (see HalfEdgeMesh), a cut running on the calling thread walks the mesh:
+	//from each triangle crossed by the plane it follows the section across the neighbours, and the triangles on either side are
+	//reached by flood fill from the ones already visited. So the section vertices come out in the order they are met along the
+	//section, and both parts get their adjacency.
+	void SetAdjacency(const int* twins)
+	{
+		this->twins=twins;
+	}
+	//With the tree of the cut mesh, each chunk descends its cluster of the tree: the clusters lying on a side of the plane are
+	//copied to that side with their sums, and only the triangles of the leaves crossed by the plane are classified one by one.
+	//The mesh is then cut by chunks even on the calling thread, so it doesn't walk the mesh; the parts get a tree too, if they
+	//are large enough.
+	void SetTree(const TriangleTree* tree)
+	{
+		this->tree=tree;
+	}
+	//The attributes of the cut mesh (see VERTEX_NORMAL): the new vertices of the parts get only these ones.
+	void SetAttributes(unsigned int attributes)
+	{
+		this->attributes=attributes;
+	}
+
+	//This procedure cuts the given mesh in two parts: positive and negative, which are stored inside result.
+	//Since physics simulation does not deal directly with these meshes, the points of the convex hull of each part are
+	//computed too; the convex hull shapes are then built by the caller.
+	//Vertices are welded by their index in the source mesh: each original vertex is added at most once per side,
+	//and each edge crossed by the plane generates its new vertices only once.
+	//The triangles are split in chunks, processed in four passes:
+	//1) each chunk splits its triangles, referencing vertices by key, and records for each source vertex the first chunk using it;
+	//2) the cut edges are assigned to the first chunk reaching them, and the segments of the section are chained into loops
+	//   and triangulated;
+	//3) each chunk counts the vertices it owns, a prefix sum gives the position of its vertices and indices in the result,
+	//   then the chunk writes its own vertices;
+	//4) each chunk converts its keys to indices; the section's face is added after the triangles of the last chunk.
+	//Vertices end up in the order of their first use, exactly as if the triangles were processed one by one.
+	//When the cut walks the mesh (see SetAdjacency), the first pass is replaced by the walk, on a single chunk holding all
+	//triangles; with adjacency, two more passes build the adjacency of the result.
+	//All scratch data is taken from the arena of the cutter, or kept in buffers that are only cleared: a cutter reused for
+	//several cuts stops allocating heap memory, but for the result, once its buffers have reached the size of the cut meshes.
+	void Cut(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, const CutPlane & plane, CutResult & result)
+	{
+		sides[POSITIVE]=&result.positive;
+		sides[NEGATIVE]=&result.negative;
+		result.positive.hullPoints.clear();
+		result.negative.hullPoints.clear();
+		spareTrees[POSITIVE]=std::move(result.positive.tree);
+		spareTrees[NEGATIVE]=std::move(result.negative.tree);
+		this->vertices=vertices;
+		this->plane=plane;
+		arena.Reset();
+		size_t triangleCount=indexCount/3;
+		ThreadPool* pool=triangleCount>=CUT_PARALLEL_MIN_TRIANGLES? threadPool : nullptr;
+		bool walk=twins && !pool && !tree;
+
+		Log log=Log();
+		log.InitLog("Cut");
+		//First pass: the signed distance of each vertex from the plane is computed once, then the triangles just read it.
+		//If all vertices lie on one side no triangle is split, and one side would be the whole mesh: the cut stops here.
+		distances=arena.Allocate<float>(vertexCount);
+		float minDistance, maxDistance;
+		PlaneClassifier::SignedDistances(vertices, vertexCount, plane.normal, plane.point, distances, minDistance, maxDistance);
+		result.grazed=minDistance>0.f || maxDistance<=0.f;
+		if(result.grazed)
+		{
+			ClearSide(result.positive);
+			ClearSide(result.negative);
+			log.EndLog();
+			return;
+		}
+		PrepareChunks(vertexCount, triangleCount, walk? max(triangleCount, (size_t)1) : CUT_CHUNK_TRIANGLES);
+		
+		if(walk)
+			WalkTriangles(0, indices);
+		else
+			ForEachChunk(pool, [this, indices](size_t c) { SplitTriangles(c, indices); });
+		
+		//Each cut edge is reached by the two triangles sharing it.
+		size_t edgeCount=0;
+		for(size_t c=0;c<chunkCount;c++)
+			edgeCount+=chunks[c].edges.size();
+		sectionVertexMap.Reset(&arena, edgeCount/2);
+		for(size_t c=0;c<chunkCount;c++)
+		{
+			for(size_t i=0;i<chunks[c].edges.size();i++)
+			{
+				unsigned long long edge=chunks[c].edges[i];
+				bool isNew;
+				SectionVertex & sectionVertex=sectionVertexMap.Insert(edge, isNew);
+				if(isNew)
+				{
+					sectionVertex.surface[POSITIVE]=sectionVertex.surface[NEGATIVE]=-1;
+					sectionVertex.section[POSITIVE]=sectionVertex.section[NEGATIVE]=-1;
+					sectionVertex.owner=c;
+					sectionVertex.next=sectionVertex.previous=CUT_NO_EDGE;
+					sectionVertex.chained=false;
+					sectionVertex.border[POSITIVE]=sectionVertex.border[NEGATIVE]=-1;
+					sectionVertex.face[POSITIVE]=sectionVertex.face[NEGATIVE]=-1;
+				}
+			}
+		}
+		for(size_t c=0;c<chunkCount;c++)
+		{
+			for(size_t i=0;i<chunks[c].edges.size();i+=2)
+			{
+				sectionVertexMap.Find(chunks[c].edges[i])->next=chunks[c].edges[i+1];
+				sectionVertexMap.Find(chunks[c].edges[i+1])->previous=chunks[c].edges[i];
+			}
+		}
+		TriangulateSection();
+		
+		ForEachChunk(pool, [this](size_t c) { CountVertices(c); });
+		//The section's face of each side follows the triangles of all chunks.
+		for(int s=0;s<2;s++)
+		{
+			size_t vertexOffset=0;
+			size_t indexOffset=0;
+			sides[s]->centroid=glm::vec3(0.0f);
+			sides[s]->area=0.0f;
+			integrals[s]=VolumeIntegrals();
+			for(size_t c=0;c<chunkCount;c++)
+			{
+				chunks[c].vertexOffset[s]=vertexOffset;
+				chunks[c].indexOffset[s]=indexOffset;
+				vertexOffset+=chunks[c].vertexCount[s];
+				indexOffset+=chunks[c].keys[s].size();
+				sides[s]->centroid+=chunks[c].centroid[s];
+				sides[s]->area+=chunks[c].area[s];
+				integrals[s].Add(chunks[c].integrals[s]);
+			}
+			faceOffset[s]=indexOffset;
+			sides[s]->vertices.resize(vertexOffset);
+			sides[s]->sources.resize(vertexOffset);
+			sides[s]->indices.resize(indexOffset+faceTriangles.size());
+			if(twins)
+				sides[s]->adjacency.twins.resize(indexOffset+faceTriangles.size());
+			else
+				sides[s]->adjacency.twins.clear();
+		}
+		ForEachChunk(pool, [this](size_t c) { AddVertices(c); });
+		ForEachChunk(pool, [this](size_t c) { AddIndices(c); });
+		AddFaceIndices();
+		if(twins)
+		{
+			for(int s=0;s<2;s++)
+			{
+				pieces[s]=arena.Allocate<int>(indexCount);
+				fill(pieces[s], pieces[s]+indexCount, -1);
+			}
+			ForEachChunk(pool, [this](size_t c) { MapHalfEdges(c); });
+			LinkFaceHalfEdges();
+			ForEachChunk(pool, [this](size_t c) { LinkHalfEdges(c); });
+		}
+		
+		log.EndLog();
+		
+		//Grazing cuts have returned already, so both sides have triangles.
+		if(result.positive.area>0.0f)
+			result.positive.centroid/=result.positive.area;
+		if(result.negative.area>0.0f)
+			result.negative.centroid/=result.negative.area;
+		
+		ApplyVolumeIntegrals(result.positive, integrals[POSITIVE], glm::vec3(0.0f));
+		ApplyVolumeIntegrals(result.negative, integrals[NEGATIVE], glm::vec3(0.0f));
+			
+		log.InitLog("Convex hull generation");
+		if(hull)
+		{
+			HullClipper::ShapePoints(*hull, parentHullPoints, hullOrigin, hullAxes);
+			hullClipper.Split(parentHullPoints, plane.normal, plane.point, result.positive.hullPoints, result.negative.hullPoints);
+		}
+		CollectHullPoints(result.positive, hullClipper);
+		CollectHullPoints(result.negative, hullClipper);
+		log.EndLog();
+		
+		if(tree)
+		{
+			BuildTree(result.positive, spareTrees[POSITIVE]);
+			BuildTree(result.negative, spareTrees[NEGATIVE]);
+		}
+	}
+	//Sets the volume, the centroid and the inertia tensor of a closed side from the integrals of its volume, computed with the given apex.
+	//The tensor is moved from the apex to the center of mass (parallel axis theorem), then divided by the volume to get it for a unit mass.
+	static void ApplyVolumeIntegrals(CutSide & side, const VolumeIntegrals & integrals, glm::vec3 apex)
+	{
+		if(integrals.volume<=CUT_MIN_VOLUME)
+			return;
+		glm::vec3 center=integrals.moment/integrals.volume;
+		glm::mat3 covariance=integrals.covariance-glm::outerProduct(center, center)*integrals.volume;
+		float trace=covariance[0][0]+covariance[1][1]+covariance[2][2];
+		side.volume=integrals.volume;
+		side.centroid=apex+center;
+		side.inertia=(glm::mat3(trace)-covariance)/integrals.volume;
+	}
+	//Builds the tree of a side, if it has at least TREE_MIN_TRIANGLES triangles. The triangles are not sorted again: they come
+	//in the order of the cut mesh, whose tree had sorted them. The spare tree is rebuilt in place, unless a mesh shares it.
+	static void BuildTree(CutSide & side, shared_ptr<TriangleTree> & spare)
+	{
+		if(side.indices.size()/3<TREE_MIN_TRIANGLES)
+			return;
+		side.tree=spare && spare.use_count()==1? std::move(spare) : make_shared<TriangleTree>();
+		side.tree->Build(side.vertices.data(), side.indices.data(), side.indices.size(), nullptr, false);
+	}
+	//The points of the convex hull of a side are moved with respect to its centroid; the vertices are left in place. If the points
+	//have not been clipped already, each distinct position of the vertices becomes a point of the convex hull (the positions are
+	//sorted, so that equal ones are next to each other). Then the hull is simplified to HULL_POINT_BUDGET points.
+	static void CollectHullPoints(CutSide & side, HullClipper & hullClipper)
+	{
+		if(!side.hullPoints.empty())
+		{
+			for(unsigned int i=0;i<side.hullPoints.size();i++)
+				side.hullPoints[i]-=side.centroid;
+		}
+		else
+		{
+			side.hullPoints.resize(side.vertices.size());
+			for(unsigned int i=0;i<side.vertices.size();i++)
+				side.hullPoints[i]=side.vertices[i].Position-side.centroid;
+			sort(side.hullPoints.begin(), side.hullPoints.end(), [](const glm::vec3 & a, const glm::vec3 & b)
+			{
+				return a.x<b.x || (a.x==b.x && (a.y<b.y || (a.y==b.y && a.z<b.z)));
+			});
+			side.hullPoints.erase(unique(side.hullPoints.begin(), side.hullPoints.end()), side.hullPoints.end());
+		}
+		side.hullVolumeError=hullClipper.Simplify(side.hullPoints, HULL_POINT_BUDGET);
+	}
+
+private:
+	ThreadPool* threadPool;
+	const btConvexHullShape* hull;
+	glm::vec3 hullOrigin;
+	glm::mat3 hullAxes;
+	HullClipper hullClipper;
+	vector<glm::vec3> parentHullPoints;
+	const int* twins;
+	const TriangleTree* tree;
+	unsigned int attributes;
+	const Vertex* vertices;
+	CutPlane plane;
+	CutSide* sides[2];
+	//The trees of the sides of the last result, which the meshes of its cut didn't take (see Mesh::CommitCut).
+	shared_ptr<TriangleTree> spareTrees[2];
+	VolumeIntegrals integrals[2];
+	Arena arena;
+	//Signed distance of each vertex of the cut mesh from the plane.
+	float* distances;
+	//The chunks of the current cut are the first chunkCount; the others are kept with their buffers for larger cuts.
+	vector<CutChunk> chunks;
+	size_t chunkCount;
+	//For each side, the first chunk using each vertex of the cut mesh.
+	atomic<size_t>* vertexOwners[2];
+	//Index of each vertex of the cut mesh inside the positive and negative meshes; -1 if not used by that side,
+	//-2 if counted by its owner but not added yet.
+	int* vertexIndices[2];
+	//Vertices generated on the cut edges, the key is made of the indices of the edge's vertices.
+	ArenaHashMap<unsigned long long, SectionVertex> sectionVertexMap;
+	//Loops of the section: loop l is made of the cut edges loopEdges[loopStarts[l]] to loopEdges[loopStarts[l+1]-1], whose
+	//vertices are projected on the plane in loopPoints.
+	vector<unsigned long long> loopEdges;
+	vector<unsigned int> loopStarts;
+	vector<glm::vec2> loopPoints;
+	//For each vertex of the loops, the index of the next one if a segment joins them, UINT_MAX if the edge closes an open chain.
+	vector<unsigned int> loopSegmentEnds;
+	//Where the cut mesh has a seam, the triangles on its two sides reach different copies of the same edge, so a chain ends on
+	//a copy and another starts from the other: the chains are joined by the positions of these ends.
+	ArenaHashMap<glm::vec3, unsigned long long> chainStarts;
+	ArenaHashMap<glm::vec3, unsigned long long> chainEnds;
+	//Triangles of the section's face, as indices of loopEdges, wound like the positive side's face; the negative side gets
+	//them reversed. They are added to each side from faceOffset.
+	vector<unsigned int> faceTriangles;
+	size_t faceOffset[2];
+	PolygonTriangulator triangulator;
+	//With adjacency, for each side and each half-edge of the cut mesh, the corner of the result leaving its part on the side
+	//(see CUT_TWIN_PIECE); -1 if there is none.
+	int* pieces[2];
+	//With adjacency, the corner of the section's face leaving each of its inner edges, by the indices of loopEdges at its ends.
+	ArenaHashMap<unsigned long long, int> faceEdges;
+
+	//Empties a side, keeping the capacity of its buffers.
+	static void ClearSide(CutSide & side)
+	{
+		side.vertices.clear();
+		side.indices.clear();
+		side.sources.clear();
+		side.adjacency.twins.clear();
+		side.centroid=glm::vec3(0.0f);
+		side.area=0.0f;
+		side.volume=0.0f;
+		side.inertia=glm::mat3(0.0f);
+		side.hullVolumeError=0.0f;
+	}
+	void PrepareChunks(size_t vertexCount, size_t triangleCount, size_t chunkTriangles)
+	{
+		chunkCount=(triangleCount+chunkTriangles-1)/chunkTriangles;
+		if(chunks.size()<chunkCount)
+			chunks.resize(chunkCount);
+		for(size_t c=0;c<chunkCount;c++)
+		{
+			CutChunk & chunk=chunks[c];
+			chunk.begin=c*chunkTriangles;
+			chunk.end=min(triangleCount, chunk.begin+chunkTriangles);
+			chunk.edges.clear();
+			for(int s=0;s<2;s++)
+			{
+				chunk.keys[s].clear();
+				chunk.twinKeys[s].clear();
+				chunk.collapsed[s].clear();
+				chunk.centroid[s]=glm::vec3(0.0f);
+				chunk.area[s]=0.0f;
+				chunk.integrals[s]=VolumeIntegrals();
+				chunk.vertexCount[s]=0;
+			}
+		}
+		for(int s=0;s<2;s++)
+		{
+			vertexOwners[s]=arena.Allocate<atomic<size_t>>(vertexCount);
+			for(size_t i=0;i<vertexCount;i++)
+				new(&vertexOwners[s][i]) atomic<size_t>(SIZE_MAX);
+			vertexIndices[s]=arena.Allocate<int>(vertexCount);
+			fill(vertexIndices[s], vertexIndices[s]+vertexCount, -1);
+		}
+	}
+	//Runs the given pass over all chunks, on the threads of the pool if there is one.
+	template<class F>
+	void ForEachChunk(ThreadPool* pool, F pass)
+	{
+		if(pool)
+			pool->ParallelFor(chunkCount, [&pass](size_t c, unsigned int) { pass(c); });
+		else
+			for(size_t c=0;c<chunkCount;c++)
+				pass(c);
+	}
+
+	//This method calculates the area of the triangle defined by a, b, c vertices; it is used, together with the method below,
+	//to calculate the new pivots, needed after each cut.
+	float CalculateTriangleArea(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+	{
+		glm::vec3 ba=b-a;
+		glm::vec3 ca=c-a;
+		glm::vec3 cross=glm::cross(ba, ca);
+		return (glm::sqrt(cross.x*cross.x+cross.y*cross.y+cross.z*cross.z))*0.5f;
+	}
+	glm::vec3 CalculateTriangleCenter(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+	{
+		glm::vec3 triangleCenter=(a+b+c)/3.0f;
+		return triangleCenter;
+	}
+	//The key of an edge doesn't depend on the order of its vertices, so the two triangles sharing it produce the same key.
+	static unsigned long long EdgeKey(unsigned int a, unsigned int b)
+	{
+		if(a>b)
+			swap(a, b);
+		return ((unsigned long long)a<<31) | b;
+	}
+	//Linear interpolation factor of the intersection along the edge, from the vertex with the lower position (in lexicographic
+	//order), so that the result doesn't depend on which triangle reaches the edge first, nor on which copy of its vertices is
+	//used where the mesh has a seam: the two copies of the edge get the very same position.
+	float EdgeIntersection(unsigned long long edge, unsigned int & first, unsigned int & second)
+	{
+		first=(unsigned int)(edge>>31);
+		second=(unsigned int)(edge & 0x7FFFFFFFULL);
+		if(first==second)
+			return 0.0f;
+		glm::vec3 firstPosition=vertices[first].Position;
+		glm::vec3 secondPosition=vertices[second].Position;
+		if(secondPosition.x<firstPosition.x || (secondPosition.x==firstPosition.x && (secondPosition.y<firstPosition.y ||
+			(secondPosition.y==firstPosition.y && secondPosition.z<firstPosition.z))))
+			swap(first, second);
+		return distances[first]/(distances[first]-distances[second]);
+	}
+	//The key of the vertex of the cut mesh the intersection on the edge is snapped to, if it is closer than CUT_SNAP_EPSILON to
+	//it; otherwise the key of the edge. The choice depends only on the edge, so all the triangles sharing it agree.
+	unsigned long long SnapEdge(unsigned long long edge)
+	{
+		unsigned int first, second;
+		float intFactor=EdgeIntersection(edge, first, second);
+		float length=glm::length(vertices[second].Position-vertices[first].Position);
+		if(intFactor*length<CUT_SNAP_EPSILON)
+			return CUT_KEY_VERTEX | first;
+		if((1.0f-intFactor)*length<CUT_SNAP_EPSILON)
+			return CUT_KEY_VERTEX | second;
+		return CUT_KEY_EDGE | edge;
+	}
+	static bool IsSnappedEdge(unsigned long long edge)
+	{
+		return (edge>>31)==(edge & 0x7FFFFFFFULL);
+	}
+	//The key of the section vertex at the given surface key: the cut edge, or the edge from a snapped vertex to itself.
+	static unsigned long long SectionKey(unsigned long long key)
+	{
+		if((key & CUT_KEY_TYPE)==CUT_KEY_VERTEX)
+			return EdgeKey((unsigned int)key, (unsigned int)key);
+		return key & ~CUT_KEY_TYPE;
+	}
+	glm::vec3 EdgeVertexPosition(unsigned long long edge)
+	{
+		unsigned int first, second;
+		float intFactor=EdgeIntersection(edge, first, second);
+		return vertices[second].Position*intFactor+vertices[first].Position*(1.0f-intFactor);
+	}
+	glm::vec3 KeyPosition(unsigned long long key)
+	{
+		if((key & CUT_KEY_TYPE)==CUT_KEY_VERTEX)
+			return vertices[key].Position;
+		return EdgeVertexPosition(key & ~CUT_KEY_TYPE);
+	}
+	//Adds a triangle to the given side of the chunk, updating its area, centroid and volume integrals.
+	void AddTriangle(CutChunk & chunk, int side, unsigned long long a, unsigned long long b, unsigned long long c)
+	{
+		chunk.keys[side].push_back(a);
+		chunk.keys[side].push_back(b);
+		chunk.keys[side].push_back(c);
+		glm::vec3 aPosition=KeyPosition(a);
+		glm::vec3 bPosition=KeyPosition(b);
+		glm::vec3 cPosition=KeyPosition(c);
+		float triangleArea=CalculateTriangleArea(aPosition, bPosition, cPosition);
+		chunk.centroid[side]+=(triangleArea*CalculateTriangleCenter(aPosition, bPosition, cPosition));
+		chunk.area[side]+=triangleArea;
+		chunk.integrals[side].AddTriangle(aPosition, bPosition, cPosition);
+	}
+	//Records that the given chunk uses the vertex on the given side; the lowest chunk wins.
+	void UseVertex(size_t c, int side, unsigned int i)
+	{
+		size_t owner=vertexOwners[side][i].load(memory_order_relaxed);
+		while(c<owner && !vertexOwners[side][i].compare_exchange_weak(owner, c, memory_order_relaxed));
+	}
+	//With adjacency, records the twin keys of the last triangle added to the given side of the chunk.
+	void AddTwinKeys(CutChunk & chunk, int side, unsigned long long a, unsigned long long b, unsigned long long c)
+	{
+		if(!twins)
+			return;
+		chunk.twinKeys[side].push_back(a);
+		chunk.twinKeys[side].push_back(b);
+		chunk.twinKeys[side].push_back(c);
+	}
+	//In case a triangle is not intersected by the cutting plane, then it must belong totally to the positive or negative part.
+	//Its half-edges are h, h+1 and h+2.
+	void AddExistingTriangle(size_t c, int side, unsigned int a, unsigned int b, unsigned int c2, size_t h)
+	{
+		UseVertex(c, side, a);
+		UseVertex(c, side, b);
+		UseVertex(c, side, c2);
+		AddTriangle(chunks[c], side, a, b, c2);
+		AddTwinKeys(chunks[c], side, CUT_TWIN_PIECE | h, CUT_TWIN_PIECE | (h+1), CUT_TWIN_PIECE | (h+2));
+	}
+	//This function is called, only if a triangle of the mesh is divided by the cutting plane.
+	//The vertex a is the only one on its side, so the plane crosses the edges a, b and c, a: the part containing a is a triangle,
+	//while the other one is a quad, split in two triangles. The winding of the original triangle is preserved.
+	//Furthermore, the triangle adds its segment of the section, between the new vertices, to the face filling the empty section
+	//there would be after the cut; the face is triangulated once all its segments are known.
+	//Where an intersection is snapped to a vertex (see SnapEdge), some of the triangles collapse: they are dropped, and the
+	//neighbours across their two remaining edges, which now coincide, become twins.
+	//The half-edge ab of the cut mesh is given, for the adjacency: bc and ca are the next ones in the triangle.
+	void AddNewTriangle(size_t c, unsigned int a, unsigned int b, unsigned int c2, bool aPositive, size_t abHalfEdge)
+	{
+		CutChunk & chunk=chunks[c];
+		unsigned long long abKey=SnapEdge(EdgeKey(a, b));
+		unsigned long long caKey=SnapEdge(EdgeKey(c2, a));
+		//The side of a walks the new edge from ab to ca, so its face must walk it from ca to ab, the other side the opposite way.
+		unsigned long long segmentStart=SectionKey(aPositive? caKey : abKey);
+		unsigned long long segmentEnd=SectionKey(aPositive? abKey : caKey);
+		if(segmentStart!=segmentEnd)
+		{
+			chunk.edges.push_back(segmentStart);
+			chunk.edges.push_back(segmentEnd);
+		}
+		int aSide=aPositive? POSITIVE : NEGATIVE;
+		int bcSide=aPositive? NEGATIVE : POSITIVE;
+		
+		//The section's face doesn't count in the area.
+		glm::vec3 abPosition=KeyPosition(abKey);
+		glm::vec3 caPosition=KeyPosition(caKey);
+		chunk.integrals[aSide].AddTriangle(plane.point, caPosition, abPosition);
+		chunk.integrals[bcSide].AddTriangle(plane.point, abPosition, caPosition);
+		
+		//The side of a gets the triangle a, ab, ca; the other side the triangles b, c, ca and b, ca, ab, which share the diagonal
+		//of the quad (corner 2 of the first and 0 of the second). The new edge is shared by each surface triangle with the
+		//section's face of its side.
+		unsigned long long ab=abHalfEdge;
+		unsigned long long bc=HalfEdgeMesh::Next(abHalfEdge);
+		unsigned long long ca=HalfEdgeMesh::Previous(abHalfEdge);
+		SplitPart parts[3]=
+		{
+			{aSide, {a, abKey, caKey}, {CUT_TWIN_PIECE | ab, CUT_TWIN_SEGMENT | segmentStart, CUT_TWIN_PIECE | ca}},
+			{bcSide, {b, c2, caKey}, {CUT_TWIN_PIECE | bc, CUT_TWIN_PIECE | ca, CUT_TWIN_LOCAL}},
+			{bcSide, {b, caKey, abKey}, {CUT_TWIN_LOCAL, CUT_TWIN_SEGMENT | segmentStart, CUT_TWIN_PIECE | ab}}
+		};
+		bool dropped[3]={false, false, false};
+		for(int p=0;p<3;p++)
+		{
+			const unsigned long long* keys=parts[p].keys;
+			int zero=keys[0]==keys[1]? 0 : keys[1]==keys[2]? 1 : keys[2]==keys[0]? 2 : -1;
+			if(zero<0)
+				continue;
+			dropped[p]=true;
+			if(keys[0]==keys[1] && keys[1]==keys[2])
+				continue;
+			//The edges leaving the corners after the zero length one coincide, walked in opposite directions.
+			unsigned long long first=parts[p].twinKeys[(zero+1)%3];
+			unsigned long long second=parts[p].twinKeys[(zero+2)%3];
+			if(first==CUT_TWIN_LOCAL || second==CUT_TWIN_LOCAL)
+			{
+				SplitPart & other=parts[p==1? 2 : 1];
+				other.twinKeys[p==1? 0 : 2]=first==CUT_TWIN_LOCAL? second : first;
+			}
+			else if(twins)
+			{
+				//A segment and a part of a half-edge of the cut mesh: there is no surface along the segment on this side.
+				bool firstSegment=(first & CUT_TWIN_TYPE)==CUT_TWIN_SEGMENT;
+				chunk.collapsed[parts[p].side].push_back(firstSegment? first : second);
+				chunk.collapsed[parts[p].side].push_back(firstSegment? second : first);
+			}
+		}
+		unsigned long long bcFirst=chunk.keys[bcSide].size();
+		if(!dropped[1] && !dropped[2])
+		{
+			parts[1].twinKeys[2]=CUT_TWIN_LOCAL | (bcFirst+3);
+			parts[2].twinKeys[0]=CUT_TWIN_LOCAL | (bcFirst+2);
+		}
+		for(int p=0;p<3;p++)
+		{
+			if(dropped[p])
+				continue;
+			const SplitPart & part=parts[p];
+			for(int k=0;k<3;k++)
+				if((part.keys[k] & CUT_KEY_TYPE)==CUT_KEY_VERTEX)
+					UseVertex(c, part.side, (unsigned int)part.keys[k]);
+			AddTriangle(chunk, part.side, part.keys[0], part.keys[1], part.keys[2]);
+			AddTwinKeys(chunk, part.side, part.twinKeys[0], part.twinKeys[1], part.twinKeys[2]);
+		}
+	}
+	//The triangle t is assigned to a side of the chunk or split. If the plane crosses it, the half-edge it crosses going from
+	//the positive to the negative side is returned: walking the section in this direction, it leaves the triangle there.
+	//Otherwise -1 is returned.
+	int SplitTriangle(size_t c, size_t t, const unsigned int* indices)
+	{
+		unsigned int a=indices[3*t];
+		unsigned int b=indices[3*t+1];
+		unsigned int c2=indices[3*t+2];
+		//True means positive, false negative.
+		bool aCheck=distances[a]>0.f;
+		bool bCheck=distances[b]>0.f;
+		bool cCheck=distances[c2]>0.f;
+		
+		if(aCheck==bCheck && bCheck==cCheck)
+		{
+			AddExistingTriangle(c, aCheck? POSITIVE : NEGATIVE, a, b, c2, 3*t);
+			return -1;
+		}
+		//The lone vertex, the one on a different side from the other two, is always passed as first,
+		//rotating the triangle so that its winding is preserved.
+		size_t abHalfEdge;
+		bool lonePositive;
+		if(aCheck==bCheck)
+		{
+			abHalfEdge=3*t+2;
+			lonePositive=cCheck;
+			AddNewTriangle(c, c2, a, b, cCheck, abHalfEdge);
+		}
+		else if(aCheck==cCheck)
+		{
+			abHalfEdge=3*t+1;
+			lonePositive=bCheck;
+			AddNewTriangle(c, b, c2, a, bCheck, abHalfEdge);
+		}
+		else
+		{
+			abHalfEdge=3*t;
+			lonePositive=aCheck;
+			AddNewTriangle(c, a, b, c2, aCheck, abHalfEdge);
+		}
+		//The half-edge ab leaves the lone vertex, ca reaches it.
+		return (int)(lonePositive? abHalfEdge : HalfEdgeMesh::Previous(abHalfEdge));
+	}
+	//First pass over a chunk: each triangle is assigned to a side or split. With a tree, the chunk is one of its clusters.
+	void SplitTriangles(size_t c, const unsigned int* indices)
+	{
+		if(tree)
+		{
+			unsigned int level=0;
+			while(level+1<tree->Levels() && ((size_t)TREE_LEAF_TRIANGLES<<level)<CUT_CHUNK_TRIANGLES)
+				level++;
+			SplitCluster(c, level, c, indices);
+			return;
+		}
+		for(size_t t=chunks[c].begin;t<chunks[c].end;t++)
+			SplitTriangle(c, t, indices);
+	}
+	//A cluster lying on a side of the plane is copied to it; otherwise its two halves are split, down to the triangles of the leaves.
+	void SplitCluster(size_t c, unsigned int level, size_t i, const unsigned int* indices)
+	{
+		const TriangleCluster & cluster=tree->Cluster(level, i);
+		size_t begin, end;
+		tree->ClusterTriangles(level, i, begin, end);
+		int clusterSide=TriangleTree::ClusterSide(cluster, plane.normal, plane.point);
+		if(clusterSide!=0)
+			AddCluster(c, clusterSide>0? POSITIVE : NEGATIVE, cluster, begin, end, indices);
+		else if(level==0)
+			for(size_t t=begin;t<end;t++)
+				SplitTriangle(c, t, indices);
+		else
+			for(size_t child=2*i;child<2*i+2 && child<tree->LevelSize(level-1);child++)
+				SplitCluster(c, level-1, child, indices);
+	}
+	//The triangles of a cluster are copied to the given side as they are, and the sums of the cluster are added to the chunk.
+	void AddCluster(size_t c, int side, const TriangleCluster & cluster, size_t begin, size_t end, const unsigned int* indices)
+	{
+		CutChunk & chunk=chunks[c];
+		for(size_t h=3*begin;h<3*end;h++)
+		{
+			UseVertex(c, side, indices[h]);
+			chunk.keys[side].push_back(indices[h]);
+			if(twins)
+				chunk.twinKeys[side].push_back(CUT_TWIN_PIECE | h);
+		}
+		chunk.centroid[side]+=cluster.weightedCenter;
+		chunk.area[side]+=cluster.area;
+		chunk.integrals[side].Add(cluster.integrals);
+	}
+	//First pass with adjacency, on a single chunk: the triangles are visited by flood fill across the twins, starting from
+	//the first one not visited yet; when a triangle crossed by the plane is reached, the section is followed from it, across
+	//the neighbours, until it closes or reaches the boundary. Each triangle is visited once, so its neighbours are queued
+	//only the first time they are reached.
+	void WalkTriangles(size_t c, const unsigned int* indices)
+	{
+		size_t triangleCount=chunks[c].end;
+		//0 if not reached yet, 1 if queued, 2 if visited.
+		unsigned char* states=arena.Allocate<unsigned char>(triangleCount);
+		fill(states, states+triangleCount, (unsigned char)0);
+		size_t* pending=arena.Allocate<size_t>(triangleCount);
+		size_t pendingCount=0;
+		for(size_t seed=0;seed<triangleCount;seed++)
+		{
+			if(states[seed]!=0)
+				continue;
+			states[seed]=1;
+			pending[pendingCount++]=seed;
+			while(pendingCount>0)
+			{
+				size_t t=pending[--pendingCount];
+				while(t!=SIZE_MAX && states[t]!=2)
+				{
+					int exit=SplitTriangle(c, t, indices);
+					states[t]=2;
+					for(size_t h=3*t;h<3*t+3;h++)
+					{
+						int twin=twins[h];
+						if(twin>=0 && states[twin/3]==0)
+						{
+							states[twin/3]=1;
+							pending[pendingCount++]=twin/3;
+						}
+					}
+					t=exit>=0 && twins[exit]>=0? (size_t)(twins[exit]/3) : SIZE_MAX;
+				}
+			}
+		}
+	}
+	//Calls the given function for each vertex owned by the chunk, on the given side, in order of first use; then come the section
+	//vertices on snapped vertices, which have no surface vertex of their own, and the edges of the section no triangle of the
+	//chunk uses on this side: where the nearby intersections are snapped, the triangles along them may all collapse on a side,
+	//but the section's face still needs their vertices.
+	template<class F>
+	void ForEachOwnedVertex(size_t c, int side, F function)
+	{
+		const vector<unsigned long long> & keys=chunks[c].keys[side];
+		for(size_t i=0;i<keys.size();i++)
+		{
+			unsigned long long key=keys[i];
+			unsigned long long type=key & CUT_KEY_TYPE;
+			if(type==CUT_KEY_VERTEX)
+			{
+				if(vertexOwners[side][key].load(memory_order_relaxed)==c)
+					function(key, (SectionVertex*)nullptr);
+			}
+			else if(type==CUT_KEY_EDGE)
+			{
+				SectionVertex & sectionVertex=*sectionVertexMap.Find(key & ~CUT_KEY_TYPE);
+				if(sectionVertex.owner==c)
+					function(key & ~CUT_KEY_TYPE, &sectionVertex);
+			}
+		}
+		const vector<unsigned long long> & edges=chunks[c].edges;
+		for(size_t i=0;i<edges.size();i++)
+		{
+			SectionVertex & sectionVertex=*sectionVertexMap.Find(edges[i]);
+			if(sectionVertex.owner==c)
+				function(edges[i], &sectionVertex);
+		}
+	}
+	//Each vertex owned by the chunk is counted once, marking it; edges add a surface and a section vertex, snapped vertices
+	//a section vertex only.
+	void CountVertices(size_t c)
+	{
+		for(int side=0;side<2;side++)
+		{
+			size_t & count=chunks[c].vertexCount[side];
+			ForEachOwnedVertex(c, side, [this, side, &count](unsigned long long key, SectionVertex* sectionVertex)
+			{
+				if(!sectionVertex && vertexIndices[side][key]==-1)
+				{
+					vertexIndices[side][key]=-2;
+					count++;
+				}
+				else if(sectionVertex && IsSnappedEdge(key))
+				{
+					if(sectionVertex->section[side]==-1)
+					{
+						sectionVertex->section[side]=-2;
+						count++;
+					}
+				}
+				else if(sectionVertex && sectionVertex->surface[side]==-1)
+				{
+					sectionVertex->surface[side]=-2;
+					count+=2;
+				}
+			});
+		}
+	}
+	//The vertices owned by the chunk are written in the result, starting from the offset of the chunk; the loop is specialised
+	//on the attributes of the mesh.
+	void AddVertices(size_t c)
+	{
+		switch(attributes & VERTEX_ALL_ATTRIBUTES)
+		{
+			case VERTEX_NORMAL:
+				AddVertices<VERTEX_NORMAL>(c);
+				break;
+			case VERTEX_TEXCOORDS:
+				AddVertices<VERTEX_TEXCOORDS>(c);
+				break;
+			case VERTEX_ALL_ATTRIBUTES:
+				AddVertices<VERTEX_ALL_ATTRIBUTES>(c);
+				break;
+			default:
+				AddVertices<0>(c);
+				break;
+		}
+	}
+	template<unsigned int Attributes>
+	void AddVertices(size_t c)
+	{
+		for(int side=0;side<2;side++)
+		{
+			int next=chunks[c].vertexOffset[side];
+			vector<Vertex> & sideVertices=sides[side]->vertices;
+			vector<int> & sideSources=sides[side]->sources;
+			glm::vec3 sectionNormal=side==POSITIVE? -plane.normal : plane.normal;
+			ForEachOwnedVertex(c, side, [this, side, &next, &sideVertices, &sideSources, sectionNormal](unsigned long long key, SectionVertex* sectionVertex)
+			{
+				if(!sectionVertex && vertexIndices[side][key]==-2)
+				{
+					vertexIndices[side][key]=next;
+					sideSources[next]=(int)key;
+					sideVertices[next++]=vertices[key];
+				}
+				else if(sectionVertex && IsSnappedEdge(key))
+				{
+					if(sectionVertex->section[side]==-2)
+					{
+						sectionVertex->section[side]=next;
+						sideSources[next]=-1;
+						sideVertices[next++]=Vertex(EdgeVertexPosition(key), sectionNormal, glm::vec2(0.0f));
+					}
+				}
+				else if(sectionVertex && sectionVertex->surface[side]==-2)
+				{
+					unsigned int first, second;
+					float intFactor=EdgeIntersection(key, first, second);
+					Vertex & vertex=sideVertices[next];
+					vertex=Vertex::Interpolate<Attributes>(vertices[first], vertices[second], intFactor);
+					sideVertices[next+1]=Vertex(vertex.Position, sectionNormal, glm::vec2(0.0f));
+					sideSources[next]=-1;
+					sideSources[next+1]=-1;
+					sectionVertex->surface[side]=next;
+					sectionVertex->section[side]=next+1;
+					next+=2;
+				}
+			});
+		}
+	}
+	//Last pass: the keys of the chunk's triangles are converted to indices of the result.
+	void AddIndices(size_t c)
+	{
+		for(int side=0;side<2;side++)
+		{
+			const vector<unsigned long long> & keys=chunks[c].keys[side];
+			unsigned int* sideIndices=sides[side]->indices.data()+chunks[c].indexOffset[side];
+			for(size_t i=0;i<keys.size();i++)
+			{
+				unsigned long long key=keys[i];
+				unsigned long long type=key & CUT_KEY_TYPE;
+				if(type==CUT_KEY_VERTEX)
+					sideIndices[i]=vertexIndices[side][key];
+				else
+					sideIndices[i]=sectionVertexMap.Find(key & ~CUT_KEY_TYPE)->surface[side];
+			}
+		}
+	}
+	//The vertex following the given one along the section, across seams; CUT_NO_EDGE at the end of an open chain.
+	unsigned long long NextSectionEdge(unsigned long long edge)
+	{
+		unsigned long long next=sectionVertexMap.Find(edge)->next;
+		if(next==CUT_NO_EDGE || sectionVertexMap.Find(next)->next!=CUT_NO_EDGE)
+			return next;
+		unsigned long long* joined=chainStarts.Find(EdgeVertexPosition(next));
+		return joined && *joined!=next? *joined : next;
+	}
+	//The vertex preceding the given one along the section, across seams; CUT_NO_EDGE at the start of an open chain.
+	unsigned long long PreviousSectionEdge(unsigned long long edge)
+	{
+		unsigned long long previous=sectionVertexMap.Find(edge)->previous;
+		if(previous!=CUT_NO_EDGE)
+			return previous;
+		unsigned long long* joined=chainEnds.Find(EdgeVertexPosition(edge));
+		return joined && *joined!=edge? sectionVertexMap.Find(*joined)->previous : CUT_NO_EDGE;
+	}
+	//The segments of the section are chained into loops, in the order their edges were reached: from each vertex not chained
+	//yet, the chain is followed back to its start, then forward until it closes. A chain that doesn't close (the cut mesh is
+	//open there) is closed by the edge between its ends. The loops are projected on the plane and triangulated.
+	void TriangulateSection()
+	{
+		loopEdges.clear();
+		loopStarts.assign(1, 0);
+		loopPoints.clear();
+		loopSegmentEnds.clear();
+		faceTriangles.clear();
+		chainStarts.Reset(&arena, 16);
+		chainEnds.Reset(&arena, 16);
+		sectionVertexMap.ForEach([this](unsigned long long edge, SectionVertex & sectionVertex)
+		{
+			bool isNew;
+			if(sectionVertex.previous==CUT_NO_EDGE)
+				chainStarts.Insert(EdgeVertexPosition(edge), isNew)=edge;
+			if(sectionVertex.next==CUT_NO_EDGE)
+				chainEnds.Insert(EdgeVertexPosition(edge), isNew)=edge;
+		});
+
+		glm::vec3 u=glm::normalize(glm::cross(plane.normal, fabs(plane.normal.x)<0.9f? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f)));
+		glm::vec3 v=glm::cross(plane.normal, u);
+		for(size_t c=0;c<chunkCount;c++)
+		{
+			for(size_t i=0;i<chunks[c].edges.size();i+=2)
+			{
+				if(sectionVertexMap.Find(chunks[c].edges[i])->chained)
+					continue;
+				unsigned long long start=chunks[c].edges[i];
+				for(size_t steps=0;steps<sectionVertexMap.Size();steps++)
+				{
+					unsigned long long previous=PreviousSectionEdge(start);
+					if(previous==CUT_NO_EDGE || previous==chunks[c].edges[i] || sectionVertexMap.Find(previous)->chained)
+						break;
+					start=previous;
+				}
+				unsigned int first=loopEdges.size();
+				unsigned long long edge=start;
+				while(true)
+				{
+					sectionVertexMap.Find(edge)->chained=true;
+					glm::vec3 position=EdgeVertexPosition(edge)-plane.point;
+					loopEdges.push_back(edge);
+					loopPoints.push_back(glm::vec2(glm::dot(position, u), glm::dot(position, v)));
+					unsigned long long next=NextSectionEdge(edge);
+					bool closed=next==start;
+					if(next==CUT_NO_EDGE || sectionVertexMap.Find(next)->chained)
+					{
+						loopSegmentEnds.push_back(closed? first : UINT_MAX);
+						break;
+					}
+					loopSegmentEnds.push_back(loopEdges.size());
+					edge=next;
+				}
+				if(loopEdges.size()-first<3)
+				{
+					loopEdges.resize(first);
+					loopPoints.resize(first);
+					loopSegmentEnds.resize(first);
+				}
+				else
+					loopStarts.push_back(loopEdges.size());
+			}
+		}
+		triangulator.Triangulate(loopPoints, loopStarts, faceTriangles);
+	}
+	//Index in loopEdges of the i-th corner of the section's face on the given side: the negative side walks its triangles backwards.
+	unsigned int FaceCorner(int side, size_t i) const
+	{
+		if(side==POSITIVE)
+			return faceTriangles[i];
+		return faceTriangles[i-i%3+(3-i%3)%3];
+	}
+	//The triangles of the section's face are added to each side, after the ones of the chunks, on the section vertices.
+	void AddFaceIndices()
+	{
+		for(int side=0;side<2;side++)
+		{
+			unsigned int* sideIndices=sides[side]->indices.data()+faceOffset[side];
+			for(size_t i=0;i<faceTriangles.size();i++)
+				sideIndices[i]=sectionVertexMap.Find(loopEdges[FaceCorner(side, i)])->section[side];
+		}
+	}
+	//With adjacency: each edge of the section's face lying on a segment is the twin of the surface edge on the same segment,
+	//each other edge is shared by two triangles of the face.
+	void LinkFaceHalfEdges()
+	{
+		for(int side=0;side<2;side++)
+		{
+			int* sideTwins=sides[side]->adjacency.twins.data()+faceOffset[side];
+			faceEdges.Reset(&arena, faceTriangles.size());
+			for(int pass=0;pass<2;pass++)
+			{
+				for(size_t i=0;i<faceTriangles.size();i++)
+				{
+					unsigned int source=FaceCorner(side, i);
+					unsigned int target=FaceCorner(side, HalfEdgeMesh::Next(i));
+					//The segment starts from the source on the positive side, from the target on the negative one.
+					unsigned int segmentStart=side==POSITIVE? source : target;
+					if(loopSegmentEnds[segmentStart]==(side==POSITIVE? target : source))
+					{
+						if(pass==0)
+						{
+							SectionVertex & sectionVertex=*sectionVertexMap.Find(loopEdges[segmentStart]);
+							int corner=(int)(faceOffset[side]+i);
+							sectionVertex.face[side]=corner;
+							if(sectionVertex.border[side]>=-1)
+								sideTwins[i]=sectionVertex.border[side];
+							else
+							{
+								size_t h=(size_t)(-2-sectionVertex.border[side]);
+								sideTwins[i]=twins[h]>=0? pieces[side][twins[h]] : -1;
+								pieces[side][h]=corner;
+							}
+						}
+					}
+					else if(pass==0)
+					{
+						bool isNew;
+						faceEdges.Insert(((unsigned long long)source<<32) | target, isNew)=(int)(faceOffset[side]+i);
+					}
+					else
+					{
+						int* twin=faceEdges.Find(((unsigned long long)target<<32) | source);
+						sideTwins[i]=twin? *twin : -1;
+					}
+				}
+			}
+			//Where the intersections are snapped, a loop may walk a segment back and forth, and an edge of the face may lie on a
+			//segment walked the other way: only the twins within the face that agree are kept.
+			for(size_t i=0;i<faceTriangles.size();i++)
+			{
+				int twin=sideTwins[i]-(int)faceOffset[side];
+				if(twin>=0 && sideTwins[twin]!=(int)(faceOffset[side]+i))
+					sideTwins[i]=-1;
+			}
+		}
+	}
+	//With adjacency: each corner of the chunk lying on a half-edge of the cut mesh, or on a segment of the section, is recorded.
+	void MapHalfEdges(size_t c)
+	{
+		for(int side=0;side<2;side++)
+		{
+			const vector<unsigned long long> & twinKeys=chunks[c].twinKeys[side];
+			int offset=(int)chunks[c].indexOffset[side];
+			for(size_t i=0;i<twinKeys.size();i++)
+			{
+				unsigned long long type=twinKeys[i] & CUT_TWIN_TYPE;
+				size_t h=(size_t)(twinKeys[i] & ~CUT_TWIN_TYPE);
+				if(type==CUT_TWIN_PIECE)
+					pieces[side][h]=offset+(int)i;
+				else if(type==CUT_TWIN_SEGMENT)
+					sectionVertexMap.Find(twinKeys[i] & ~CUT_TWIN_TYPE)->border[side]=offset+(int)i;
+			}
+			//A collapsed segment is bordered by the part of a half-edge instead: its border holds -2-halfEdge.
+			const vector<unsigned long long> & collapsed=chunks[c].collapsed[side];
+			for(size_t i=0;i<collapsed.size();i+=2)
+				sectionVertexMap.Find(collapsed[i] & ~CUT_TWIN_TYPE)->border[side]=-2-(int)(collapsed[i+1] & ~CUT_TWIN_TYPE);
+		}
+	}
+	//Last pass with adjacency: the twin keys of the chunk are converted to the twins of the result.
+	void LinkHalfEdges(size_t c)
+	{
+		for(int side=0;side<2;side++)
+		{
+			const vector<unsigned long long> & twinKeys=chunks[c].twinKeys[side];
+			int offset=(int)chunks[c].indexOffset[side];
+			int* sideTwins=sides[side]->adjacency.twins.data()+offset;
+			for(size_t i=0;i<twinKeys.size();i++)
+			{
+				unsigned long long type=twinKeys[i] & CUT_TWIN_TYPE;
+				size_t h=(size_t)(twinKeys[i] & ~CUT_TWIN_TYPE);
+				if(type==CUT_TWIN_LOCAL)
+					sideTwins[i]=offset+(int)h;
+				else if(type==CUT_TWIN_SEGMENT)
+					sideTwins[i]=sectionVertexMap.Find(twinKeys[i] & ~CUT_TWIN_TYPE)->face[side];
+				else
+					sideTwins[i]=twins[h]<0? -1 : pieces[side][twins[h]];
+			}
+		}
+	}
+};
@@ -0,0 +1,352 @@
+/*
+MeshDecimator class:
+This class simplifies a triangular mesh by edge collapses, ordered by the quadric error metric (Garland and Heckbert).
+Each vertex gets the quadric of the planes of its triangles, weighted by their area: it measures the sum of the squared distances
+of a point from those planes. Collapsing a vertex u into a neighbour v moves u onto v, so the error of the collapse is the
+quadric of both vertices evaluated at the position of v; the cheapest collapses are performed first, and v inherits the sum of
+the two quadrics.
+These are half-edge collapses: no new vertex is created, so the normals and texture coordinates of the kept vertices are left as
+they are. The vertices on a border of the triangles, or shared by several vertices with the same position (seams, and the edge
+between the surface of a piece and its section), are never removed, so the mesh keeps its silhouette and does not open cracks.
+A collapse is refused if it would make an edge shared by more than two triangles, join two locked vertices by a new edge, or
+flip a triangle around u.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <stddef.h>
+#include <limits.h>
+#include <glm/glm.hpp>
+#include <utils/vertex.h>
+
+//A collapse is refused if a triangle around the removed vertex turns by more than this angle cosine.
+#define DECIMATE_MIN_NORMAL_COS 0.2f
+
+class MeshDecimator
+{
+public:
+	//Collapses edges until the mesh has at most targetTriangles triangles, or the cheapest collapse has an error larger than maxError
+	//(a squared distance); then the removed triangles and the unused vertices are dropped from vertices and indices.
+	void Decimate(vector<Vertex> & vertices, vector<unsigned int> & indices, size_t targetTriangles, float maxError)
+	{
+		this->vertices=&vertices;
+		this->indices=&indices;
+		size_t vertexCount=vertices.size();
+		size_t triangleCount=indices.size()/3;
+		quadrics.assign(vertexCount, Quadric());
+		vertexTriangles.assign(vertexCount, vector<unsigned int>());
+		removedTriangles.assign(triangleCount, false);
+		removedVertices.assign(vertexCount, false);
+		stamps.assign(vertexCount, 0);
+		for(size_t t=0;t<triangleCount;t++)
+		{
+			glm::vec3 a=vertices[indices[3*t]].Position;
+			glm::vec3 b=vertices[indices[3*t+1]].Position;
+			glm::vec3 c=vertices[indices[3*t+2]].Position;
+			glm::vec3 normal=glm::cross(b-a, c-a);
+			float length=glm::length(normal);
+			Quadric plane;
+			if(length>0.0f)
+				plane=Quadric(normal/length, -glm::dot(normal/length, a), length*0.5f);
+			for(size_t k=0;k<3;k++)
+			{
+				quadrics[indices[3*t+k]].Add(plane);
+				vertexTriangles[indices[3*t+k]].push_back(t);
+			}
+		}
+		FindLockedVertices();
+
+		candidates=priority_queue<Collapse, vector<Collapse>, greater<Collapse>>();
+		for(size_t v=0;v<vertexCount;v++)
+			PushCollapse(v);
+		size_t liveTriangles=triangleCount;
+		while(liveTriangles>targetTriangles && !candidates.empty())
+		{
+			Collapse collapse=candidates.top();
+			candidates.pop();
+			if(collapse.stamp!=stamps[collapse.from] || removedVertices[collapse.from] || removedVertices[collapse.to])
+				continue;
+			if(collapse.error>maxError)
+				break;
+			if(!CanCollapse(collapse.from, collapse.to))
+			{
+				PushCollapse(collapse.from);
+				continue;
+			}
+			liveTriangles-=CollapseEdge(collapse.from, collapse.to);
+			//The errors of the vertices around v have changed with its quadric.
+			Neighbours(collapse.to, changed);
+			PushCollapse(collapse.to);
+			for(unsigned int i=0;i<changed.size();i++)
+				PushCollapse(changed[i]);
+		}
+		Compact();
+	}
+
+private:
+	//Symmetric 4x4 matrix of a quadric, by its upper triangle; doubles, since the sums of many small triangles lose precision.
+	struct Quadric
+	{
+		double m[10];
+
+		Quadric()
+		{
+			fill(m, m+10, 0.0);
+		}
+		//Quadric of the plane n.p+d=0, weighted.
+		Quadric(glm::vec3 n, float d, float weight)
+		{
+			double a=n.x, b=n.y, c=n.z, e=d;
+			m[0]=a*a; m[1]=a*b; m[2]=a*c; m[3]=a*e;
+			m[4]=b*b; m[5]=b*c; m[6]=b*e;
+			m[7]=c*c; m[8]=c*e;
+			m[9]=e*e;
+			for(int i=0;i<10;i++)
+				m[i]*=weight;
+		}
+		void Add(const Quadric & other)
+		{
+			for(int i=0;i<10;i++)
+				m[i]+=other.m[i];
+		}
+		double Evaluate(glm::vec3 p) const
+		{
+			double x=p.x, y=p.y, z=p.z;
+			return m[0]*x*x+2.0*m[1]*x*y+2.0*m[2]*x*z+2.0*m[3]*x+
+					m[4]*y*y+2.0*m[5]*y*z+2.0*m[6]*y+
+					m[7]*z*z+2.0*m[8]*z+
+					m[9];
+		}
+	};
+	//Collapse of the vertex from into the vertex to; stamp is the one of from when the collapse was computed, so collapses
+	//computed before a change around from are skipped.
+	struct Collapse
+	{
+		float error;
+		unsigned int from;
+		unsigned int to;
+		unsigned int stamp;
+
+		bool operator>(const Collapse & other) const
+		{
+			return error>other.error;
+		}
+	};
+
+	vector<Vertex>* vertices;
+	vector<unsigned int>* indices;
+	vector<Quadric> quadrics;
+	//Triangles around each vertex; removed triangles are skipped rather than erased.
+	vector<vector<unsigned int>> vertexTriangles;
+	vector<bool> removedTriangles;
+	vector<bool> removedVertices;
+	vector<bool> locked;
+	vector<unsigned int> stamps;
+	priority_queue<Collapse, vector<Collapse>, greater<Collapse>> candidates;
+	vector<unsigned int> neighbours;
+	vector<unsigned int> fromNeighbours;
+	vector<unsigned int> toNeighbours;
+	vector<unsigned int> changed;
+	vector<unsigned int> remap;
+
+	//Locks the vertices of the border edges (walked by a single triangle) and the ones sharing their position with another vertex.
+	void FindLockedVertices()
+	{
+		const vector<unsigned int> & indices=*this->indices;
+		size_t vertexCount=vertices->size();
+		locked.assign(vertexCount, false);
+		unordered_set<unsigned long long> halfEdges;
+		halfEdges.reserve(indices.size());
+		for(size_t h=0;h<indices.size();h++)
+			halfEdges.insert(EdgeKey(indices[h], indices[Next(h)]));
+		for(size_t h=0;h<indices.size();h++)
+		{
+			if(halfEdges.count(EdgeKey(indices[Next(h)], indices[h])))
+				continue;
+			locked[indices[h]]=true;
+			locked[indices[Next(h)]]=true;
+		}
+		unordered_map<glm::vec3, unsigned int> positions;
+		positions.reserve(vertexCount);
+		for(size_t v=0;v<vertexCount;v++)
+		{
+			auto inserted=positions.emplace((*vertices)[v].Position, (unsigned int)v);
+			if(inserted.second)
+				continue;
+			locked[v]=true;
+			locked[inserted.first->second]=true;
+		}
+	}
+	static unsigned long long EdgeKey(unsigned int from, unsigned int to)
+	{
+		return ((unsigned long long)from<<32) | to;
+	}
+	static size_t Next(size_t h)
+	{
+		return h%3==2? h-2 : h+1;
+	}
+	//The vertices sharing a live triangle with v, without repetitions.
+	void Neighbours(unsigned int v, vector<unsigned int> & result) const
+	{
+		const vector<unsigned int> & indices=*this->indices;
+		result.clear();
+		for(unsigned int i=0;i<vertexTriangles[v].size();i++)
+		{
+			unsigned int t=vertexTriangles[v][i];
+			if(removedTriangles[t])
+				continue;
+			for(unsigned int k=0;k<3;k++)
+				if(indices[3*t+k]!=v)
+					result.push_back(indices[3*t+k]);
+		}
+		sort(result.begin(), result.end());
+		result.erase(unique(result.begin(), result.end()), result.end());
+	}
+	//Queues the cheapest valid collapse of v into one of its neighbours, if v can be removed.
+	void PushCollapse(unsigned int v)
+	{
+		stamps[v]++;
+		if(locked[v] || removedVertices[v])
+			return;
+		Neighbours(v, neighbours);
+		Collapse best;
+		best.from=v;
+		best.stamp=stamps[v];
+		bool found=false;
+		for(unsigned int i=0;i<neighbours.size();i++)
+		{
+			unsigned int to=neighbours[i];
+			Quadric quadric=quadrics[v];
+			quadric.Add(quadrics[to]);
+			float error=(float)max(quadric.Evaluate((*vertices)[to].Position), 0.0);
+			if((found && error>=best.error) || !CanCollapse(v, to))
+				continue;
+			best.error=error;
+			best.to=to;
+			found=true;
+		}
+		if(found)
+			candidates.push(best);
+	}
+	//Whether from can be moved onto to: the edge must be shared by exactly two triangles, whose opposite vertices are the only
+	//neighbours the two vertices have in common, and no other triangle around from may flip or degenerate. If to is locked, from
+//must not join it to another locked vertex.
+	bool CanCollapse(unsigned int from, unsigned int to)
+	{
+		const vector<unsigned int> & indices=*this->indices;
+		const vector<Vertex> & vertices=*this->vertices;
+		unsigned int shared=0;
+		for(unsigned int i=0;i<vertexTriangles[from].size();i++)
+		{
+			unsigned int t=vertexTriangles[from][i];
+			if(removedTriangles[t])
+				continue;
+			unsigned int k=0;
+			while(indices[3*t+k]!=from)
+				k++;
+			if(indices[3*t+(k+1)%3]==to || indices[3*t+(k+2)%3]==to)
+			{
+				shared++;
+				continue;
+			}
+			glm::vec3 a=vertices[indices[3*t]].Position;
+			glm::vec3 b=vertices[indices[3*t+1]].Position;
+			glm::vec3 c=vertices[indices[3*t+2]].Position;
+			glm::vec3 before=glm::cross(b-a, c-a);
+			glm::vec3 corners[3]={a, b, c};
+			corners[k]=vertices[to].Position;
+			glm::vec3 after=glm::cross(corners[1]-corners[0], corners[2]-corners[0]);
+			float lengths=glm::length(before)*glm::length(after);
+			if(lengths==0.0f || glm::dot(before, after)<DECIMATE_MIN_NORMAL_COS*lengths)
+				return false;
+		}
+		if(shared!=2)
+			return false;
+		Neighbours(from, fromNeighbours);
+		Neighbours(to, toNeighbours);
+		unsigned int common=0;
+		for(unsigned int i=0, j=0;i<fromNeighbours.size();)
+		{
+			if(j==toNeighbours.size() || fromNeighbours[i]<toNeighbours[j])
+			{
+				//A new edge between two locked vertices could match an edge of the triangles on the other side of a seam
+				//or of the section.
+				if(locked[to] && locked[fromNeighbours[i]] && fromNeighbours[i]!=to)
+					return false;
+				i++;
+			}
+			else if(toNeighbours[j]<fromNeighbours[i])
+				j++;
+			else
+			{
+				common++;
+				i++;
+				j++;
+			}
+		}
+		return common==2;
+	}
+	//Moves from onto to, removing the two triangles of their edge; returns the number of removed triangles.
+	size_t CollapseEdge(unsigned int from, unsigned int to)
+	{
+		vector<unsigned int> & indices=*this->indices;
+		size_t removed=0;
+		for(unsigned int i=0;i<vertexTriangles[from].size();i++)
+		{
+			unsigned int t=vertexTriangles[from][i];
+			if(removedTriangles[t])
+				continue;
+			if(indices[3*t]==to || indices[3*t+1]==to || indices[3*t+2]==to)
+			{
+				removedTriangles[t]=true;
+				removed++;
+				continue;
+			}
+			for(unsigned int k=0;k<3;k++)
+				if(indices[3*t+k]==from)
+					indices[3*t+k]=to;
+			vertexTriangles[to].push_back(t);
+		}
+		vertexTriangles[from].clear();
+		quadrics[to].Add(quadrics[from]);
+		removedVertices[from]=true;
+		return removed;
+	}
+	//Drops the removed triangles and the vertices no triangle uses anymore, keeping the order of the others.
+	void Compact()
+	{
+		vector<Vertex> & vertices=*this->vertices;
+		vector<unsigned int> & indices=*this->indices;
+		size_t liveIndices=0;
+		for(size_t t=0;t<indices.size()/3;t++)
+		{
+			if(removedTriangles[t])
+				continue;
+			for(size_t k=0;k<3;k++)
+				indices[liveIndices+k]=indices[3*t+k];
+			liveIndices+=3;
+		}
+		indices.resize(liveIndices);
+		remap.assign(vertices.size(), UINT_MAX);
+		for(size_t i=0;i<indices.size();i++)
+			remap[indices[i]]=0;
+		unsigned int liveVertices=0;
+		for(size_t v=0;v<vertices.size();v++)
+		{
+			if(remap[v]==UINT_MAX)
+				continue;
+			remap[v]=liveVertices;
+			vertices[liveVertices++]=vertices[v];
+		}
+		vertices.resize(liveVertices);
+		for(size_t i=0;i<indices.size();i++)
+			indices[i]=remap[indices[i]];
+	}
+};
@@ -0,0 +1,432 @@
+/*
+FractureHierarchy class:
+The fracture of a model baked offline (pre-fracture mode): a tree of pieces, obtained by cutting the model, then each piece
+again, up to BAKE_DEPTH times. Each node is a piece, with the geometry, the convex hull and the mass properties a cut would
+give it, and a few alternative splits: planes through its centroid, each with the two pieces it produces.
+At runtime a mesh made from a node, or the mesh of the model itself, which is the root, remembers it (see Mesh::fracture);
+when the mesh is cut by a single plane close enough to one of the splits of its node, the two baked pieces are swapped in and
+nothing is computed (see Scene::Cut). Otherwise the mesh is cut live, and its pieces leave the hierarchy.
+The vertices of all pieces are in a single VertexPool, in the frame of the model: they are uploaded once, when the hierarchy
+is loaded, so a piece only needs its own index buffer.
+
+FractureBaker class:
+Bakes the hierarchy of a model by cutting it with MeshCutter, as the live cuts do; it is run by GL_Ninja --bake, which saves
+the hierarchy next to the OBJ file of the model.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <glm/glm.hpp>
+#include <utils/mesh.h>
+
+//Levels of cuts below the model.
+#define BAKE_DEPTH 2
+//A cut uses a baked split if the angle between their planes is within this cosine, and the centroid of the split is closer
+//to the cut plane than this fraction of the radius of the piece.
+#define BAKE_COS_TOLERANCE 0.97f
+#define BAKE_DISTANCE_TOLERANCE 0.15f
+//Identifies the files of the hierarchies, and their version.
+#define BAKE_FILE_MAGIC 0x43415246u
+#define BAKE_FILE_VERSION 2u
+
+//A baked split of a piece: the plane, in the frame of the model, and the nodes of its positive and negative pieces.
+struct FractureSplit
+{
+	CutPlane plane;
+	int positive;
+	int negative;
+};
+
+struct FractureNode
+{
+	//The piece: its vertices in the pool of the hierarchy, its triangles and their adjacency (empty if the model has none).
+	//The root has no geometry of its own: it is the mesh of the model.
+	vector<GLuint> poolIndices;
+	vector<GLuint> indices;
+	vector<int> twins;
+	//Center of mass, in the frame of the model: the origin of the meshes of the piece.
+	glm::vec3 centroid;
+	//Radius of the bounding sphere around the centroid, which scales the distance tolerance of the splits.
+	float radius;
+	//Weight factor, inertia of unit mass and principal axes of the piece, as given by Mesh::CommitCut.
+	float weightFactor;
+	glm::vec3 inertia;
+	glm::mat3 axes;
+	//Points of the convex hull, in the frame of the rigid body: with respect to the centroid, along the axes.
+	vector<glm::vec3> hullPoints;
+	vector<FractureSplit> splits;
+	//Tree of the triangles, built on load for the large pieces; shared by their meshes.
+	shared_ptr<TriangleTree> tree;
+
+	FractureNode(): centroid(0.0f), radius(0.0f), weightFactor(1.0f), inertia(0.0f), axes(1.0f) {}
+};
+
+class FractureHierarchy
+{
+public:
+	shared_ptr<VertexPool> pool;
+	vector<FractureNode> nodes;
+	//Attributes of the vertices of the model (see Mesh::attributes).
+	unsigned int attributes=VERTEX_ALL_ATTRIBUTES;
+	//Size of the mesh of the model, which tells whether the file is stale.
+	uint64_t rootVertexCount=0;
+	uint64_t rootIndexCount=0;
+
+	//The file of the hierarchy of a model is next to its OBJ file, with the extension .frac.
+	static string BakedPath(const string & modelPath)
+	{
+		size_t dot=modelPath.find_last_of('.');
+		size_t slash=modelPath.find_last_of('/');
+		if(dot==string::npos || (slash!=string::npos && dot<slash))
+			return modelPath+".frac";
+		return modelPath.substr(0, dot)+".frac";
+	}
+	bool Save(const string & path) const
+	{
+		ofstream file(path, ios::binary);
+		if(!file)
+			return false;
+		Write(file, (uint32_t)BAKE_FILE_MAGIC);
+		Write(file, (uint32_t)BAKE_FILE_VERSION);
+		Write(file, (uint32_t)attributes);
+		Write(file, rootVertexCount);
+		Write(file, rootIndexCount);
+		WriteVector(file, pool->vertices);
+		Write(file, (uint64_t)nodes.size());
+		for(unsigned int n=0;n<nodes.size();n++)
+		{
+			const FractureNode & node=nodes[n];
+			WriteVector(file, node.poolIndices);
+			WriteVector(file, node.indices);
+			WriteVector(file, node.twins);
+			Write(file, node.centroid);
+			Write(file, node.radius);
+			Write(file, node.weightFactor);
+			Write(file, node.inertia);
+			Write(file, node.axes);
+			WriteVector(file, node.hullPoints);
+			WriteVector(file, node.splits);
+		}
+		return (bool)file;
+	}
+	//Loads the hierarchy of the given mesh of a model, and uploads its vertices; null if there is no file, or if it doesn't
+	//match the mesh.
+	static shared_ptr<FractureHierarchy> Load(const string & path, const Mesh & root)
+	{
+		ifstream file(path, ios::binary);
+		if(!file)
+			return nullptr;
+		shared_ptr<FractureHierarchy> hierarchy=make_shared<FractureHierarchy>();
+		uint32_t magic=0, version=0, attributes=0;
+		uint64_t nodeCount=0;
+		vector<Vertex> vertices;
+		Read(file, magic);
+		Read(file, version);
+		Read(file, attributes);
+		Read(file, hierarchy->rootVertexCount);
+		Read(file, hierarchy->rootIndexCount);
+		if(!file || magic!=BAKE_FILE_MAGIC || version!=BAKE_FILE_VERSION || attributes!=root.attributes ||
+			hierarchy->rootVertexCount!=root.vertexCount || hierarchy->rootIndexCount!=root.indices.size())
+		{
+			cout << "Baked fracture " << path << " doesn't match the model" << endl;
+			return nullptr;
+		}
+		hierarchy->attributes=attributes;
+		ReadVector(file, vertices);
+		Read(file, nodeCount);
+		hierarchy->nodes.resize(file? nodeCount : 0);
+		for(unsigned int n=0;n<hierarchy->nodes.size() && file;n++)
+		{
+			FractureNode & node=hierarchy->nodes[n];
+			ReadVector(file, node.poolIndices);
+			ReadVector(file, node.indices);
+			ReadVector(file, node.twins);
+			Read(file, node.centroid);
+			Read(file, node.radius);
+			Read(file, node.weightFactor);
+			Read(file, node.inertia);
+			Read(file, node.axes);
+			ReadVector(file, node.hullPoints);
+			ReadVector(file, node.splits);
+		}
+		if(!file || !hierarchy->Valid(vertices.size()))
+		{
+			cout << "Baked fracture " << path << " is corrupted" << endl;
+			return nullptr;
+		}
+		hierarchy->pool=make_shared<VertexPool>(std::move(vertices));
+		vector<Vertex> scratch;
+		for(unsigned int n=1;n<hierarchy->nodes.size();n++)
+		{
+			FractureNode & node=hierarchy->nodes[n];
+			if(node.indices.size()/3<TREE_MIN_TRIANGLES)
+				continue;
+			const Vertex* nodeVertices=Mesh::GatherVertices(hierarchy->pool->vertices.data(), node.poolIndices.data(), node.poolIndices.size(), scratch);
+			node.tree=make_shared<TriangleTree>();
+			node.tree->Build(nodeVertices, node.indices.data(), node.indices.size(), nullptr, false);
+		}
+		hierarchy->pool->Upload();
+		printf("Baked fracture pieces %d, vertices %d\n", (int)hierarchy->nodes.size()-1, (int)hierarchy->pool->vertices.size());
+		return hierarchy;
+	}
+	//The split of the node closest to the given plane (in the frame of the model) within the tolerances, or -1; flip tells
+	//whether the plane faces the other way, so that its positive side is the negative piece of the split.
+	int FindSplit(int node, const CutPlane & plane, bool & flip) const
+	{
+		const FractureNode & fractureNode=nodes[node];
+		int best=-1;
+		float bestScore=0.0f;
+		for(unsigned int s=0;s<fractureNode.splits.size();s++)
+		{
+			const CutPlane & split=fractureNode.splits[s].plane;
+			float cosine=glm::dot(split.normal, plane.normal);
+			float distance=glm::abs(glm::dot(plane.normal, split.point-plane.point))/max(fractureNode.radius, 1e-6f);
+			if(glm::abs(cosine)<BAKE_COS_TOLERANCE || distance>BAKE_DISTANCE_TOLERANCE)
+				continue;
+			float score=glm::abs(cosine)-distance;
+			if(best<0 || score>bestScore)
+			{
+				best=s;
+				bestScore=score;
+				flip=cosine<0.0f;
+			}
+		}
+		return best;
+	}
+	//The mesh of a piece, uploaded: it shares the vertex buffer of the hierarchy, so only its indices are uploaded.
+	static Mesh Piece(const shared_ptr<FractureHierarchy> & hierarchy, int node, const vector<Texture> & textures)
+	{
+		const FractureNode & fractureNode=hierarchy->nodes[node];
+		Mesh mesh(hierarchy->pool, fractureNode.poolIndices, fractureNode.indices, textures, false);
+		mesh.adjacency.twins=fractureNode.twins;
+		mesh.tree=fractureNode.tree;
+		mesh.attributes=hierarchy->attributes;
+		mesh.origin=fractureNode.centroid;
+		mesh.axes=fractureNode.axes;
+		mesh.boundingRadius=fractureNode.radius;
+		mesh.fracture=hierarchy;
+		mesh.fractureNode=node;
+		mesh.Upload();
+		return mesh;
+	}
+	//Frees the vertex buffer, once no mesh uses it.
+	void Delete()
+	{
+		if(pool && pool.use_count()==1)
+			pool->Delete();
+		pool.reset();
+		nodes.clear();
+	}
+
+private:
+	template<class T>
+	static void Write(ofstream & file, const T & value)
+	{
+		file.write((const char*)&value, sizeof(T));
+	}
+	template<class T>
+	static void WriteVector(ofstream & file, const vector<T> & values)
+	{
+		Write(file, (uint64_t)values.size());
+		if(!values.empty())
+			file.write((const char*)values.data(), values.size()*sizeof(T));
+	}
+	template<class T>
+	static void Read(ifstream & file, T & value)
+	{
+		file.read((char*)&value, sizeof(T));
+	}
+	//Vectors larger than the rest of the file are rejected before they are allocated.
+	template<class T>
+	static void ReadVector(ifstream & file, vector<T> & values)
+	{
+		uint64_t count=0;
+		Read(file, count);
+		streampos position=file.tellg();
+		file.seekg(0, ios::end);
+		uint64_t remaining=(uint64_t)(file.tellg()-position);
+		file.seekg(position);
+		if(!file || count>remaining/sizeof(T))
+		{
+			file.setstate(ios::failbit);
+			values.clear();
+			return;
+		}
+		values.resize(count);
+		if(count>0)
+			file.read((char*)values.data(), count*sizeof(T));
+	}
+	//Whether all indices of the nodes are within range, so a damaged file can't make a mesh read outside its buffers.
+	bool Valid(size_t vertexCount) const
+	{
+		if(nodes.empty())
+			return false;
+		for(unsigned int n=0;n<nodes.size();n++)
+		{
+			const FractureNode & node=nodes[n];
+			for(unsigned int i=0;i<node.poolIndices.size();i++)
+				if(node.poolIndices[i]>=vertexCount)
+					return false;
+			for(unsigned int i=0;i<node.indices.size();i++)
+				if(node.indices[i]>=node.poolIndices.size())
+					return false;
+			if(!node.twins.empty() && node.twins.size()!=node.indices.size())
+				return false;
+			for(unsigned int i=0;i<node.twins.size();i++)
+				if(node.twins[i]>=(int)node.twins.size())
+					return false;
+			for(unsigned int s=0;s<node.splits.size();s++)
+			{
+				const FractureSplit & split=node.splits[s];
+				if(split.positive<=0 || split.negative<=0 || split.positive>=(int)nodes.size() || split.negative>=(int)nodes.size())
+					return false;
+			}
+		}
+		return true;
+	}
+};
+
+class FractureBaker
+{
+public:
+	//Bakes the hierarchy of the given mesh of a model, whose convex hull is given. Each piece is split by the three planes
+	//through its centroid perpendicular to the axes of the model.
+	void Bake(const Mesh & mesh, const btConvexHullShape* hull, ThreadPool* threadPool=nullptr)
+	{
+		hierarchy=FractureHierarchy();
+		hierarchy.attributes=mesh.attributes;
+		hierarchy.rootVertexCount=mesh.vertexCount;
+		hierarchy.rootIndexCount=mesh.indices.size();
+		hierarchy.nodes.assign(1, FractureNode());
+		pieces.assign(1, mesh);
+		hulls.assign(1, hull);
+		ownedHulls.clear();
+		depths.assign(1, 0);
+		FractureNode & root=hierarchy.nodes[0];
+		root.centroid=Centroid(mesh);
+		root.radius=Radius(mesh, root.centroid);
+
+		for(unsigned int n=0;n<hierarchy.nodes.size();n++)
+		{
+			if(depths[n]>=BAKE_DEPTH)
+				continue;
+			for(int axis=0;axis<3;axis++)
+			{
+				CutPlane plane;
+				plane.normal=glm::vec3(0.0f);
+				plane.normal[axis]=1.0f;
+				plane.point=hierarchy.nodes[n].centroid;
+				Split(n, plane, threadPool);
+			}
+		}
+		Flatten();
+		pieces.clear();
+		hulls.clear();
+		ownedHulls.clear();
+	}
+	const FractureHierarchy & Hierarchy() const
+	{
+		return hierarchy;
+	}
+
+private:
+	FractureHierarchy hierarchy;
+	//For each node, its mesh (sharing the pools of the cuts, as the live pieces do), its convex hull and its depth.
+	vector<Mesh> pieces;
+	vector<const btConvexHullShape*> hulls;
+	vector<unique_ptr<btConvexHullShape>> ownedHulls;
+	vector<int> depths;
+	//Cutter of all the splits, whose arenas are reused from a split to the next one.
+	MeshCutter cutter;
+
+	//Cuts the piece of node n by the plane, adding the two pieces as a split of the node; nothing is added if a piece is empty.
+	void Split(unsigned int n, const CutPlane & plane, ThreadPool* threadPool)
+	{
+		Mesh parent=pieces[n];
+		CutResult result;
+		parent.CutGeometry(cutter, result, plane, threadPool, hulls[n]);
+		if(result.positive.indices.empty() || result.negative.indices.empty())
+			return;
+		Mesh meshes[2];
+		glm::vec4 positions[2];
+		btConvexHullShape* shapes[2];
+		float weightFactors[2];
+		glm::vec3 inertias[2];
+		parent.CommitCut(result, meshes[0], meshes[1], positions[0], positions[1], glm::mat4(1.0f), shapes[0], shapes[1], weightFactors[0], weightFactors[1], inertias[0], inertias[1], false);
+		FractureSplit split;
+		split.plane=plane;
+		split.positive=hierarchy.nodes.size();
+		split.negative=hierarchy.nodes.size()+1;
+		hierarchy.nodes[n].splits.push_back(split);
+		for(int s=0;s<2;s++)
+		{
+			FractureNode node;
+			node.centroid=meshes[s].origin;
+			node.radius=Radius(meshes[s], node.centroid);
+			node.weightFactor=weightFactors[s];
+			node.inertia=inertias[s];
+			node.axes=meshes[s].axes;
+			HullClipper::ShapePoints(*shapes[s], node.hullPoints);
+			hierarchy.nodes.push_back(node);
+			pieces.push_back(meshes[s]);
+			ownedHulls.emplace_back(shapes[s]);
+			hulls.push_back(shapes[s]);
+			depths.push_back(depths[n]+1);
+		}
+	}
+	//Copies the vertices the pieces use to the pool of the hierarchy, once each: the pieces of a cut share most of them with
+	//the cut piece.
+	void Flatten()
+	{
+		map<pair<const VertexPool*, GLuint>, GLuint> poolIndices;
+		vector<Vertex> vertices;
+		for(unsigned int n=1;n<hierarchy.nodes.size();n++)
+		{
+			FractureNode & node=hierarchy.nodes[n];
+			const Mesh & piece=pieces[n];
+			node.poolIndices.resize(piece.vertexCount);
+			for(GLuint i=0;i<piece.vertexCount;i++)
+			{
+				GLuint poolIndex=piece.PoolIndex(i);
+				auto inserted=poolIndices.insert(make_pair(make_pair((const VertexPool*)piece.pool.get(), poolIndex), (GLuint)vertices.size()));
+				if(inserted.second)
+					vertices.push_back(piece.pool->vertices[poolIndex]);
+				node.poolIndices[i]=inserted.first->second;
+			}
+			node.indices=piece.indices;
+			node.twins=piece.adjacency.twins;
+		}
+		hierarchy.pool=make_shared<VertexPool>(std::move(vertices));
+	}
+	//Center of mass of a closed mesh, or the mean of its vertices.
+	static glm::vec3 Centroid(const Mesh & mesh)
+	{
+		VolumeIntegrals integrals;
+		glm::vec3 mean(0.0f);
+		for(GLuint i=0;i<mesh.vertexCount;i++)
+			mean+=mesh.GetVertex(i).Position;
+		mean/=max((float)mesh.vertexCount, 1.0f);
+		for(unsigned int i=0;i+2<mesh.indices.size();i+=3)
+			integrals.AddTriangle(mesh.GetVertex(mesh.indices[i]).Position-mean, mesh.GetVertex(mesh.indices[i+1]).Position-mean, mesh.GetVertex(mesh.indices[i+2]).Position-mean);
+		if(integrals.volume<=CUT_MIN_VOLUME)
+			return mean;
+		return mean+integrals.moment/integrals.volume;
+	}
+	static float Radius(const Mesh & mesh, glm::vec3 center)
+	{
+		float radius=0.0f;
+		for(GLuint i=0;i<mesh.vertexCount;i++)
+			radius=max(radius, glm::length(mesh.GetVertex(i).Position-center));
+		return radius;
+	}
+};
@@ -0,0 +1,93 @@
+/*
+HalfEdgeMesh class:
+The half-edge adjacency of a triangular mesh. Half-edges are implicit in the indices: half-edge h belongs to the triangle h/3
+and goes from the vertex indices[h] to the next vertex of the triangle; so only the twin of each half-edge is stored, that is
+the same edge walked the opposite way by the neighbouring triangle, or -1 on the boundary.
+Twins are matched by the positions of the vertices, not by their indices: the triangles on the two sides of a seam (where
+vertices are duplicated for their normals or texture coordinates) are neighbours too. Edges shared by more than two triangles,
+or by two triangles walking them the same way, are treated as boundary.
+The adjacency is built once, when a model is loaded; then each cut derives the adjacency of its pieces from the one of the cut
+mesh (see MeshCutter).
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <stddef.h>
+#include <utils/vertex.h>
+
+class HalfEdgeMesh
+{
+public:
+	//Twin of each half-edge, -1 on the boundary.
+	vector<int> twins;
+
+	//Builds the adjacency of the given triangles.
+	void Build(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount)
+	{
+		//Vertices with the same position get the same identifier.
+		unordered_map<glm::vec3, unsigned int> positionIds;
+		positionIds.reserve(vertexCount);
+		vector<unsigned int> ids(vertexCount);
+		for(size_t v=0;v<vertexCount;v++)
+			ids[v]=positionIds.emplace(vertices[v].Position, (unsigned int)positionIds.size()).first->second;
+
+		//Half-edges are sorted by their edge, so the ones of the same edge are next to each other.
+		vector<EdgeEntry> edges(indexCount);
+		for(size_t h=0;h<indexCount;h++)
+		{
+			unsigned int source=ids[indices[h]];
+			unsigned int target=ids[indices[Next(h)]];
+			edges[h].key=source<target? ((unsigned long long)source<<32) | target : ((unsigned long long)target<<32) | source;
+			edges[h].halfEdge=(int)h;
+			edges[h].forward=source<target;
+		}
+		sort(edges.begin(), edges.end(), [](const EdgeEntry & a, const EdgeEntry & b)
+		{
+			return a.key<b.key || (a.key==b.key && a.halfEdge<b.halfEdge);
+		});
+		twins.assign(indexCount, -1);
+		for(size_t i=0;i<indexCount;)
+		{
+			size_t end=i+1;
+			while(end<indexCount && edges[end].key==edges[i].key)
+				end++;
+			if(end-i==2 && edges[i].forward!=edges[i+1].forward)
+			{
+				twins[edges[i].halfEdge]=edges[i+1].halfEdge;
+				twins[edges[i+1].halfEdge]=edges[i].halfEdge;
+			}
+			i=end;
+		}
+	}
+	bool Empty() const
+	{
+		return twins.empty();
+	}
+	//The twins, or null if the adjacency has not been built; cuts read them through this pointer, like the vertices and indices.
+	const int* Twins() const
+	{
+		return twins.empty()? nullptr : twins.data();
+	}
+	//The half-edge following the given one in its triangle.
+	static size_t Next(size_t halfEdge)
+	{
+		return halfEdge-halfEdge%3+(halfEdge+1)%3;
+	}
+	static size_t Previous(size_t halfEdge)
+	{
+		return halfEdge-halfEdge%3+(halfEdge+2)%3;
+	}
+
+private:
+	struct EdgeEntry
+	{
+		unsigned long long key;
+		int halfEdge;
+		bool forward;
+	};
+};
@@ -0,0 +1,209 @@
+/*
+HullClipper class:
+This class computes the convex hulls of the pieces of a cut from the convex hull of the cut mesh, instead of the vertices of
+the produced meshes: the hull is split by the cutting plane, and the points where its edges cross the plane are added to both
+sides. Since the pieces of a convex hull cut by a plane are convex, the result is exactly the hull of each side of the cut
+hull, and the cost depends on the number of points of the hull (usually tens), not on the vertices of the mesh.
+The edges of the hull are computed by btConvexHullComputer; this also drops the points lying inside the hull, so the hulls
+built from all the vertices of a model shrink to their real vertices at the first cut.
+Hulls can also be simplified to a budget of points, since the cost of each collision query against a hull grows with its points.
+All points are in object space of the cut mesh.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <vector>
+#include <math.h>
+#include <glm/glm.hpp>
+#include <LinearMath/btConvexHullComputer.h>
+#include <btConvexHullShape.h>
+
+//Points closer than this to the plane are considered on it, and they belong to both sides.
+#define HULL_CLIP_EPSILON 1e-5f
+//Maximum number of points of the convex hulls given to the physics engine.
+#define HULL_POINT_BUDGET 64
+
+class HullClipper
+{
+public:
+	//Splits the hull of the given points by the plane, appending the points of each side to positive and negative.
+	void Split(const vector<glm::vec3> & points, glm::vec3 planeNormal, glm::vec3 planePoint, vector<glm::vec3> & positive, vector<glm::vec3> & negative)
+	{
+		ComputeHull(points);
+		Classify(planeNormal, planePoint);
+		for(int i=0;i<hull.vertices.size();i++)
+		{
+			if(distances[i]>=-HULL_CLIP_EPSILON)
+				positive.push_back(HullVertex(i));
+			if(distances[i]<=HULL_CLIP_EPSILON)
+				negative.push_back(HullVertex(i));
+		}
+		for(int e=0;e<hull.edges.size();e++)
+		{
+			glm::vec3 intersection;
+			if(EdgeIntersection(e, intersection))
+			{
+				positive.push_back(intersection);
+				negative.push_back(intersection);
+			}
+		}
+	}
+	//Keeps only the part of the hull of points in the positive half space of the plane.
+	void Clip(vector<glm::vec3> & points, glm::vec3 planeNormal, glm::vec3 planePoint)
+	{
+		bool allPositive=true;
+		bool allNegative=true;
+		for(unsigned int i=0;i<points.size();i++)
+		{
+			float distance=glm::dot(planeNormal, points[i]-planePoint);
+			allPositive=allPositive && distance>=-HULL_CLIP_EPSILON;
+			allNegative=allNegative && distance<HULL_CLIP_EPSILON;
+		}
+		if(allPositive)
+			return;
+		if(allNegative)
+		{
+			points.clear();
+			return;
+		}
+		clipped.clear();
+		discarded.clear();
+		Split(points, planeNormal, planePoint, clipped, discarded);
+		points.assign(clipped.begin(), clipped.end());
+	}
+	//Keeps only the vertices of the hull of points.
+	void Reduce(vector<glm::vec3> & points)
+	{
+		ComputeHull(points);
+		if(hull.vertices.size()==0)
+			return;
+		points.resize(hull.vertices.size());
+		for(int i=0;i<hull.vertices.size();i++)
+			points[i]=HullVertex(i);
+	}
+	//Keeps at most budget points of the hull of points: the farthest one along each of budget directions, evenly spread on the
+	//sphere. The simplified hull lies inside the original one; the returned value is the fraction of its volume that is lost.
+	float Simplify(vector<glm::vec3> & points, unsigned int budget)
+	{
+		Reduce(points);
+		if(points.size()<=budget)
+			return 0.0f;
+		float volume=HullVolume();
+		kept.assign(points.size(), false);
+		clipped.clear();
+		for(unsigned int d=0;d<budget;d++)
+		{
+			glm::vec3 direction=SphereDirection(d, budget);
+			unsigned int farthest=0;
+			float farthestDistance=glm::dot(points[0], direction);
+			for(unsigned int i=1;i<points.size();i++)
+			{
+				float distance=glm::dot(points[i], direction);
+				if(distance>farthestDistance)
+				{
+					farthest=i;
+					farthestDistance=distance;
+				}
+			}
+			if(!kept[farthest])
+			{
+				kept[farthest]=true;
+				clipped.push_back(points[farthest]);
+			}
+		}
+		points.assign(clipped.begin(), clipped.end());
+		ComputeHull(points);
+		return volume>0.0f? 1.0f-HullVolume()/volume : 0.0f;
+	}
+	//Copies the points of a hull shape in points, rotated by rotation and then moved by offset.
+	static void ShapePoints(const btConvexHullShape & shape, vector<glm::vec3> & points, glm::vec3 offset=glm::vec3(0.0f), glm::mat3 rotation=glm::mat3(1.0f))
+	{
+		points.resize(shape.getNumPoints());
+		const btVector3* shapePoints=shape.getUnscaledPoints();
+		for(int i=0;i<shape.getNumPoints();i++)
+			points[i]=rotation*glm::vec3(shapePoints[i].x(), shapePoints[i].y(), shapePoints[i].z())+offset;
+	}
+	//Builds a hull shape from all the points at once, so its bounding box is computed once.
+	static btConvexHullShape* CreateShape(const vector<glm::vec3> & points)
+	{
+		if(points.empty())
+			return new btConvexHullShape();
+		return new btConvexHullShape(&points[0].x, points.size(), sizeof(glm::vec3));
+	}
+
+private:
+	btConvexHullComputer hull;
+	//Signed distance of each vertex of the hull from the plane.
+	vector<float> distances;
+	//Scratch buffers of Clip and Simplify, reused from a call to the next one; the points are copied back rather than swapped,
+	//so each buffer keeps its capacity.
+	vector<glm::vec3> clipped;
+	vector<glm::vec3> discarded;
+	vector<bool> kept;
+
+	void ComputeHull(const vector<glm::vec3> & points)
+	{
+		hull.vertices.clear();
+		hull.edges.clear();
+		hull.faces.clear();
+		if(!points.empty())
+			hull.compute(&points[0].x, sizeof(glm::vec3), points.size(), 0.0f, 0.0f);
+	}
+	//Volume of the last computed hull: each face is a fan of triangles, forming tetrahedra with the first vertex.
+	float HullVolume() const
+	{
+		if(hull.vertices.size()==0)
+			return 0.0f;
+		glm::vec3 apex=HullVertex(0);
+		float volume=0.0f;
+		for(int f=0;f<hull.faces.size();f++)
+		{
+			const btConvexHullComputer::Edge* first=&hull.edges[hull.faces[f]];
+			glm::vec3 a=HullVertex(first->getSourceVertex())-apex;
+			for(const btConvexHullComputer::Edge* edge=first->getNextEdgeOfFace();edge->getTargetVertex()!=first->getSourceVertex();edge=edge->getNextEdgeOfFace())
+			{
+				glm::vec3 b=HullVertex(edge->getSourceVertex())-apex;
+				glm::vec3 c=HullVertex(edge->getTargetVertex())-apex;
+				volume+=glm::dot(a, glm::cross(b, c))/6.0f;
+			}
+		}
+		return fabs(volume);
+	}
+	//The i-th of count directions on a Fibonacci spiral, which covers the sphere almost evenly.
+	static glm::vec3 SphereDirection(unsigned int i, unsigned int count)
+	{
+		float z=1.0f-(2.0f*i+1.0f)/count;
+		float radius=sqrt(1.0f-z*z);
+		float angle=i*2.39996323f;
+		return glm::vec3(radius*cos(angle), radius*sin(angle), z);
+	}
+	void Classify(glm::vec3 planeNormal, glm::vec3 planePoint)
+	{
+		distances.resize(hull.vertices.size());
+		for(int i=0;i<hull.vertices.size();i++)
+			distances[i]=glm::dot(planeNormal, HullVertex(i)-planePoint);
+	}
+	glm::vec3 HullVertex(int i) const
+	{
+		return glm::vec3(hull.vertices[i].x(), hull.vertices[i].y(), hull.vertices[i].z());
+	}
+	//Each edge is stored twice, once for each direction: only the one leaving the vertex with the lower index is used.
+	bool EdgeIntersection(int e, glm::vec3 & intersection) const
+	{
+		int source=hull.edges[e].getSourceVertex();
+		int target=hull.edges[e].getTargetVertex();
+		if(source>target)
+			return false;
+		float sourceDistance=distances[source];
+		float targetDistance=distances[target];
+		bool crossing=(sourceDistance>HULL_CLIP_EPSILON && targetDistance<-HULL_CLIP_EPSILON) ||
+						(sourceDistance<-HULL_CLIP_EPSILON && targetDistance>HULL_CLIP_EPSILON);
+		if(!crossing)
+			return false;
+		float t=sourceDistance/(sourceDistance-targetDistance);
+		intersection=HullVertex(source)+(HullVertex(target)-HullVertex(source))*t;
+		return true;
+	}
+};
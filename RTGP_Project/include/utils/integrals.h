@@ -0,0 +1,80 @@
+/*
+VolumeIntegrals struct:
+The mass properties of the volume enclosed by a closed mesh, accumulated triangle by triangle; they are shared by the cut
+(MeshCutter, MeshSlicer) and by the clusters of triangles of a mesh (TriangleTree), whose sums are added to a cut at once.
+VolumeIntegrals::PrincipalAxes diagonalises the inertia tensor they give, for the rigid bodies of the pieces (see Mesh::axes).
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <math.h>
+#include <glm/glm.hpp>
+
+//Sweeps of the Jacobi method over the off-diagonal elements of an inertia tensor; it converges quadratically, so a 3x3
+//tensor is diagonal to float precision after a handful of them.
+#define INERTIA_JACOBI_SWEEPS 16
+
+//Integrals over the volume enclosed by a closed mesh, computed by the divergence theorem: each triangle, together with a
+//common apex, is a signed tetrahedron, and the integrals of the tetrahedra are summed. Positions are relative to the apex.
+struct VolumeIntegrals
+{
+	float volume;
+	//Integral of the position
+	glm::vec3 moment;
+	//Integral of the outer product of the position with itself
+	glm::mat3 covariance;
+
+	VolumeIntegrals(): volume(0.0f), moment(0.0f), covariance(0.0f) {}
+
+	void AddTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+	{
+		float determinant=glm::dot(a, glm::cross(b, c));
+		glm::vec3 sum=a+b+c;
+		volume+=determinant/6.0f;
+		moment+=sum*(determinant/24.0f);
+		covariance+=(glm::outerProduct(a, a)+glm::outerProduct(b, b)+glm::outerProduct(c, c)+glm::outerProduct(sum, sum))*(determinant/120.0f);
+	}
+	void Add(const VolumeIntegrals & other)
+	{
+		volume+=other.volume;
+		moment+=other.moment;
+		covariance+=other.covariance;
+	}
+	//Principal moments of the symmetric tensor, and the rotation whose columns are the principal axes, so that the tensor is
+	//axes*diag(moments)*transpose(axes). The tensor is diagonalised by Jacobi rotations, each one zeroing an off-diagonal element;
+	//being their product, the axes are a right-handed frame.
+	static void PrincipalAxes(const glm::mat3 & tensor, glm::mat3 & axes, glm::vec3 & moments)
+	{
+		glm::mat3 a=tensor;
+		axes=glm::mat3(1.0f);
+		for(int sweep=0;sweep<INERTIA_JACOBI_SWEEPS;sweep++)
+		{
+			float offDiagonal=a[1][0]*a[1][0]+a[2][0]*a[2][0]+a[2][1]*a[2][1];
+			float diagonal=a[0][0]*a[0][0]+a[1][1]*a[1][1]+a[2][2]*a[2][2];
+			if(offDiagonal<=1e-14f*diagonal)
+				break;
+			for(int p=0;p<2;p++)
+			{
+				for(int q=p+1;q<3;q++)
+				{
+					if(a[q][p]==0.0f)
+						continue;
+					float theta=(a[q][q]-a[p][p])/(2.0f*a[q][p]);
+					float t=(theta>=0.0f? 1.0f : -1.0f)/(fabs(theta)+sqrt(theta*theta+1.0f));
+					float c=1.0f/sqrt(t*t+1.0f);
+					float s=t*c;
+					glm::mat3 rotation(1.0f);
+					rotation[p][p]=c;
+					rotation[q][q]=c;
+					rotation[q][p]=s;
+					rotation[p][q]=-s;
+					a=glm::transpose(rotation)*a*rotation;
+					axes=axes*rotation;
+				}
+			}
+		}
+		moments=glm::vec3(a[0][0], a[1][1], a[2][2]);
+	}
+};
@@ -13,7 +13,8 @@ class Log
 public:
 	typedef std::chrono::high_resolution_clock Time;
 	
-	void InitLog(string funcName)
+	//The name is not copied, so that timing a function takes no memory from the heap: it must be a literal.
+	void InitLog(const char* funcName)
 	{
 		this->funcName=funcName;
 		start = high_resolution_clock::now();
@@ -26,7 +27,7 @@ public:
 	}
 	
 private:
-	string funcName;
+	const char* funcName;
 	TimePoint start;
 	TimePoint end;
 };
\ No newline at end of file
@@ -1,10 +1,17 @@
 /*
 Mesh class:
 This class store and manage all data structures that define a triangular mesh on the gpu.
-Here there is the implementation of the cut method, which is the core of this project.
-Each cut produces two new meshes: the positive and negative one.
+Here there is the entry point of the cut method, which is the core of this project: the geometry is computed on the cpu
+by the MeshCutter class (cut.h), then it is uploaded on the gpu as a separate stage.
+Each cut produces two new meshes: the positive and negative one; a slice by several planes (MeshSlicer class, slice.h)
+produces a mesh for each cell the planes divide the space in.
 All points of the positive mesh lies in the half space(defined by the cut segment), where the half
 plane test returns positive values (in this case, the plane is defined by the cutting segment).
+The vertices are stored in a VertexPool (pool.h), shared by a mesh and the pieces of its cuts: each piece indexes the vertices
+it has copied from the cut mesh in the pool, and only the vertices created by the cut are appended and uploaded. The vertices
+keep the frame of the pool; origin is the position of the center of mass of the mesh in it, and axes are its principal axes of
+inertia, so the model transform of the rigid body is applied after a translation by -origin and a rotation by the inverse of
+axes (Bullet keeps only the diagonal of the inertia tensor, in the frame of the body).
 */
 
 #pragma once
@@ -12,6 +19,7 @@ plane test returns positive values (in this case, the plane is defined by the cu
 using namespace std;
 
 #include <stdlib.h> 
+#include <assert.h>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -20,496 +28,147 @@ using namespace std;
 #include <set>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <btConvexHullShape.h>
 #include <utils/vertex.h>
+#include <utils/pool.h>
+#include <utils/halfedge.h>
+#include <utils/tree.h>
+#include <utils/cut.h>
+#include <utils/slice.h>
+#include <utils/decimate.h>
 #include <utils/texture.h>
 
-namespace std
-{
-	template<>
-	struct hash<glm::vec3>
-	{
-		size_t operator()(const glm::vec3& v) const
-		{
-			return std::hash<float>{}(v.x) || std::hash<float>{}(v.y) << 2 || std::hash<float>{}(v.z) >> 2;
-		}
-	};
-	
-	template<>
-	struct hash<Vertex>
-	{
-		size_t operator()(const Vertex& v) const
-		{
-			return std::hash<float>{}(v.Position.x) || std::hash<float>{}(v.Position.y) << 2 || std::hash<float>{}(v.Position.z) >> 2;
-		}
-	};
-}
+class FractureHierarchy;
 
 class Mesh {
 public:
-    vector<Vertex> vertices;
+    //Pool holding the vertices of the mesh; poolIndices maps each vertex of the mesh to its index in the pool, or it is empty if
+    //the mesh owns the first vertexCount vertices of the pool.
+    shared_ptr<VertexPool> pool;
+    vector<GLuint> poolIndices;
+    size_t vertexCount=0;
+    //Position of the center of mass in the frame of the vertices.
+    glm::vec3 origin=glm::vec3(0.0f);
+    //Rotation from the frame of the rigid body to the one of the vertices: its columns are the principal axes of inertia.
+    //It is the identity for the models, whose bodies get the inertia of their convex hull.
+    glm::mat3 axes=glm::mat3(1.0f);
+    //Radius of the bounding sphere of the vertices around origin; negative until BoundingRadius computes it.
+    float boundingRadius=-1.0f;
+    //Fraction of the volume of the model that this mesh comes from (of its area, if the model is open): the product of the
+    //weight factors of the cuts that made it.
+    float modelFraction=1.0f;
+    //Triangles, as indices of the vertices of the mesh (not of the pool).
     vector<GLuint> indices;
     vector<Texture> textures;
-    GLuint VAO;
+    //Half-edge adjacency of the triangles; empty unless built by BuildAdjacency, then the cuts keep it for the pieces.
+    HalfEdgeMesh adjacency;
+    //Tree of the triangles, null unless built by BuildTree; then the cuts build one for the large pieces.
+    shared_ptr<TriangleTree> tree;
+    //Attributes the vertices have besides the position (see VERTEX_NORMAL), set when the model is loaded; the pieces of the
+    //cuts inherit them.
+    unsigned int attributes=VERTEX_ALL_ATTRIBUTES;
+    //Baked fracture of the model, and the node of this mesh in it, if the mesh is the model or one of its baked pieces
+    //(see FractureHierarchy); null otherwise, and for the pieces of live cuts.
+    shared_ptr<FractureHierarchy> fracture;
+    int fractureNode=-1;
+    GLuint VAO=0;
 
 	Mesh(){}
     //CONSTRUCTOR
-	Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures)
+	Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, bool upload=true)
+	{
+        this->pool = make_shared<VertexPool>(std::move(vertices));
+        this->vertexCount = this->pool->vertices.size();
+        this->indices = std::move(indices);
+        this->textures = textures;
+		if(upload)
+			this->setupMesh();
+	}
+	//A mesh whose vertices are the given ones of a shared pool.
+	Mesh(shared_ptr<VertexPool> pool, vector<GLuint> poolIndices, vector<GLuint> indices, vector<Texture> textures, bool upload=true)
 	{
-        this->vertices = vertices;
-        this->indices = indices;
+        this->pool = std::move(pool);
+        this->poolIndices = std::move(poolIndices);
+        this->vertexCount = this->poolIndices.size();
+        this->indices = std::move(indices);
         this->textures = textures;
+		if(upload)
+			this->setupMesh();
+	}
+	//Whether the mesh is rendered or not, it needs its buffers on the gpu; this method uploads them.
+	//Meshes built from a cut are not uploaded by the cut itself, so this stage can be performed later and only on the GL thread.
+	void Upload()
+	{
 		this->setupMesh();
 	}
-	//This method calculates the area of the triangle defined by a, b, c vertices; it is used, together with the method below,
-	//to calculate the new pivots, needed after each cut.
-	float CalculateTriangleArea(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+	//Index in the pool of the given vertex of the mesh.
+	GLuint PoolIndex(GLuint vertex) const
 	{
-		glm::vec3 ba=b-a;
-		glm::vec3 ca=c-a;
-		glm::vec3 cross=glm::cross(ba, ca);
-		return (glm::sqrt(cross.x*cross.x+cross.y*cross.y+cross.z*cross.z))*0.5f;
+		return poolIndices.empty()? vertex : poolIndices[vertex];
 	}
-	glm::vec3 CalculateTriangleCenter(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+	const Vertex & GetVertex(GLuint vertex) const
 	{
-		glm::vec3 triangleCenter=(a+b+c)/3.0f;
-		return triangleCenter;
+		return pool->vertices[PoolIndex(vertex)];
 	}
-	//Whether a cut occurs, some new points must be generated for all triangle which intersect the cutting plane.
-	//This method returns a vector containing the new vertices, obtained from the intersection of the cutting plane and the triangle a, b, c.
-	//Intfactors is the vector that holds the interpolation factors; each interpolation factor specifies if there is or not, intersection on a particular
-	//segment of the triangle a, b, c.
-	//For instance, if the condition 0.0f<=intFactors[0]<=1.0f is true, the cutting plane intersects the segment a, b of the triangle; so it's possible
-	//to obtain the new vertex, by linear interpolating between a and b.
-	//Intfactors[0] -> interpolation between a, b
-	//Intfactors[1] -> interpolation between b, c
-	//Intfactors[2] -> interpolation between c, a
-	vector<Vertex> CalculateNewVertices(Vertex a, Vertex b, Vertex c, glm::vec4 planeNormal, glm::vec4 planePoint, float* intFactors)
+	//The vertices of the mesh as a contiguous array: the pool itself if the mesh owns its first vertices, otherwise they are
+	//gathered in scratch.
+	const Vertex* LocalVertices(vector<Vertex> & scratch) const
 	{
-		vector<Vertex> newVertices;
-		Vertex tmp;
-		//a, b
-		if(0.0f<=intFactors[0] && intFactors[0]<=1.0f)
-		{
-			tmp=Vertex();
-			tmp.Position=b.Position*intFactors[0]+a.Position*(1.0f-intFactors[0]);
-			tmp.Normal=b.Normal*intFactors[0]+a.Normal*(1.0f-intFactors[0]);
-			tmp.Tangent=b.Tangent*intFactors[0]+a.Tangent*(1.0f-intFactors[0]);
-			tmp.Bitangent=b.Bitangent*intFactors[0]+a.Bitangent*(1.0f-intFactors[0]);
-			newVertices.push_back(tmp);
-		}
-		//b, c		
-		if(0.0f<=intFactors[1] && intFactors[1]<=1.0f)
-		{
-			tmp=Vertex();
-			tmp.Position=c.Position*intFactors[1]+b.Position*(1.0f-intFactors[1]);
-			tmp.Normal=c.Normal*intFactors[1]+b.Normal*(1.0f-intFactors[1]);
-			tmp.Tangent=c.Tangent*intFactors[1]+b.Tangent*(1.0f-intFactors[1]);
-			tmp.Bitangent=c.Bitangent*intFactors[1]+b.Bitangent*(1.0f-intFactors[1]);
-			newVertices.push_back(tmp);
-		}
-		//c, a	
-		if(0.0f<=intFactors[2] && intFactors[2]<=1.0f)
-		{
-			tmp=Vertex();
-			tmp.Position=c.Position*intFactors[2]+a.Position*(1.0f-intFactors[2]);
-			tmp.Normal=c.Normal*intFactors[2]+a.Normal*(1.0f-intFactors[2]);
-			tmp.Tangent=c.Tangent*intFactors[2]+a.Tangent*(1.0f-intFactors[2]);
-			tmp.Bitangent=c.Bitangent*intFactors[2]+a.Bitangent*(1.0f-intFactors[2]);
-			newVertices.push_back(tmp);
-		}
-		
-		return newVertices;
+		return GatherVertices(pool->vertices.data(), poolIndices.empty()? nullptr : poolIndices.data(), vertexCount, scratch);
 	}
-	//This function is called, only if a triangle of the mesh is divided by the cutting plane.
-	//all triangle cut by the plane must generate 3 new triangle, which are assigned to the positive or
-	//negative mesh, according how the cut has been performed.
-	//Furthermore, this method generate a new face to fill the empty section there would be after the cut.
-	//Finally these new triangles are then assigned to the positive and negative data structures.
-	void AddNewTriangle(glm::vec4 planePoint, 
-						glm::vec4 planeNormal,
-						Vertex & sectionVertexCentroid,
-						unordered_map<Vertex, int> & negativeSectionVertexIndexMap,
-						unordered_map<Vertex, vector<int>> & negativeVertexIndexMap,
-						vector<Vertex> & negativeMeshVertices, 
-						vector<GLuint> & negativeMeshIndices, 
-						glm::vec3 negativeCentroid,
-						float & negativeMeshTotalArea,
-						unordered_map<Vertex, int> & positiveSectionVertexIndexMap,
-						unordered_map<Vertex, vector<int>> & positiveVertexIndexMap,
-						vector<Vertex> & positiveMeshVertices, 
-						vector<GLuint> & positiveMeshIndices, 
-						glm::vec3 & positiveCentroid,
-						float & positiveMeshTotalArea,
-						vector<Vertex> newVertices,
-						vector<Vertex> triangleVertices)
+	//The same for the cuts running in background, which don't access the Mesh object (see Scene::StartCut).
+	static const Vertex* GatherVertices(const Vertex* poolVertices, const GLuint* poolIndices, size_t vertexCount, vector<Vertex> & scratch)
 	{
-		//True means positive, false negative.
-		bool aCheck=triangleVertices[0].PositiveOrNegativeSide(planeNormal, planePoint)>0.f;
-		bool bCheck=triangleVertices[1].PositiveOrNegativeSide(planeNormal, planePoint)>0.f;
-		bool cCheck=triangleVertices[2].PositiveOrNegativeSide(planeNormal, planePoint)>0.f;
-		
-		vector<Vertex> positiveVertices;
-		vector<Vertex> negativeVertices;
-		float triangleArea;
-		glm::vec3 triangleCenter;
-		
-		//6 cases
-		if(aCheck & !bCheck & !cCheck)
-		{
-			positiveVertices.push_back(triangleVertices[0]);
-			positiveVertices.push_back(newVertices[1]);
-			positiveVertices.push_back(newVertices[0]);
-			triangleArea=CalculateTriangleArea(triangleVertices[0].Position, newVertices[1].Position, newVertices[0].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[0].Position, newVertices[1].Position, newVertices[0].Position);
-			positiveCentroid+=(triangleArea*triangleCenter);
-			positiveMeshTotalArea+=triangleArea;
-			
-			negativeVertices.push_back(triangleVertices[1]);
-			negativeVertices.push_back(newVertices[0]);
-			negativeVertices.push_back(newVertices[1]);
-			triangleArea=CalculateTriangleArea(triangleVertices[1].Position, newVertices[0].Position, newVertices[1].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[1].Position, newVertices[0].Position, newVertices[1].Position);
-			negativeCentroid+=(triangleArea*triangleCenter);
-			negativeMeshTotalArea+=triangleArea;
-			
-			negativeVertices.push_back(triangleVertices[2]);
-			negativeVertices.push_back(triangleVertices[1]);
-			negativeVertices.push_back(newVertices[1]);
-			triangleArea=CalculateTriangleArea(triangleVertices[2].Position, triangleVertices[1].Position, newVertices[1].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[2].Position, triangleVertices[1].Position, newVertices[1].Position);
-			negativeCentroid+=(triangleArea*triangleCenter);
-			negativeMeshTotalArea+=triangleArea;
-		}
-		else if(!aCheck & bCheck & !cCheck)
-		{
-			positiveVertices.push_back(triangleVertices[1]);
-			positiveVertices.push_back(newVertices[1]);
-			positiveVertices.push_back(newVertices[0]);
-			triangleArea=CalculateTriangleArea(triangleVertices[1].Position, newVertices[1].Position, newVertices[0].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[1].Position, newVertices[1].Position, newVertices[0].Position);
-			positiveCentroid+=(triangleArea*triangleCenter);
-			positiveMeshTotalArea+=triangleArea;
-			
-			negativeVertices.push_back(triangleVertices[2]);
-			negativeVertices.push_back(newVertices[1]);
-			negativeVertices.push_back(newVertices[0]);
-			triangleArea=CalculateTriangleArea(triangleVertices[2].Position, newVertices[1].Position, newVertices[0].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[2].Position, newVertices[1].Position, newVertices[0].Position);
-			negativeCentroid+=(triangleArea*triangleCenter);
-			negativeMeshTotalArea+=triangleArea;
-			
-			negativeVertices.push_back(triangleVertices[0]);
-			negativeVertices.push_back(triangleVertices[2]);
-			negativeVertices.push_back(newVertices[0]);
-			triangleArea=CalculateTriangleArea(triangleVertices[0].Position, triangleVertices[2].Position, newVertices[0].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[0].Position, triangleVertices[2].Position, newVertices[0].Position);
-			negativeCentroid+=(triangleArea*triangleCenter);
-			negativeMeshTotalArea+=triangleArea;
-		}
-		else if(!aCheck & !bCheck & cCheck)
-		{
-			positiveVertices.push_back(triangleVertices[2]);
-			positiveVertices.push_back(newVertices[1]);
-			positiveVertices.push_back(newVertices[0]);
-			triangleArea=CalculateTriangleArea(triangleVertices[2].Position, newVertices[1].Position, newVertices[0].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[2].Position, newVertices[1].Position, newVertices[0].Position);
-			positiveCentroid+=(triangleArea*triangleCenter);
-			positiveMeshTotalArea+=triangleArea;
-			
-			negativeVertices.push_back(triangleVertices[0]);
-			negativeVertices.push_back(newVertices[1]);
-			negativeVertices.push_back(newVertices[0]);
-			triangleArea=CalculateTriangleArea(triangleVertices[0].Position, newVertices[1].Position, newVertices[0].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[0].Position, newVertices[1].Position, newVertices[0].Position);
-			negativeCentroid+=(triangleArea*triangleCenter);
-			negativeMeshTotalArea+=triangleArea;
-			
-			negativeVertices.push_back(triangleVertices[0]);
-			negativeVertices.push_back(triangleVertices[1]);
-			negativeVertices.push_back(newVertices[0]);
-			triangleArea=CalculateTriangleArea(triangleVertices[0].Position, triangleVertices[1].Position, newVertices[0].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[0].Position, triangleVertices[1].Position, newVertices[0].Position);
-			negativeCentroid+=(triangleArea*triangleCenter);
-			negativeMeshTotalArea+=triangleArea;
-		}
-		else if(aCheck & bCheck & !cCheck)
-		{
-			positiveVertices.push_back(triangleVertices[0]);
-			positiveVertices.push_back(triangleVertices[1]);
-			positiveVertices.push_back(newVertices[0]);
-			triangleArea=CalculateTriangleArea(triangleVertices[0].Position, triangleVertices[1].Position, newVertices[0].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[0].Position, triangleVertices[1].Position, newVertices[0].Position);
-			positiveCentroid+=(triangleArea*triangleCenter);
-			positiveMeshTotalArea+=triangleArea;
-			
-			positiveVertices.push_back(triangleVertices[0]);
-			positiveVertices.push_back(newVertices[1]);
-			positiveVertices.push_back(newVertices[0]);
-			triangleArea=CalculateTriangleArea(triangleVertices[0].Position, newVertices[1].Position, newVertices[0].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[0].Position, newVertices[1].Position, newVertices[0].Position);
-			positiveCentroid+=(triangleArea*triangleCenter);
-			positiveMeshTotalArea+=triangleArea;
-			
-			negativeVertices.push_back(triangleVertices[2]);
-			negativeVertices.push_back(newVertices[0]);
-			negativeVertices.push_back(newVertices[1]);
-			triangleArea=CalculateTriangleArea(triangleVertices[2].Position, newVertices[0].Position, newVertices[1].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[2].Position, newVertices[0].Position, newVertices[1].Position);
-			negativeCentroid+=(triangleArea*triangleCenter);
-			negativeMeshTotalArea+=triangleArea;
-		}
-		else if(aCheck & !bCheck & cCheck)
-		{
-			positiveVertices.push_back(triangleVertices[0]);
-			positiveVertices.push_back(triangleVertices[2]);
-			positiveVertices.push_back(newVertices[1]);
-			triangleArea=CalculateTriangleArea(triangleVertices[0].Position, triangleVertices[2].Position, newVertices[1].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[0].Position, triangleVertices[2].Position, newVertices[1].Position);
-			positiveCentroid+=(triangleArea*triangleCenter);
-			positiveMeshTotalArea+=triangleArea;
-			
-			positiveVertices.push_back(triangleVertices[0]);
-			positiveVertices.push_back(newVertices[0]);
-			positiveVertices.push_back(newVertices[1]);
-			triangleArea=CalculateTriangleArea(triangleVertices[0].Position,  newVertices[0].Position, newVertices[1].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[0].Position,  newVertices[0].Position, newVertices[1].Position);
-			positiveCentroid+=(triangleArea*triangleCenter);
-			positiveMeshTotalArea+=triangleArea;
-			
-			negativeVertices.push_back(triangleVertices[1]);
-			negativeVertices.push_back(newVertices[0]);
-			negativeVertices.push_back(newVertices[1]);
-			triangleArea=CalculateTriangleArea(triangleVertices[1].Position,  newVertices[0].Position, newVertices[1].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[1].Position,  newVertices[0].Position, newVertices[1].Position);
-			negativeCentroid+=(triangleArea*triangleCenter);
-			negativeMeshTotalArea+=triangleArea;
-		}
-		else if(!aCheck & bCheck & cCheck)
-		{
-			positiveVertices.push_back(triangleVertices[1]);
-			positiveVertices.push_back(triangleVertices[2]);
-			positiveVertices.push_back(newVertices[1]);
-			triangleArea=CalculateTriangleArea(triangleVertices[1].Position,  triangleVertices[2].Position, newVertices[1].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[1].Position,  triangleVertices[2].Position, newVertices[1].Position);
-			positiveCentroid+=(triangleArea*triangleCenter);
-			positiveMeshTotalArea+=triangleArea;
-			
-			positiveVertices.push_back(triangleVertices[1]);
-			positiveVertices.push_back(newVertices[0]);
-			positiveVertices.push_back(newVertices[1]);
-			triangleArea=CalculateTriangleArea(triangleVertices[1].Position,  newVertices[0].Position, newVertices[1].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[1].Position,  newVertices[0].Position, newVertices[1].Position);
-			positiveCentroid+=(triangleArea*triangleCenter);
-			positiveMeshTotalArea+=triangleArea;
-			
-			negativeVertices.push_back(triangleVertices[0]);
-			negativeVertices.push_back(newVertices[0]);
-			negativeVertices.push_back(newVertices[1]);
-			triangleArea=CalculateTriangleArea(triangleVertices[0].Position,  newVertices[0].Position, newVertices[1].Position);
-			triangleCenter=CalculateTriangleCenter(triangleVertices[0].Position,  newVertices[0].Position, newVertices[1].Position);
-			negativeCentroid+=(triangleArea*triangleCenter);
-			negativeMeshTotalArea+=triangleArea;
-		}
-		
-		//Section's face creation
-		//First push the index of the section centroid
-		positiveMeshIndices.push_back(0);
-		negativeMeshIndices.push_back(0);
-		//Second add the other two points
-		for(int i=0;i<2;i++)
-		{
-			auto it=positiveSectionVertexIndexMap.find(newVertices[i]);
-			if(it==positiveSectionVertexIndexMap.end())
-			{
-				Vertex vertex=Vertex();
-				vertex.Position=newVertices[i].Position;
-				vertex.Normal=(-planeNormal);
-				vertex.TexCoords=glm::vec2(0, 0);
-				vertex.Bitangent=glm::vec3(0, 0, 0);
-				vertex.Tangent=glm::vec3(0, 0, 0);
-				positiveMeshVertices.push_back(vertex);
-				int index=positiveMeshVertices.size()-1;
-				positiveMeshIndices.push_back(index);
-				positiveSectionVertexIndexMap[vertex]=index;
-				sectionVertexCentroid.Position.x+=vertex.Position.x;
-				sectionVertexCentroid.Position.y+=vertex.Position.y;
-				sectionVertexCentroid.Position.z+=vertex.Position.z;
-			}
-			else
-			{
-				positiveMeshIndices.push_back(positiveSectionVertexIndexMap[newVertices[i]]);
-			}
-		
-			it=negativeSectionVertexIndexMap.find(newVertices[i]);
-			if(it==negativeSectionVertexIndexMap.end())
-			{
-				Vertex vertex=Vertex();
-				vertex.Position=newVertices[i].Position;
-				vertex.Normal=planeNormal;
-				vertex.TexCoords=glm::vec2(0, 0);
-				vertex.Bitangent=glm::vec3(0, 0, 0);
-				vertex.Tangent=glm::vec3(0, 0, 0);
-				negativeMeshVertices.push_back(vertex);
-				int index=negativeMeshVertices.size()-1;
-				negativeMeshIndices.push_back(index);
-				negativeSectionVertexIndexMap[vertex]=index;
-			}
-			else
-			{
-				negativeMeshIndices.push_back(negativeSectionVertexIndexMap[newVertices[i]]);
-			}
-		}
-		
-		//Update mesh structures
-		for(unsigned int i=0;i<positiveVertices.size();i++)
-		{
-			auto itV=positiveVertexIndexMap.find(positiveVertices[i]);
-			if(itV==positiveVertexIndexMap.end())
-			{
-				positiveMeshVertices.push_back(positiveVertices[i]);
-				int index=positiveMeshVertices.size()-1;
-				positiveMeshIndices.push_back(index);
-				positiveVertexIndexMap[positiveVertices[i]].push_back(index);
-			}
-			else
-			{
-				bool found=false;
-				vector<int> existingVertices=positiveVertexIndexMap[positiveVertices[i]];
-				for(unsigned int j=0;j<existingVertices.size();j++)
-				{
-					int k=existingVertices[j];
-					if(positiveMeshVertices[k].Equals(positiveVertices[i]))
-					{
-						found=true;
-						positiveMeshIndices.push_back(k);
-						break;
-					}
-				}
-				
-				if(!found)
-				{
-					positiveMeshVertices.push_back(positiveVertices[i]);
-					int index=positiveMeshVertices.size()-1;
-					positiveMeshIndices.push_back(index);
-					positiveVertexIndexMap[positiveVertices[i]].push_back(index);
-				}
-			}
-		}
-		
-		for(unsigned int i=0;i<negativeVertices.size();i++)
-		{
-			auto it=negativeVertexIndexMap.find(negativeVertices[i]);
-			if(it==negativeVertexIndexMap.end())
-			{
-				negativeMeshVertices.push_back(negativeVertices[i]);
-				int index=negativeMeshVertices.size()-1;
-				negativeMeshIndices.push_back(index);
-				negativeVertexIndexMap[negativeVertices[i]].push_back(index);
-			}
-			else
-			{
-				bool found=false;
-				vector<int> existingVertices=negativeVertexIndexMap[negativeVertices[i]];
-				for(unsigned int j=0;j<existingVertices.size();j++)
-				{
-					int k=existingVertices[j];
-					if(negativeMeshVertices[k].Equals(negativeVertices[i]))
-					{
-						found=true;
-						negativeMeshIndices.push_back(k);
-						break;
-					}
-				}
-				
-				if(!found)
-				{
-					negativeMeshVertices.push_back(negativeVertices[i]);
-					int index=negativeMeshVertices.size()-1;
-					negativeMeshIndices.push_back(index);
-					negativeVertexIndexMap[negativeVertices[i]].push_back(index);
-				}
-			}
-		}
+		if(!poolIndices)
+			return poolVertices;
+		scratch.resize(vertexCount);
+		for(size_t i=0;i<vertexCount;i++)
+			scratch[i]=poolVertices[poolIndices[i]];
+		return scratch.data();
 	}
-	//This function calculates the interpolation factors, between a triangle and the cutting plane.
-	//These factors are needed to calculate the new points that lie on the cutting section.
-	//Each factor refers to a segment of the considered triangle: if at least two of these factors are between 0 and 1,
-	//then there is intersection.
-	bool CutTriangle(float* intFactors, vector<Vertex> triangleVertices, glm::vec3 planePoint, glm::vec3 cutNormal)
+	//Model transform of the vertices, given the one of the rigid body.
+	glm::mat4 VertexModel(glm::mat4 model) const
 	{
-		int tmp[]={0, 1, 1, 2, 0, 2};
-		int j=0;
-		for(int i=0; i<5; i+=2)
-		{
-			glm::vec3 a=triangleVertices[tmp[i]].Position;
-			glm::vec3 b=triangleVertices[tmp[i+1]].Position;
-			float tmp=glm::dot(b-a, cutNormal);
-			if(tmp==0.0)
-			{
-				intFactors[j]=-1.f;
-			}
-			else
-			{	
-				tmp=glm::dot(planePoint-a, cutNormal)/tmp;
-				intFactors[j]=tmp;
-			}
-			j++;
-		}
-		
-		if((intFactors[0]<=0.f || 1.0f<=intFactors[0]) && (intFactors[1]<=0.f || 1.0f<=intFactors[1]) && (intFactors[2]<=0.f || 1.0f<=intFactors[2]))
-			return false;
-		return true;
+		return model*glm::mat4(glm::transpose(axes))*glm::translate(glm::mat4(1.0f), -origin);
 	}
-
-	//In case a triangle is not intersected by the cutting plane, then it must belong totally to the positive or negative part.
-	//This procedure add the points of a triangle that doesn't intersect the cutting plane, to the given data structures of positive or negative mesh.
-	void AddExistingTriangle(vector<Vertex> triangleVertices, unordered_map<Vertex, vector<int>> & vertexIndexMap, vector<GLuint> & ind, vector<Vertex> & ver, glm::vec3 & centroid, float & totalArea)
-	{			
-		int index=0;
-		for(int i=0;i<3;i++)
+	//Radius of the bounding sphere around origin, computed at the first call: the vertices of a mesh don't change.
+	float BoundingRadius()
+	{
+		if(boundingRadius<0.0f)
 		{
-			auto it=vertexIndexMap.find(triangleVertices[i]);
-			if(it==vertexIndexMap.end())
-			{
-				ver.push_back(triangleVertices[i]);
-				index=ver.size()-1;
-				ind.push_back(index);
-				vertexIndexMap[triangleVertices[i]].push_back(index);
-			}
-			else
-			{
-				bool found=false;
-				vector<int> temp=vertexIndexMap[triangleVertices[i]];
-				for(unsigned int j=0;j<temp.size();j++)
-				{
-					if(ver[temp[j]].Equals(triangleVertices[i]))
-					{
-						found=true;
-						ind.push_back(temp[j]);
-						break;
-					}
-				}
-				if(!found)
-				{
-					ver.push_back(triangleVertices[i]);
-					index=ver.size()-1;
-					ind.push_back(index);
-					vertexIndexMap[triangleVertices[i]].push_back(index);
-				}
-			}
+			boundingRadius=0.0f;
+			for(GLuint i=0;i<vertexCount;i++)
+				boundingRadius=max(boundingRadius, glm::length(GetVertex(i).Position-origin));
 		}
-		
-		float triangleArea=CalculateTriangleArea(triangleVertices[0].Position, triangleVertices[1].Position, triangleVertices[2].Position);
-		totalArea+=triangleArea;
-		glm::vec3 triangleCenter=CalculateTriangleCenter(triangleVertices[0].Position, triangleVertices[1].Position, triangleVertices[2].Position);
-		centroid+=(triangleArea*triangleCenter);
+		return boundingRadius;
 	}
-	//This procedure cuts the mesh in two parts: positive and negative; these new meshes are saved in positiveMesh and negativeMesh.
-	//Since physics simulation does not deal with directly with these meshes, we need also to generate some sort of bounding volume, to describe them to the physics engine.
-	//that's why each produced mesh is also paired with a convex hull.
-	//After the call of this method, the mesh involved in the cut must be removed from the scene, in order to maintain the scene consistent.
-	void Cut(Mesh & positiveMesh, Mesh & negativeMesh, glm::vec4 & positiveMeshPosition, glm::vec4 & negativeMeshPosition, glm::vec4 cutStartPoint, glm::vec4 cutEndPoint, glm::mat4 model, btConvexHullShape* & positiveShape, btConvexHullShape* & negativeShape, float & positiveWeightFactor, float & negativeWeightFactor)
+	void BuildAdjacency()
+	{
+		vector<Vertex> scratch;
+		adjacency.Build(LocalVertices(scratch), vertexCount, indices.data(), indices.size());
+	}
+	//Builds the tree of the triangles, if there are at least TREE_MIN_TRIANGLES; since the triangles are reordered, it must be
+	//called before the mesh is uploaded.
+	void BuildTree()
+	{
+		if(indices.size()/3<TREE_MIN_TRIANGLES)
+			return;
+		vector<Vertex> scratch;
+		tree=make_shared<TriangleTree>();
+		tree->Build(LocalVertices(scratch), indices.data(), indices.size(), adjacency.Empty()? nullptr : adjacency.twins.data());
+	}
+	//Simplifies the mesh down to targetTriangles, with collapses of at most maxError (see MeshDecimator); the mesh must own its
+	//pool and not be uploaded yet.
+	void Decimate(MeshDecimator & decimator, size_t targetTriangles, float maxError)
+	{
+		decimator.Decimate(pool->vertices, indices, targetTriangles, maxError);
+		vertexCount=pool->vertices.size();
+		boundingRadius=-1.0f;
+	}
+	//This method converts the cutting segment, given in world space, to the cutting plane in the object space of this mesh;
+	//for the frame of the vertices, model must be the one given by VertexModel.
+	static CutPlane CalculateCutPlane(glm::vec4 cutStartPoint, glm::vec4 cutEndPoint, glm::mat4 model)
 	{
 		//Convert world vertices to object space
 		glm::mat4 invModel=glm::inverse(model);
@@ -519,163 +178,107 @@ public:
 		glm::vec4 cutVector=glm::vec4(cutEndPoint.x-cutStartPoint.x, cutEndPoint.y-cutStartPoint.y, 0, cutEndPoint.w-cutStartPoint.w);
 		glm::vec4 cutNormal=glm::vec4(-cutVector.y, cutVector.x, 0.0f, 0.0f);
 		cutNormal=glm::normalize(cutNormal);
-		float negativeArea;
-		vector<Vertex> negativeMeshVertices;
-		vector<GLuint> negativeMeshIndices;
-		float positiveArea;
-		vector<Vertex> positiveMeshVertices;
-		vector<GLuint> positiveMeshIndices;
-		glm::vec3 positiveMeshCentroid;
-		glm::vec3 negativeMeshCentroid;
-		float intFactors[3]={0.f, 0.f, 0.f};
-		unordered_map<Vertex, vector<int>> positiveVertexIndexMap;
-		unordered_map<Vertex, vector<int>> negativeVertexIndexMap;
-		unordered_map<Vertex, int> positiveSectionVertexIndexMap;
-		unordered_map<Vertex, int> negativeSectionVertexIndexMap;
-		Vertex sectionVertexCentroid=Vertex();
-		positiveShape=new btConvexHullShape();
-		negativeShape=new btConvexHullShape();
-		
-		positiveMeshVertices.push_back(sectionVertexCentroid);
-		negativeMeshVertices.push_back(sectionVertexCentroid);
-
-		Log log=Log();
-		log.InitLog("Cut");
-		for(unsigned int i=0;i<indices.size();i+=3)
-		{
-			int indA=indices[i];
-			int indB=indices[i+1];
-			int indC=indices[i+2];
-			Vertex a=Vertex(glm::vec3(vertices[indA].Position.x, vertices[indA].Position.y, vertices[indA].Position.z), 
-							glm::vec3(vertices[indA].Normal.x, vertices[indA].Normal.y, vertices[indA].Normal.z),
-							glm::vec2(vertices[indA].TexCoords.x, vertices[indA].TexCoords.y),
-							glm::vec3(vertices[indA].Tangent.x, vertices[indA].Tangent.y, vertices[indA].Tangent.z),
-							glm::vec3(vertices[indA].Bitangent.x, vertices[indA].Bitangent.y, vertices[indA].Bitangent.z));
-			Vertex b=Vertex(glm::vec3(vertices[indB].Position.x, vertices[indB].Position.y, vertices[indB].Position.z), 
-							glm::vec3(vertices[indB].Normal.x, vertices[indB].Normal.y, vertices[indB].Normal.z),
-							glm::vec2(vertices[indB].TexCoords.x, vertices[indB].TexCoords.y),
-							glm::vec3(vertices[indB].Tangent.x, vertices[indB].Tangent.y, vertices[indB].Tangent.z),
-							glm::vec3(vertices[indB].Bitangent.x, vertices[indB].Bitangent.y, vertices[indB].Bitangent.z));
-			Vertex c=Vertex(glm::vec3(vertices[indC].Position.x, vertices[indC].Position.y, vertices[indC].Position.z), 
-							glm::vec3(vertices[indC].Normal.x, vertices[indC].Normal.y, vertices[indC].Normal.z),
-							glm::vec2(vertices[indC].TexCoords.x, vertices[indC].TexCoords.y),
-							glm::vec3(vertices[indC].Tangent.x, vertices[indC].Tangent.y, vertices[indC].Tangent.z),
-							glm::vec3(vertices[indC].Bitangent.x, vertices[indC].Bitangent.y, vertices[indC].Bitangent.z));
-			vector<Vertex> triangleVertices={a, b, c};
-			if(CutTriangle(intFactors, triangleVertices, cutEndPoint, cutNormal))
-			{	
-				vector<Vertex> newVertices;
-				newVertices=CalculateNewVertices(a, b, c, cutNormal, cutEndPoint, intFactors);
-				
-				AddNewTriangle(	cutEndPoint, 
-								cutNormal, 
-								sectionVertexCentroid,
-								negativeSectionVertexIndexMap,
-								negativeVertexIndexMap,
-								negativeMeshVertices, 
-								negativeMeshIndices, 
-								negativeMeshCentroid,
-								negativeArea, 
-								positiveSectionVertexIndexMap,
-								positiveVertexIndexMap,
-								positiveMeshVertices, 
-								positiveMeshIndices, 
-								positiveMeshCentroid,
-								positiveArea, 
-								newVertices,
-								triangleVertices);
-			}
-			else
-			{
-				//Since there can be situation in which a point lies over the plane,
-				//this code assign the triangle to the side, where the majority of points are.
-				int counter=a.PositiveOrNegativeSide(cutNormal, cutEndPoint)>.0? 1 : -1;
-				counter=b.PositiveOrNegativeSide(cutNormal, cutEndPoint)>.0? counter+1 : counter-1;
-				counter=c.PositiveOrNegativeSide(cutNormal, cutEndPoint)>.0? counter+1 : counter-1;
-				if(counter>0.f)
-					AddExistingTriangle(triangleVertices, positiveVertexIndexMap, positiveMeshIndices, positiveMeshVertices, positiveMeshCentroid, positiveArea);
-				else
-					AddExistingTriangle(triangleVertices, negativeVertexIndexMap, negativeMeshIndices, negativeMeshVertices, negativeMeshCentroid, negativeArea);
-			}
-		}
-		
-		log.EndLog();
-		
-		sectionVertexCentroid.Position/=positiveSectionVertexIndexMap.size();
-		
-		positiveMeshVertices[0].Position.x=sectionVertexCentroid.Position.x;
-		positiveMeshVertices[0].Position.y=sectionVertexCentroid.Position.y;
-		positiveMeshVertices[0].Position.z=sectionVertexCentroid.Position.z;
-		
-		positiveMeshVertices[0].Normal.x=-cutNormal.x;
-		positiveMeshVertices[0].Normal.y=-cutNormal.y;
-		positiveMeshVertices[0].Normal.z=-cutNormal.z;
-		
-		negativeMeshVertices[0].Position.x=sectionVertexCentroid.Position.x;
-		negativeMeshVertices[0].Position.y=sectionVertexCentroid.Position.y;
-		negativeMeshVertices[0].Position.z=sectionVertexCentroid.Position.z;
-		
-		negativeMeshVertices[0].Normal.x=cutNormal.x;
-		negativeMeshVertices[0].Normal.y=cutNormal.y;
-		negativeMeshVertices[0].Normal.z=cutNormal.z;
-		
-		float epsilon=0.09f;
-		if(positiveArea<=epsilon)
-			positiveArea=1;
-		else
-			positiveMeshCentroid/=positiveArea;
-			
-		if(negativeArea<=epsilon)
-			negativeArea=1;
+		CutPlane plane;
+		plane.normal=glm::vec3(cutNormal);
+		plane.point=glm::vec3(cutEndPoint);
+		return plane;
+	}
+	//CPU stage of the cut: the geometry of the two new meshes is computed and stored inside result, without any GL call.
+	//The plane is in the frame of the vertices. The cutter is configured for this mesh; the caller keeps it from a cut to the
+	//next one, so its arenas are reused. If a thread pool is given, the triangles of large meshes are split by all its
+	//threads; if the convex hull of this mesh is given, the hulls of the two parts are clipped from it.
+	void CutGeometry(MeshCutter & cutter, CutResult & result, const CutPlane & plane, ThreadPool* threadPool=nullptr, const btConvexHullShape* hull=nullptr)
+	{
+		vector<Vertex> scratch;
+		cutter.SetThreadPool(threadPool);
+		cutter.SetHull(hull, origin, axes);
+		cutter.SetAdjacency(adjacency.Twins());
+		cutter.SetTree(tree.get());
+		cutter.SetAttributes(attributes);
+		cutter.Cut(LocalVertices(scratch), vertexCount, indices.data(), indices.size(), plane, result);
+	}
+	//Second stage of the cut: the geometry computed by CutGeometry is turned into two meshes and two convex hulls.
+	//The weight factors are the fractions of the volume of this mesh that go to each side, and the inertias are the principal
+	//moments of the inertia tensors of unit mass, whose axes the new meshes keep (see axes); if a side is not closed (so it has
+	//no volume), the area is used instead.
+	//If upload is false, the buffers of the new meshes are not created; Upload must be called on them before drawing.
+	void CommitCut(CutResult & result, Mesh & positiveMesh, Mesh & negativeMesh, glm::vec4 & positiveMeshPosition, glm::vec4 & negativeMeshPosition, glm::mat4 model, btConvexHullShape* & positiveShape, btConvexHullShape* & negativeShape, float & positiveWeightFactor, float & negativeWeightFactor, glm::vec3 & positiveInertia, glm::vec3 & negativeInertia, bool upload=true)
+	{
+		if(result.positive.volume>CUT_MIN_VOLUME && result.negative.volume>CUT_MIN_VOLUME)
+			positiveWeightFactor=result.positive.volume/(result.positive.volume+result.negative.volume);
 		else
-			negativeMeshCentroid/=negativeArea;
-		
-		positiveWeightFactor=positiveArea/(positiveArea+negativeArea);
+			positiveWeightFactor=result.positive.area/(result.positive.area+result.negative.area);
 		negativeWeightFactor=1-positiveWeightFactor;
+		//Grazing cuts are never committed, so both sides have some area.
+		assert(positiveWeightFactor>0.0f && negativeWeightFactor>0.0f);
 		
-		if(positiveWeightFactor<=0)
-			positiveWeightFactor=1.f;
-		if(negativeWeightFactor<=0)
-			negativeWeightFactor=1.f;
-			
-		log.InitLog("Convex hull generation");
-		positiveVertexIndexMap.clear();
-		negativeVertexIndexMap.clear();
+		glm::mat3 positiveAxes, negativeAxes;
+		positiveShape=BodyShape(result.positive, positiveInertia, positiveAxes);
+		negativeShape=BodyShape(result.negative, negativeInertia, negativeAxes);
 		
-		for(unsigned int i=0;i<positiveMeshVertices.size();i++)
+		CutSide* sides[2]={&result.positive, &result.negative};
+		Mesh* meshes[2]={&positiveMesh, &negativeMesh};
+		CommitSides(sides, meshes, 2, upload);
+		positiveMesh.axes=positiveAxes;
+		negativeMesh.axes=negativeAxes;
+		positiveMesh.modelFraction=modelFraction*positiveWeightFactor;
+		negativeMesh.modelFraction=modelFraction*negativeWeightFactor;
+
+		positiveMeshPosition=BodyPosition(result.positive, model);
+		negativeMeshPosition=BodyPosition(result.negative, model);
+	}
+	//Second stage of a slice (see MeshSlicer::Slice), the same as CommitCut: each cell becomes a mesh with its position,
+	//convex hull, weight factor and inertia of unit mass.
+	void CommitSlice(SliceResult & result, vector<Mesh> & meshes, vector<glm::vec4> & meshPositions, glm::mat4 model, vector<btConvexHullShape*> & shapes, vector<float> & weightFactors, vector<glm::vec3> & inertias, bool upload=true)
+	{
+		float totalArea=0.0f;
+		float totalVolume=0.0f;
+		bool closed=true;
+		for(unsigned int i=0;i<result.cells.size();i++)
 		{
-			positiveMeshVertices[i].Position.x-=positiveMeshCentroid.x;
-			positiveMeshVertices[i].Position.y-=positiveMeshCentroid.y;
-			positiveMeshVertices[i].Position.z-=positiveMeshCentroid.z;
-			
-			auto it=positiveVertexIndexMap.find(positiveMeshVertices[i]);
-			if(it==positiveVertexIndexMap.end())
-			{
-				positiveShape->addPoint(btVector3(positiveMeshVertices[i].Position.x, positiveMeshVertices[i].Position.y, positiveMeshVertices[i].Position.z));
-				positiveVertexIndexMap[positiveMeshVertices[i]].push_back(0);
-			}
+			totalArea+=result.cells[i].side.area;
+			totalVolume+=result.cells[i].side.volume;
+			closed=closed && result.cells[i].side.volume>CUT_MIN_VOLUME;
 		}
-		
-		for(unsigned int i=0;i<negativeMeshVertices.size();i++)
+		meshes.resize(result.cells.size());
+		meshPositions.resize(result.cells.size());
+		shapes.resize(result.cells.size());
+		weightFactors.resize(result.cells.size());
+		inertias.resize(result.cells.size());
+		vector<CutSide*> sides(result.cells.size());
+		vector<Mesh*> cellMeshes(result.cells.size());
+		vector<glm::mat3> cellAxes(result.cells.size());
+		for(unsigned int i=0;i<result.cells.size();i++)
 		{
-			negativeMeshVertices[i].Position.x-=negativeMeshCentroid.x;
-			negativeMeshVertices[i].Position.y-=negativeMeshCentroid.y;
-			negativeMeshVertices[i].Position.z-=negativeMeshCentroid.z;
-			
-			auto it=negativeVertexIndexMap.find(negativeMeshVertices[i]);
-			if(it==negativeVertexIndexMap.end())
-			{
-				negativeShape->addPoint(btVector3(negativeMeshVertices[i].Position.x, negativeMeshVertices[i].Position.y, negativeMeshVertices[i].Position.z));
-				negativeVertexIndexMap[negativeMeshVertices[i]].push_back(0);
-			}
+			CutSide & side=result.cells[i].side;
+			weightFactors[i]=closed? side.volume/totalVolume : side.area/totalArea;
+			//Cells are created by the triangles falling in them, so each one has some area.
+			assert(weightFactors[i]>0.0f);
+			shapes[i]=BodyShape(side, inertias[i], cellAxes[i]);
+			meshPositions[i]=BodyPosition(side, model);
+			sides[i]=&side;
+			cellMeshes[i]=&meshes[i];
+		}
+		CommitSides(sides.data(), cellMeshes.data(), sides.size(), upload);
+		for(unsigned int i=0;i<result.cells.size();i++)
+		{
+			meshes[i].axes=cellAxes[i];
+			meshes[i].modelFraction=modelFraction*weightFactors[i];
 		}
-		
-		log.EndLog();
-		positiveMesh=Mesh(positiveMeshVertices, positiveMeshIndices, textures);
-		negativeMesh=Mesh(negativeMeshVertices, negativeMeshIndices, textures);
-
-		positiveMeshPosition=model*glm::vec4(positiveMeshCentroid.x, positiveMeshCentroid.y, positiveMeshCentroid.z, 1.0f);
-		negativeMeshPosition=model*glm::vec4(negativeMeshCentroid.x, negativeMeshCentroid.y, negativeMeshCentroid.z, 1.0f);
+	}
+	//This procedure cuts the mesh in two parts: positive and negative; these new meshes are saved in positiveMesh and negativeMesh.
+	//Since physics simulation does not deal with directly with these meshes, we need also to generate some sort of bounding volume, to describe them to the physics engine.
+	//that's why each produced mesh is also paired with a convex hull.
+	//After the call of this method, the mesh involved in the cut must be removed from the scene, in order to maintain the scene consistent.
+	//A cut that grazes the mesh (see CutResult::grazed) is not committed: false is returned, and the mesh stays as it is.
+	bool Cut(MeshCutter & cutter, Mesh & positiveMesh, Mesh & negativeMesh, glm::vec4 & positiveMeshPosition, glm::vec4 & negativeMeshPosition, glm::vec4 cutStartPoint, glm::vec4 cutEndPoint, glm::mat4 model, btConvexHullShape* & positiveShape, btConvexHullShape* & negativeShape, float & positiveWeightFactor, float & negativeWeightFactor, glm::vec3 & positiveInertia, glm::vec3 & negativeInertia, ThreadPool* threadPool=nullptr)
+	{
+		CutResult result;
+		CutGeometry(cutter, result, CalculateCutPlane(cutStartPoint, cutEndPoint, VertexModel(model)), threadPool);
+		if(result.grazed)
+			return false;
+		CommitCut(result, positiveMesh, negativeMesh, positiveMeshPosition, negativeMeshPosition, model, positiveShape, negativeShape, positiveWeightFactor, negativeWeightFactor, positiveInertia, negativeInertia);
+		return true;
 	}
 
     void Draw(Shader shader)
@@ -715,49 +318,134 @@ public:
         }
     }
 	
+    //The buffer of the pool is freed with its last mesh.
     void Delete()
     {
         glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
         glDeleteBuffers(1, &EBO);
-		vertices.clear();
+		if(pool && pool.use_count()==1)
+			pool->Delete();
+		pool.reset();
+		poolIndices.clear();
+		vertexCount=0;
 		indices.clear();
 		textures.clear();
+		adjacency.twins.clear();
+		tree.reset();
+		fracture.reset();
+		fractureNode=-1;
     }
 
 private:
-  GLuint VBO, EBO;
+  GLuint EBO=0;
+	//World position of the rigid body of a piece, whose center of mass is the centroid of its side.
+	glm::vec4 BodyPosition(const CutSide & side, glm::mat4 model) const
+	{
+		return VertexModel(model)*glm::vec4(side.centroid, 1.0f);
+	}
+	//Turns the sides of a cut or a slice into meshes, whose origin is the centroid of their side.
+	//The vertices a side has copied from this mesh (see CutSide::sources) are shared with it, and the ones created by the cut,
+	//of all sides, are appended to its pool at once. If they don't fit, the pieces get a new pool, twice as large as needed,
+	//where the vertices of this mesh are copied before the new ones; the meshes sharing the old pool keep it.
+	//Sides that don't track their sources get a pool of their own.
+	void CommitSides(CutSide* const* sides, Mesh* const* meshes, size_t count, bool upload)
+	{
+		vector<Vertex> newVertices;
+		for(size_t s=0;s<count;s++)
+		{
+			const CutSide & side=*sides[s];
+			if(side.sources.empty())
+				continue;
+			for(size_t i=0;i<side.vertices.size();i++)
+				if(side.sources[i]<0)
+					newVertices.push_back(side.vertices[i]);
+		}
+		shared_ptr<VertexPool> piecePool=pool;
+		GLuint first=0;
+		bool copied=false;
+		if(!piecePool->Append(newVertices.data(), newVertices.size(), first))
+		{
+			piecePool=make_shared<VertexPool>(2*(vertexCount+newVertices.size()));
+			vector<Vertex> scratch;
+			const Vertex* vertices=LocalVertices(scratch);
+			piecePool->vertices.assign(vertices, vertices+vertexCount);
+			piecePool->Append(newVertices.data(), newVertices.size(), first);
+			copied=true;
+		}
+		for(size_t s=0;s<count;s++)
+		{
+			CutSide & side=*sides[s];
+			Mesh & mesh=*meshes[s];
+			if(side.sources.empty())
+				mesh=Mesh(std::move(side.vertices), std::move(side.indices), textures, false);
+			else
+			{
+				vector<GLuint> piecePoolIndices(side.vertices.size());
+				for(size_t i=0;i<side.vertices.size();i++)
+				{
+					int source=side.sources[i];
+					piecePoolIndices[i]=source<0? first++ : copied? (GLuint)source : PoolIndex(source);
+				}
+				mesh=Mesh(piecePool, std::move(piecePoolIndices), std::move(side.indices), textures, false);
+				side.vertices.clear();
+				side.sources.clear();
+			}
+			mesh.origin=side.centroid;
+			mesh.adjacency=std::move(side.adjacency);
+			mesh.tree=std::move(side.tree);
+			mesh.attributes=attributes;
+			if(upload)
+				mesh.Upload();
+		}
+	}
+	//Convex hull of the rigid body of a side, with the principal moments of its inertia tensor of unit mass and the principal
+	//axes (see axes): the hull points are turned into the frame of the body, where Bullet's diagonal inertia is exact.
+	//Open sides have no volume, so their body keeps the axes of the frame of the vertices, with the inertia of its convex hull.
+	static btConvexHullShape* BodyShape(CutSide & side, glm::vec3 & inertia, glm::mat3 & axes)
+	{
+		if(side.volume<=CUT_MIN_VOLUME)
+		{
+			axes=glm::mat3(1.0f);
+			btConvexHullShape* shape=HullClipper::CreateShape(side.hullPoints);
+			btVector3 hullInertia;
+			shape->calculateLocalInertia(1.f, hullInertia);
+			inertia=glm::vec3(hullInertia.x(), hullInertia.y(), hullInertia.z());
+			return shape;
+		}
+		VolumeIntegrals::PrincipalAxes(side.inertia, axes, inertia);
+		glm::mat3 toBody=glm::transpose(axes);
+		for(unsigned int i=0;i<side.hullPoints.size();i++)
+			side.hullPoints[i]=toBody*side.hullPoints[i];
+		return HullClipper::CreateShape(side.hullPoints);
+	}
   void setupMesh()
   {
+      // the vertices appended to the pool since its last upload are copied in its VBO, which is shared by all its meshes
+      this->pool->Upload();
       glGenVertexArrays(1, &this->VAO);
-      glGenBuffers(1, &this->VBO);
       glGenBuffers(1, &this->EBO);
 
       // VAO is made "active"
       glBindVertexArray(this->VAO);
-      // we copy data in the VBO - we must set the data dimension, and the pointer to the structure cointaining the data
-      glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-      glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);
-      // we copy data in the EBO - we must set the data dimension, and the pointer to the structure cointaining the data
+      glBindBuffer(GL_ARRAY_BUFFER, this->pool->VBO);
+      // we copy data in the EBO - the triangles index the pool, so the indices of the mesh are mapped to it
+      vector<GLuint> bufferIndices(this->indices);
+      if(!this->poolIndices.empty())
+          for(GLuint i = 0; i < bufferIndices.size(); i++)
+              bufferIndices[i] = this->poolIndices[bufferIndices[i]];
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, bufferIndices.size() * sizeof(GLuint), bufferIndices.data(), GL_STATIC_DRAW);
 
       // we set in the VAO the pointers to the different vertex attributes (with the relative offsets inside the data structure)
       // vertex positions
       glEnableVertexAttribArray(0);
       glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-      // Normals
+      // Normals, octahedral encoded in two normalised shorts: the vertex shaders decode them
       glEnableVertexAttribArray(1);
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
-      // Texture Coordinates
+      glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, PackedNormal));
+      // Texture Coordinates, as half floats
       glEnableVertexAttribArray(2);
-      glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
-      // Tangent
-      glEnableVertexAttribArray(3);
-      glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Tangent));
-      // Bitangent
-      glEnableVertexAttribArray(4);
-      glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Bitangent));
+      glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, PackedTexCoords));
       glBindVertexArray(0);
   }
 };
\ No newline at end of file
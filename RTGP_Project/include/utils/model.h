@@ -40,6 +40,11 @@ using namespace std;
 // we include the Mesh class (v2), which manages the "OpenGL side" (= creation and allocation of VBO, VAO, EBO buffers) of the loading of models
 #include <utils/mesh.h>
 
+//Meshes are loaded with their half-edge adjacency, so that cuts walk them (see MeshCutter::SetAdjacency).
+#define MODEL_ADJACENCY true
+//Meshes with at least TREE_MIN_TRIANGLES triangles are loaded with their tree, so that cuts skip the clusters far from the plane.
+#define MODEL_TREE true
+
 // function used to load image data
 GLint TextureFromFile(const char* path, string directory);
 
@@ -98,7 +103,7 @@ private:
         // VERY IMPORTANT: calculation of Tangents and Bitangents is possible only if the model has Texture Coordinates
         // If they are not present, the calculation is skipped (but no error is provided in the foillowing checks!)
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_GenSmoothNormals);
 
         // check for errors (see comment above)
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
@@ -148,7 +153,7 @@ private:
         vector<GLuint> indices;
         vector<Texture> textures;
 		unordered_map<glm::vec3, bool> pointsAddedMap;
-		shape=new btConvexHullShape();
+		vector<glm::vec3> hullPoints;
 		printf("Number of vertices %d\n", mesh->mNumVertices);
 		printf("Number of faces %d\n", mesh->mNumFaces);
         // for each face of the mesh, we retrieve the indices of its vertices , and we store them in a vector data structure
@@ -160,29 +165,43 @@ private:
 				indices.push_back(triangle.mIndices[j]);
 				Vertex vertex=Vertex();
 				vertex.Position=glm::vec3(mesh->mVertices[triangle.mIndices[j]].x, mesh->mVertices[triangle.mIndices[j]].y, mesh->mVertices[triangle.mIndices[j]].z);
-				vertex.Normal=glm::vec3(mesh->mNormals[triangle.mIndices[j]].x, mesh->mNormals[triangle.mIndices[j]].y, mesh->mNormals[triangle.mIndices[j]].z);
+				if(mesh->mNormals)
+					vertex.SetNormal(glm::vec3(mesh->mNormals[triangle.mIndices[j]].x, mesh->mNormals[triangle.mIndices[j]].y, mesh->mNormals[triangle.mIndices[j]].z));
+				else
+					vertex.SetNormal(glm::vec3(0.0f));
 				if(mesh->mTextureCoords[0])
 				{
-					vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][triangle.mIndices[j]].x, mesh->mTextureCoords[0][triangle.mIndices[j]].y);
-					vertex.Bitangent=glm::vec3(mesh->mBitangents[triangle.mIndices[j]].x, mesh->mBitangents[triangle.mIndices[j]].y, mesh->mBitangents[triangle.mIndices[j]].z);
-					vertex.Tangent=glm::vec3(mesh->mTangents[triangle.mIndices[j]].x, mesh->mTangents[triangle.mIndices[j]].y, mesh->mTangents[triangle.mIndices[j]].z);
+					vertex.SetTexCoords(glm::vec2(mesh->mTextureCoords[0][triangle.mIndices[j]].x, mesh->mTextureCoords[0][triangle.mIndices[j]].y));
 				}
 				else{
-					vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+					vertex.SetTexCoords(glm::vec2(0.0f, 0.0f));
 				}
 				vertices_array[triangle.mIndices[j]]=vertex;
 				
 				auto it=pointsAddedMap.find(vertex.Position);
 				if(it==pointsAddedMap.end())
 				{
-					shape->addPoint(btVector3(vertex.Position.x, vertex.Position.y, vertex.Position.z));
+					hullPoints.push_back(vertex.Position);
 					pointsAddedMap[vertex.Position]=true;
 				}
 			}
 		}
+		HullClipper hullClipper;
+		float hullVolumeError=hullClipper.Simplify(hullPoints, HULL_POINT_BUDGET);
+		printf("Convex hull points %d, volume error %.2f%%\n", (int)hullPoints.size(), hullVolumeError*100.0f);
+		shape=HullClipper::CreateShape(hullPoints);
 		
 		vertices=std::vector<Vertex>(vertices_array, vertices_array+mesh->mNumVertices);
-		return Mesh(vertices, indices, textures);
+		//The tree reorders the triangles, so the mesh is uploaded last.
+		Mesh loadedMesh(vertices, indices, textures, false);
+		//The cuts interpolate only the attributes Assimp has provided.
+		loadedMesh.attributes=(mesh->mNormals? VERTEX_NORMAL : 0u) | (mesh->mTextureCoords[0]? VERTEX_TEXCOORDS : 0u);
+		if(MODEL_TREE)
+			loadedMesh.BuildTree();
+		if(MODEL_ADJACENCY)
+			loadedMesh.BuildAdjacency();
+		loadedMesh.Upload();
+		return loadedMesh;
     }
 
     // Load (if not yet loaded) the textures defined in the model materials (if defined)
@@ -66,7 +66,10 @@ public:
 	}
 	//Everytime a cut occurs, we must provide two new convex hulls to the physics engine, to simulate each piece of the cut mesh correctly.
 	//This method adds the two new convex hulls generated to the simulation and applies an impulse to them, to make the physical behaviour of the cut more believable.
-	void CutShapeWithImpulse(glm::vec3 cutNormal, int i, float negativeWeightFactor, glm::vec4 negativeMeshPosition, btConvexHullShape* negativeConvexHullShape, float positiveWeightFactor, glm::vec4 positiveMeshPosition, btConvexHullShape* positiveConvexHullShape)
+	//Each piece starts with the velocity that its position had as part of the cut body, so a cut committed while the body is moving does not stop it.
+	//The mass of each piece is its weight factor times the mass of the cut body; the inertias are given for a unit mass.
+	//The rotations take the frame of the cut body to the ones of the pieces, which are along their principal axes (see Mesh::axes).
+	void CutShapeWithImpulse(glm::vec3 cutNormal, int i, float negativeWeightFactor, glm::vec4 negativeMeshPosition, btConvexHullShape* negativeConvexHullShape, glm::vec3 negativeInertia, glm::mat3 negativeRotation, float positiveWeightFactor, glm::vec4 positiveMeshPosition, btConvexHullShape* positiveConvexHullShape, glm::vec3 positiveInertia, glm::mat3 positiveRotation)
 	{
 		btCollisionObject* cuttedCollisionObject = dynamicsWorld->getCollisionObjectArray()[i];
 		btRigidBody* cuttedRigidBody = btRigidBody::upcast(cuttedCollisionObject);
@@ -83,26 +86,39 @@ public:
 			positiveTransform = cuttedCollisionObject->getWorldTransform();
 			negativeTransform = cuttedCollisionObject->getWorldTransform();
 		}
+		btVector3 parentOrigin=positiveTransform.getOrigin();
+		btVector3 linearVelocity(0, 0, 0);
+		btVector3 angularVelocity(0, 0, 0);
+		btScalar parentMass=GetMass(cuttedRigidBody);
+		if (cuttedRigidBody)
+		{
+			linearVelocity=cuttedRigidBody->getLinearVelocity();
+			angularVelocity=cuttedRigidBody->getAngularVelocity();
+		}
 		
 		RemoveRigidBodyAtIndex(i);
 		
 		positiveTransform.setOrigin(btVector3(positiveMeshPosition.x, positiveMeshPosition.y, positiveMeshPosition.z));
 		negativeTransform.setOrigin(btVector3(negativeMeshPosition.x, negativeMeshPosition.y, negativeMeshPosition.z));
+		positiveTransform.setBasis(positiveTransform.getBasis()*ToBasis(positiveRotation));
+		negativeTransform.setBasis(negativeTransform.getBasis()*ToBasis(negativeRotation));
 		
-		btScalar positiveMass(positiveWeightFactor);
-		btScalar negativeMass(negativeWeightFactor);
-		btVector3 localInertia(0, 0, 0);
+		btScalar positiveMass(parentMass*positiveWeightFactor);
+		btScalar negativeMass(parentMass*negativeWeightFactor);
+		btVector3 positiveLocalInertia=btVector3(positiveInertia.x, positiveInertia.y, positiveInertia.z)*positiveMass;
+		btVector3 negativeLocalInertia=btVector3(negativeInertia.x, negativeInertia.y, negativeInertia.z)*negativeMass;
 		btDefaultMotionState* positiveMotionState = new btDefaultMotionState(positiveTransform);
 		btDefaultMotionState* negativeMotionState = new btDefaultMotionState(negativeTransform);
 		
-		positiveConvexHullShape->calculateLocalInertia(positiveWeightFactor, localInertia);
-		negativeConvexHullShape->calculateLocalInertia(negativeWeightFactor, localInertia);
-		
-		btRigidBody::btRigidBodyConstructionInfo positiveRbInfo(positiveMass, positiveMotionState, positiveConvexHullShape, localInertia);
-		btRigidBody::btRigidBodyConstructionInfo negativeRbInfo(negativeMass, negativeMotionState, negativeConvexHullShape, localInertia);
+		btRigidBody::btRigidBodyConstructionInfo positiveRbInfo(positiveMass, positiveMotionState, positiveConvexHullShape, positiveLocalInertia);
+		btRigidBody::btRigidBodyConstructionInfo negativeRbInfo(negativeMass, negativeMotionState, negativeConvexHullShape, negativeLocalInertia);
 		positiveRbInfo.m_angularDamping = negativeRbInfo.m_angularDamping = 0.9f;
 		btRigidBody* positiveRb = new btRigidBody(positiveRbInfo);
 		btRigidBody* negativeRb = new btRigidBody(negativeRbInfo);
+		positiveRb->setLinearVelocity(linearVelocity+angularVelocity.cross(positiveTransform.getOrigin()-parentOrigin));
+		negativeRb->setLinearVelocity(linearVelocity+angularVelocity.cross(negativeTransform.getOrigin()-parentOrigin));
+		positiveRb->setAngularVelocity(angularVelocity);
+		negativeRb->setAngularVelocity(angularVelocity);
 		glm::vec3 cutImpulseDirection=cutNormal;
 		cutImpulseDirection*=CUT_IMPULSE;
 		positiveRb->applyImpulse(btVector3(cutImpulseDirection.x, cutImpulseDirection.y, cutImpulseDirection.z), btVector3(0.5, 0.5, 0));
@@ -112,6 +128,64 @@ public:
 		dynamicsWorld->addRigidBody(positiveRb);
 		dynamicsWorld->addRigidBody(negativeRb);
 	}
+	//The same as CutShapeWithImpulse, for the pieces of a slice: the body i is replaced by a body for each piece,
+	//and each piece is pushed away from the position of the sliced body.
+	void SliceShapeWithImpulse(int i, const vector<glm::vec4> & meshPositions, const vector<btConvexHullShape*> & convexHullShapes, const vector<float> & weightFactors, const vector<glm::vec3> & inertias, const vector<glm::mat3> & rotations)
+	{
+		btCollisionObject* slicedCollisionObject = dynamicsWorld->getCollisionObjectArray()[i];
+		btRigidBody* slicedRigidBody = btRigidBody::upcast(slicedCollisionObject);
+		btTransform parentTransform;
+		if (slicedRigidBody && slicedRigidBody->getMotionState())
+			slicedRigidBody->getMotionState()->getWorldTransform(parentTransform);
+		else
+			parentTransform = slicedCollisionObject->getWorldTransform();
+		btVector3 parentOrigin=parentTransform.getOrigin();
+		btVector3 linearVelocity(0, 0, 0);
+		btVector3 angularVelocity(0, 0, 0);
+		btScalar parentMass=GetMass(slicedRigidBody);
+		if (slicedRigidBody)
+		{
+			linearVelocity=slicedRigidBody->getLinearVelocity();
+			angularVelocity=slicedRigidBody->getAngularVelocity();
+		}
+		
+		RemoveRigidBodyAtIndex(i);
+		
+		for(unsigned int p=0;p<convexHullShapes.size();p++)
+		{
+			btTransform transform=parentTransform;
+			transform.setOrigin(btVector3(meshPositions[p].x, meshPositions[p].y, meshPositions[p].z));
+			transform.setBasis(transform.getBasis()*ToBasis(rotations[p]));
+			btScalar mass(parentMass*weightFactors[p]);
+			btVector3 localInertia=btVector3(inertias[p].x, inertias[p].y, inertias[p].z)*mass;
+			btDefaultMotionState* motionState = new btDefaultMotionState(transform);
+			btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, motionState, convexHullShapes[p], localInertia);
+			rbInfo.m_angularDamping = 0.9f;
+			btRigidBody* rb = new btRigidBody(rbInfo);
+			btVector3 offset=transform.getOrigin()-parentOrigin;
+			rb->setLinearVelocity(linearVelocity+angularVelocity.cross(offset));
+			rb->setAngularVelocity(angularVelocity);
+			offset.setZ(0);
+			if(offset.length2()>SIMD_EPSILON)
+				rb->applyCentralImpulse(offset.normalized()*CUT_IMPULSE);
+			collisionShapes.push_back(convexHullShapes[p]);
+			dynamicsWorld->addRigidBody(rb);
+		}
+	}
+	//A rotation as a Bullet basis: glm stores the matrix by columns, Bullet by rows.
+	static btMatrix3x3 ToBasis(const glm::mat3 & rotation)
+	{
+		return btMatrix3x3(rotation[0][0], rotation[1][0], rotation[2][0],
+							rotation[0][1], rotation[1][1], rotation[2][1],
+							rotation[0][2], rotation[1][2], rotation[2][2]);
+	}
+	//Mass of a body of the simulation; bodies that are static (or not rigid bodies at all) count as a unit mass.
+	static btScalar GetMass(const btRigidBody* rigidBody)
+	{
+		if (rigidBody && rigidBody->getInvMass()>0)
+			return 1.f/rigidBody->getInvMass();
+		return 1.f;
+	}
 	//This method adds the convex hull shape given to the simulation and gives an impulse to it,
 	//in order to make the respective mesh appears in the view of the camera.
 	void AddRigidBodyWithImpulse(btConvexHullShape* shape)
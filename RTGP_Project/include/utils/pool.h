@@ -0,0 +1,71 @@
+/*
+VertexPool class:
+The vertices shared by a mesh and the pieces of its cuts, with the vertex buffer holding them on the gpu.
+A cut copies most of the vertices of the cut mesh to its pieces unchanged: instead of duplicating them, the pieces reference
+the pool of the cut mesh through their own indices (see Mesh), and only the vertices created by the cut are appended to it.
+The pool is append-only: the vertices already in it never change or move, so the meshes sharing it, and the cuts reading it
+in background, are never affected by an append. An append that doesn't fit in the capacity of the pool would move the
+vertices, so it is refused; then the pieces copy what they need to a new pool (copy on write, see Mesh::CommitSides).
+The vertex buffer is as large as the capacity of the pool, so the appended vertices are uploaded without reallocating it.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <vector>
+#include <stddef.h>
+#include <glad/glad.h>
+#include <utils/vertex.h>
+
+class VertexPool
+{
+public:
+	vector<Vertex> vertices;
+	GLuint VBO=0;
+
+	VertexPool(){}
+	VertexPool(vector<Vertex> vertices): vertices(std::move(vertices)) {}
+	//An empty pool with room for the given number of vertices.
+	VertexPool(size_t capacity)
+	{
+		vertices.reserve(capacity);
+	}
+	//Appends the vertices in place if they fit in the capacity of the pool, first being the index of the first one; otherwise
+	//nothing is appended and false is returned.
+	bool Append(const Vertex* newVertices, size_t count, GLuint & first)
+	{
+		if(vertices.size()+count>vertices.capacity())
+			return false;
+		first=vertices.size();
+		vertices.insert(vertices.end(), newVertices, newVertices+count);
+		return true;
+	}
+	//Uploads the vertices appended since the last call; the first call creates the buffer.
+	void Upload()
+	{
+		if(VBO==0)
+		{
+			glGenBuffers(1, &VBO);
+			glBindBuffer(GL_ARRAY_BUFFER, VBO);
+			glBufferData(GL_ARRAY_BUFFER, vertices.capacity()*sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+			uploadedCount=0;
+		}
+		else
+			glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		if(uploadedCount<vertices.size())
+			glBufferSubData(GL_ARRAY_BUFFER, uploadedCount*sizeof(Vertex), (vertices.size()-uploadedCount)*sizeof(Vertex), &vertices[uploadedCount]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		uploadedCount=vertices.size();
+	}
+	//Frees the buffer; called by the last mesh using the pool.
+	void Delete()
+	{
+		glDeleteBuffers(1, &VBO);
+		VBO=0;
+		uploadedCount=0;
+	}
+
+private:
+	size_t uploadedCount=0;
+};
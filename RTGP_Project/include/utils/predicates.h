@@ -0,0 +1,81 @@
+/*
+ExactPredicates class:
+Exact evaluation of the sign of the signed distance of a point from a plane, for the few vertices whose float distance is
+too close to zero to be trusted (see PlaneClassifier).
+The distance dot(n, v)-dot(n, p) is the sum of six products of floats; each product is exact in double precision, and their
+sum is computed exactly as a floating point expansion: a sum of doubles of increasing magnitude that don't overlap, whose
+sign is the sign of the largest one (J. R. Shewchuk, Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric
+Predicates, 1997).
+The expansion arithmetic needs each double operation to be rounded once, to double precision: it is not valid on the x87
+unit, so the project is built for SSE2.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <float.h>
+#include <glm/glm.hpp>
+
+//Relative error bound of the float signed distance computed by PlaneClassifier: the error is at most this factor times
+//the sum of the absolute values of the products, |n|.|v|+|n|.|p|. The roundings of the three products of each dot product,
+//of their sums and of the final subtraction add up to less than 4 units in the last place (FLT_EPSILON/2); twice that is used.
+#define PREDICATE_DISTANCE_ERROR (4.0f*FLT_EPSILON)
+
+class ExactPredicates
+{
+public:
+	//Sign of dot(normal, position)-dot(normal, point), evaluated exactly: 1, 0 or -1. approximation gets the distance
+	//rounded to float, with the exact sign: if the rounding loses it, it is replaced by FLT_MIN.
+	static int PlaneSide(glm::vec3 normal, glm::vec3 point, glm::vec3 position, float & approximation)
+	{
+		double expansion[12];
+		int count=0;
+		for(int i=0;i<3;i++)
+		{
+			count=GrowExpansion(expansion, count, (double)normal[i]*(double)position[i]);
+			count=GrowExpansion(expansion, count, -(double)normal[i]*(double)point[i]);
+		}
+		double sum=0.0;
+		for(int i=0;i<count;i++)
+			sum+=expansion[i];
+		int sign=count==0? 0 : expansion[count-1]>0.0? 1 : -1;
+		approximation=(float)sum;
+		//The float could be zero, or even have the wrong sign if the sum has been rounded across zero.
+		if(sign>0 && approximation<=0.0f)
+			approximation=FLT_MIN;
+		else if(sign<0 && approximation>=0.0f)
+			approximation=-FLT_MIN;
+		else if(sign==0)
+			approximation=0.0f;
+		return sign;
+	}
+
+private:
+	//a+b=sum+error exactly, sum being the rounded sum.
+	static void TwoSum(double a, double b, double & sum, double & error)
+	{
+		sum=a+b;
+		double bVirtual=sum-a;
+		double aVirtual=sum-bVirtual;
+		error=(a-aVirtual)+(b-bVirtual);
+	}
+	//Adds b to the expansion of the given number of components, in place, dropping the zero components; returns the new count,
+	//at most one more.
+	static int GrowExpansion(double* expansion, int count, double b)
+	{
+		int newCount=0;
+		double q=b;
+		for(int i=0;i<count;i++)
+		{
+			double sum, error;
+			TwoSum(q, expansion[i], sum, error);
+			if(error!=0.0)
+				expansion[newCount++]=error;
+			q=sum;
+		}
+		if(q!=0.0)
+			expansion[newCount++]=q;
+		return newCount;
+	}
+};
@@ -19,22 +19,133 @@ In particular it handles:
 #include <glm/gtc/type_ptr.hpp>
 #include <bullet/btBulletDynamicsCommon.h>
 #include <btConvexShape.h>
+#include <utils/threadpool.h>
+#include <utils/fracture.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image/stb_image.h>
 #define N_LIGHTS 3
 #define COLOR_LIMIT 256
 #define Y_KILL -6
+//In async mode, minimum number of frames between the submission of a cut and its commit.
+#define CUT_COMMIT_DELAY 1
+//A speculative cut is used on release if its plane is within these tolerances from the final one (angle cosine and distance
+//in object space); while dragging, it is recomputed when the plane moves farther than half the tolerances.
+#define SPECULATIVE_CUT_COS_TOLERANCE 0.9994f
+#define SPECULATIVE_CUT_DISTANCE_TOLERANCE 0.05f
+//Consecutive segments of a swipe crossing the same mesh are merged if their planes are closer than this angle cosine.
+#define POLYLINE_MERGE_COS 0.99996f
+//The pieces of a cut covering less than this fraction of the screen height, or less than this fraction of the volume of their
+//model (see Mesh::modelFraction), are decimated, if they have more than DECIMATE_MIN_TRIANGLES triangles, down to
+//DECIMATE_RATIO of them.
+#define DECIMATE_SCREEN_SIZE 0.1f
+#define DECIMATE_MODEL_FRACTION 0.01f
+#define DECIMATE_MIN_TRIANGLES 64
+#define DECIMATE_RATIO 0.25f
+//Largest error of a collapse, relative to the fourth power of the radius of the piece (the error is a squared distance
+//weighted by an area).
+#define DECIMATE_MAX_ERROR 1e-5f
+//In slab mode, each mesh crossed by the swipe is sliced by SLAB_COUNT planes parallel to the chord of its segments, spaced by
+//this fraction of its bounding radius.
+#define SLAB_COUNT 3
+#define SLAB_SPACING 0.5f
+static_assert(SLAB_COUNT<=SLICE_MAX_PLANES, "The slicer can't cut more than SLICE_MAX_PLANES slab planes");
+
+//A point of the swipe, in ndc space, with the time it was sampled at.
+struct SwipePoint
+{
+	glm::vec3 positionNDC;
+	double time;
+};
+
+//The cut of one of the meshes hit by the cutting segment: it is computed on the thread pool, then committed to the scene.
+struct MeshCut
+{
+	const btCollisionShape* shape;
+	//Index of the mesh when the cut is computed; it changes while the cuts are committed.
+	int meshIndex;
+	//Model transform of the vertices of the mesh (see Mesh::VertexModel), used to bring the swipe in their frame.
+	glm::mat4 model;
+	//The segments of the swipe crossing the mesh; with a single segment, the mesh is cut by its plane.
+	CutPolyline polyline;
+	//In slab mode, the planes slicing the mesh in slabs, in the frame of its vertices; empty for a cut along the polyline.
+	vector<CutPlane> slabPlanes;
+	//World space direction of the impulse given to the two pieces.
+	glm::vec3 cutNormal;
+	//In pre-fracture mode, the baked split of the mesh matching the plane of the cut, or -1; flipped if the plane faces the
+	//other way (see FractureHierarchy::FindSplit).
+	int bakedSplit;
+	bool bakedFlip;
+	//The result is marked as grazed (see CutResult::grazed) as soon as the planes are found to miss the bounding sphere of the mesh.
+	CutResult result;
+	//The cells of the slabs, in slab mode.
+	SliceResult slice;
+};
+
+//A cut running in background: in async mode the mesh keeps simulating until the cut is committed by CommitCuts;
+//while the cutting segment is dragged, speculative cuts are computed for the meshes it crosses.
+struct PendingCut
+{
+	shared_ptr<MeshCut> cut;
+	future<void> done;
+	//Frames elapsed since the submission.
+	int frames;
+};
+
+//The decimation of a small piece, computed on the thread pool on a copy of its geometry; CommitCuts swaps the simplified mesh in.
+struct PendingDecimation
+{
+	const btCollisionShape* shape;
+	shared_ptr<Mesh> mesh;
+	future<void> done;
+};
+
+//The cutter, the slicer and the decimator of a thread; they are kept from a job to the next one, so their arenas and buffers
+//are reused, as the vertices of the cut meshes that don't own their pool, which are gathered here.
+struct CutWorkspace
+{
+	MeshCutter cutter;
+	MeshSlicer slicer;
+	MeshDecimator decimator;
+	vector<Vertex> vertices;
+};
+
+//Pending cuts read the geometry of their mesh in place: it must not move when the meshes vector is reallocated or reordered.
+static_assert(is_nothrow_move_constructible<Mesh>::value, "Mesh must be moved, not copied, by the meshes vector");
 
 class Scene
 {
 private:
 	Physics engine;
+	//A workspace for each thread that computes cuts, indexed by ThreadPool::GetCurrentWorker(); it is declared before the
+	//pool, so it is destroyed after the workers have stopped.
+	unique_ptr<CutWorkspace[]> cutWorkspaces;
+	//Worker threads shared by the cuts.
+	unique_ptr<ThreadPool> threadPool;
 	Shader planeShader;
 	Shader objectShader;
 	Mesh planeMesh;
 	GLint planeTexture;
 	GLint objectTexture;
 	vector<Mesh> cuttableMeshes;
+	vector<PendingCut> pendingCuts;
+	//Cuts computed while the segment is dragged, at most one for each mesh.
+	vector<PendingCut> speculativeCuts;
+	//Speculative cuts no longer needed, whose job may still be running.
+	vector<PendingCut> retiredCuts;
+	vector<PendingDecimation> pendingDecimations;
+	//Baked fractures of the models, by path; models without one have a null entry, so their file is looked for once.
+	map<string, shared_ptr<FractureHierarchy>> fractures;
+	//When true, cuts are computed in background and committed at the beginning of a later frame.
+	bool asyncCut;
+	bool speculativeCut;
+	//When true, the small pieces of the cuts are decimated in background.
+	bool decimation;
+	//When true, the cuts close to a baked split of their mesh swap in its pieces instead of being computed.
+	bool preFracture;
+	//When true, the meshes are sliced in slabs instead of being cut along the swipe.
+	bool slabCut;
+	//Cuts that have only grazed their mesh, leaving it whole.
+	unsigned int grazes;
 	GLfloat deltaTime;
 	const GLfloat maxSecPerFrame=1.0f / 60.0f;
 	GLfloat Kd = 0.8f;
@@ -62,8 +173,19 @@ public:
 	Scene(glm::mat4 projection, glm::mat4 view)
 	{
 		Model* object = new Model("../../models/plane.obj");
-		planeMesh=object->meshes[0];
+		planeMesh=std::move(object->meshes[0]);
+		//The meshes are moved out of the model, so that deleting it doesn't delete their buffers, and their pools are not shared.
+		object->meshes.clear();
+		delete object;
 		engine=Physics();
+		threadPool.reset(new ThreadPool());
+		cutWorkspaces.reset(new CutWorkspace[threadPool->GetWorkerCount()]);
+		asyncCut=true;
+		speculativeCut=true;
+		decimation=true;
+		preFracture=true;
+		slabCut=false;
+		grazes=0;
 		deltaTime=0.0f;
 		currentFrame=0.0f;
 		lastFrame=0.0f;
@@ -110,9 +232,23 @@ public:
 		objectDiffuseColor[1]=green;
 		objectDiffuseColor[2]=blue;
 		Model* object = new Model(meshPath);
+		//The baked fracture of the model is loaded with its first instance, then shared; models of several meshes have none.
+		if(object->meshes.size()==1)
+		{
+			map<string, shared_ptr<FractureHierarchy>>::iterator fractureIt=fractures.find(meshPath);
+			if(fractureIt==fractures.end())
+				fractureIt=fractures.insert(make_pair(meshPath, FractureHierarchy::Load(FractureHierarchy::BakedPath(meshPath), object->meshes[0]))).first;
+			if(fractureIt->second)
+			{
+				object->meshes[0].fracture=fractureIt->second;
+				object->meshes[0].fractureNode=0;
+			}
+		}
 		std::vector<Mesh>::iterator cuttableMeshesIt=cuttableMeshes.begin();
-		cuttableMeshes.insert(cuttableMeshesIt, object->meshes.begin(), object->meshes.end());
+		cuttableMeshes.insert(cuttableMeshesIt, make_move_iterator(object->meshes.begin()), make_move_iterator(object->meshes.end()));
 		engine.AddRigidBodyWithImpulse(object->shape);
+		object->meshes.clear();
+		delete object;
 	}
 	//This is a method used in the main class; whether all cuttable meshes are deallocated,
 	//this method will return a true value, implying that a new mesh will be added.
@@ -120,61 +256,161 @@ public:
 	{
 		return cuttableMeshes.size()==0;
 	}
-	//This function perform the cut of all meshes that intersect the segment defined by the given positions;
+	//This function perform the cut of all meshes that intersect the swipe, a polyline defined by the given points;
 	//each mesh cut will generate two new independent meshes are subsequentialy added to the scene.
-	void Cut(glm::vec3 startCutPointNDC, glm::vec3 endCutPointNDC)
+	//Each mesh is cut by the segments crossing it: by a plane if it is crossed by a single segment, along the polyline otherwise.
+	//The cuts of the different meshes run in parallel on the thread pool; in sync mode they are committed together before returning,
+	//in async mode they are committed by CommitCuts in a later frame. Meshes whose previous cut is still pending are not cut again.
+	//The speculative cut of a mesh, computed while dragging, is used in place of a new one if its planes are close enough.
+	//In pre-fracture mode, the meshes cut close to one of their baked splits get its pieces at once, in both modes.
+	//Cuts whose planes miss the bounding sphere of their mesh graze it, and are dropped at once.
+	//In slab mode, each mesh is sliced in slabs (see SLAB_COUNT) instead, which are never baked nor speculative.
+	void Cut(const vector<SwipePoint> & swipe)
 	{
-		glm::vec4 cutStartPointWS=glm::vec4(startCutPointNDC.x, startCutPointNDC.y, cutDepthNDC, 1.);
-		glm::vec4 cutEndPointWS=glm::vec4(endCutPointNDC.x, endCutPointNDC.y, cutDepthNDC, 1.);
-		//Converting cut segment from ndc to world space to perform the cut check
-		glm::mat4 projViewInv = glm::inverse(projection * view);
-		cutStartPointWS = projViewInv*cutStartPointWS;
-		cutStartPointWS/=cutStartPointWS.w;
-		cutEndPointWS = projViewInv*cutEndPointWS;
-		cutEndPointWS/=cutEndPointWS.w;
-		btCollisionWorld::AllHitsRayResultCallback callback(btVector3(cutStartPointWS.x, cutStartPointWS.y, cutStartPointWS.z), btVector3(cutEndPointWS.x, cutEndPointWS.y, cutEndPointWS.z));
-		engine.dynamicsWorld->rayTest(btVector3(cutStartPointWS.x, cutStartPointWS.y, cutStartPointWS.z), btVector3(cutEndPointWS.x, cutEndPointWS.y, cutEndPointWS.z), callback);
-									
-		if(callback.hasHit())
+		vector<MeshCut> cuts;
+		FindCuts(swipe, cuts);
+		vector<MeshCut> bakedCuts;
+		vector<PendingCut> speculativeResults;
+		unsigned int newCuts=0;
+		for(unsigned int i=0;i<cuts.size();i++)
 		{
-			for(int i=0;i<callback.m_collisionObjects.size();i++)
+			PendingCut speculative;
+			if(cuts[i].result.grazed)
+				grazes++;
+			else if(cuts[i].bakedSplit>=0)
+				bakedCuts.push_back(cuts[i]);
+			else if(cuts[i].slabPlanes.empty() && TakeSpeculativeCut(cuts[i], speculative))
+				speculativeResults.push_back(std::move(speculative));
+			else
+				cuts[newCuts++]=cuts[i];
+		}
+		cuts.resize(newCuts);
+		//The swipe is over: the speculative cuts left are not needed anymore.
+		while(!speculativeCuts.empty())
+		{
+			retiredCuts.push_back(std::move(speculativeCuts.back()));
+			speculativeCuts.pop_back();
+		}
+		
+		if(asyncCut)
+		{
+			for(unsigned int i=0;i<speculativeResults.size();i++)
+				pendingCuts.push_back(std::move(speculativeResults[i]));
+			for(unsigned int i=0;i<cuts.size();i++)
+				pendingCuts.push_back(StartCut(cuts[i]));
+		}
+		else
+		{
+			//First the geometry of all cuts is computed, in parallel; each cut may split its triangles on the pool too.
+			threadPool->ParallelFor(cuts.size(), [this, &cuts](size_t i, unsigned int)
 			{
-				const btCollisionObject* object=callback.m_collisionObjects[i];
-				const btCollisionShape* collisionShape=object->getCollisionShape();
-				int meshIndex=engine.GetCollisionShapeIndex(collisionShape);
-				if(meshIndex<0)
-					continue;
-				glm::mat4 model=engine.GetObjectModelMatrix(meshIndex);
-				btConvexHullShape* positiveConvexHullShape;
-				btConvexHullShape* negativeConvexHullShape;
-				glm::vec4 positiveMeshPositionWS;
-				glm::vec4 negativeMeshPositionWS;
-				Mesh positiveMesh;
-				Mesh negativeMesh;
-				float positiveWeightFactor;
-				float negativeWeightFactor;
-				cuttableMeshes[meshIndex].Cut(positiveMesh,
-											  negativeMesh,
-											  positiveMeshPositionWS, 
-											  negativeMeshPositionWS, 
-											  cutStartPointWS, 
-											  cutEndPointWS, 
-											  model, 
-											  positiveConvexHullShape, 
-											  negativeConvexHullShape, 
-											  positiveWeightFactor, 
-											  negativeWeightFactor);
-				
-				glm::vec3 cutNormal=glm::vec3(-1*(cutEndPointWS.y-cutStartPointWS.y), cutEndPointWS.x-cutStartPointWS.x, 0.0f);
-				engine.CutShapeWithImpulse(cutNormal, meshIndex, negativeWeightFactor, negativeMeshPositionWS, negativeConvexHullShape, positiveWeightFactor, positiveMeshPositionWS, positiveConvexHullShape);
-				//Delete the old mesh
-				cuttableMeshes[meshIndex].Delete();
-				iter_swap(cuttableMeshes.begin()+meshIndex, cuttableMeshes.end()-1);
-				cuttableMeshes.pop_back();
-				cuttableMeshes.push_back(positiveMesh);
-				cuttableMeshes.push_back(negativeMesh);	
+				const Mesh & mesh=cuttableMeshes[cuts[i].meshIndex];
+				ComputeCut(mesh.pool->vertices.data(), mesh.poolIndices.empty()? nullptr : mesh.poolIndices.data(), mesh.vertexCount, mesh.origin, mesh.axes, mesh.indices.data(), mesh.indices.size(), mesh.adjacency.Twins(), mesh.tree.get(), mesh.attributes, cuts[i], threadPool.get(), cutWorkspaces.get());
+			});
+			
+			//Then all cuts are committed on this thread: physics and the meshes vector are updated one cut after the other.
+			for(unsigned int i=0;i<cuts.size();i++)
+				CommitMeshCut(cuts[i]);
+			for(unsigned int i=0;i<speculativeResults.size();i++)
+			{
+				speculativeResults[i].done.get();
+				CommitMeshCut(*speculativeResults[i].cut);
+			}
+		}
+		//The baked cuts are committed last, since they reorder the meshes the cuts above have been started on by index.
+		for(unsigned int i=0;i<bakedCuts.size();i++)
+			CommitBakedCut(bakedCuts[i]);
+	}
+	//Called at each frame while the swipe is dragged: the meshes crossed by the swipe so far are cut in background,
+	//so that on release the cut of a mesh is often already available. Each mesh has at most one speculative cut running;
+	//when it ends, it is started again if the planes have moved in the meantime.
+	void UpdateSpeculativeCut(const vector<SwipePoint> & swipe)
+	{
+		if(!speculativeCut || slabCut || swipe.size()<2)
+			return;
+		vector<MeshCut> cuts;
+		FindCuts(swipe, cuts);
+		vector<PendingCut> updatedCuts;
+		for(unsigned int i=0;i<cuts.size();i++)
+		{
+			//Baked cuts cost nothing on release, and grazing ones are not computed.
+			if(cuts[i].bakedSplit>=0 || cuts[i].result.grazed)
+				continue;
+			int speculativeIndex=FindJob(speculativeCuts, cuts[i].shape);
+			if(speculativeIndex<0)
+			{
+				updatedCuts.push_back(StartCut(cuts[i]));
+				continue;
 			}
+			PendingCut & speculative=speculativeCuts[speculativeIndex];
+			bool running=speculative.done.wait_for(chrono::seconds(0))!=future_status::ready;
+			if(running || PolylinesMatch(speculative.cut->polyline, cuts[i].polyline, 0.5f))
+				updatedCuts.push_back(std::move(speculative));
+			else
+				updatedCuts.push_back(StartCut(cuts[i]));
+			speculativeCuts.erase(speculativeCuts.begin()+speculativeIndex);
+		}
+		//Meshes not crossed by the segment anymore
+		for(unsigned int i=0;i<speculativeCuts.size();i++)
+			retiredCuts.push_back(std::move(speculativeCuts[i]));
+		speculativeCuts=std::move(updatedCuts);
+	}
+	//Called at the beginning of each frame: the pending cuts that are complete and old enough are committed,
+	//each one with the transform and the velocity of its mesh at this moment; then the completed decimations are swapped in.
+	void CommitCuts()
+	{
+		for(unsigned int i=0;i<retiredCuts.size();)
+		{
+			if(retiredCuts[i].done.wait_for(chrono::seconds(0))==future_status::ready)
+				retiredCuts.erase(retiredCuts.begin()+i);
+			else
+				i++;
+		}
+		unsigned int i=0;
+		while(i<pendingCuts.size())
+		{
+			PendingCut & pendingCut=pendingCuts[i];
+			pendingCut.frames++;
+			if(pendingCut.frames<CUT_COMMIT_DELAY || pendingCut.done.wait_for(chrono::seconds(0))!=future_status::ready)
+			{
+				i++;
+				continue;
+			}
+			pendingCut.done.get();
+			shared_ptr<MeshCut> cut=pendingCut.cut;
+			pendingCuts.erase(pendingCuts.begin()+i);
+			CommitMeshCut(*cut);
 		}
+		CommitDecimations();
+	}
+	void SetAsyncCut(bool async)
+	{
+		asyncCut=async;
+	}
+	bool IsAsyncCut()
+	{
+		return asyncCut;
+	}
+	void SetSpeculativeCut(bool speculative)
+	{
+		speculativeCut=speculative;
+	}
+	void SetDecimation(bool decimate)
+	{
+		decimation=decimate;
+	}
+	void SetPreFracture(bool bakedCuts)
+	{
+		preFracture=bakedCuts;
+	}
+	void SetSlabCut(bool slabs)
+	{
+		slabCut=slabs;
+	}
+	//Number of cuts so far that have grazed their mesh without dividing it.
+	unsigned int GetGrazes()
+	{
+		return grazes;
 	}
 	//This method just render the background plane and all cuttable meshes; each cuttable mesh gets its model transform,
 	//from the simulation class.
@@ -235,7 +471,7 @@ public:
 			glUniform3fv(pointLightLocation, 1, glm::value_ptr(lightPositions[0]));
 			glUniform3fv(objectDiffuseLocation, 1, objectDiffuseColor);
 			glUniform1f(kdObjectLocation, Kd);
-			glm::mat4 objectModelMatrix=engine.GetObjectModelMatrix(i);
+			glm::mat4 objectModelMatrix=cuttableMeshesIt->VertexModel(engine.GetObjectModelMatrix(i));
 			glm::mat3 objectNormalMatrix;
 			objectNormalMatrix = glm::inverseTranspose(glm::mat3(view*objectModelMatrix));
 			glUniformMatrix4fv(glGetUniformLocation(objectShader.Program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(objectModelMatrix));
@@ -268,6 +504,7 @@ public:
 	
 			if(transform.getOrigin().getY()<=Y_KILL)
 			{
+				WaitForMeshJobs(engine.collisionShapes[i]);
 				cuttableMeshes[i].Delete();
 				iter_swap(cuttableMeshes.begin()+i, cuttableMeshes.end()-1);
 				cuttableMeshes.pop_back();
@@ -278,12 +515,499 @@ public:
 	//This function is called only during the application shutdown, to remove everything the scene object has allocated.
 	void Clear()
 	{
+		WaitForJobs(pendingCuts, nullptr);
+		WaitForJobs(speculativeCuts, nullptr);
+		WaitForJobs(retiredCuts, nullptr);
+		for(unsigned int i=0;i<pendingDecimations.size();i++)
+			pendingDecimations[i].done.wait();
+		pendingDecimations.clear();
 		engine.Clear();
 		objectShader.Delete();
 		planeMesh.Delete();
 		std::vector<Mesh>::iterator cuttableMeshesIt;
 		for (cuttableMeshesIt = cuttableMeshes.begin(); cuttableMeshesIt != cuttableMeshes.end(); ++cuttableMeshesIt)
 			cuttableMeshesIt->Delete();
-		cuttableMeshes.clear();		
+		cuttableMeshes.clear();
+		//The vertex buffers of the baked fractures are freed after the meshes sharing them.
+		map<string, shared_ptr<FractureHierarchy>>::iterator fractureIt;
+		for (fractureIt = fractures.begin(); fractureIt != fractures.end(); ++fractureIt)
+			if(fractureIt->second)
+				fractureIt->second->Delete();
+		fractures.clear();
 	}    
+
+private:
+	//Converts the swipe to world space and prepares the cut of each mesh it crosses, but the ones with a pending cut.
+	//Each segment is tested on its own, and each mesh gets the segments crossing it.
+	void FindCuts(const vector<SwipePoint> & swipe, vector<MeshCut> & cuts)
+	{
+		//Converting the swipe from ndc to world space to perform the cut check
+		glm::mat4 projViewInv = glm::inverse(projection * view);
+		vector<glm::vec4> swipeWS(swipe.size());
+		for(unsigned int i=0;i<swipe.size();i++)
+		{
+			swipeWS[i]=projViewInv*glm::vec4(swipe[i].positionNDC.x, swipe[i].positionNDC.y, cutDepthNDC, 1.);
+			swipeWS[i]/=swipeWS[i].w;
+		}
+		
+		vector<vector<unsigned int>> segments;
+		for(unsigned int s=0;s+1<swipeWS.size();s++)
+		{
+			glm::vec4 cutStartPointWS=swipeWS[s];
+			glm::vec4 cutEndPointWS=swipeWS[s+1];
+			if(cutStartPointWS==cutEndPointWS)
+				continue;
+			btCollisionWorld::AllHitsRayResultCallback callback(btVector3(cutStartPointWS.x, cutStartPointWS.y, cutStartPointWS.z), btVector3(cutEndPointWS.x, cutEndPointWS.y, cutEndPointWS.z));
+			engine.dynamicsWorld->rayTest(btVector3(cutStartPointWS.x, cutStartPointWS.y, cutStartPointWS.z), btVector3(cutEndPointWS.x, cutEndPointWS.y, cutEndPointWS.z), callback);
+			if(!callback.hasHit())
+				continue;
+			for(int i=0;i<callback.m_collisionObjects.size();i++)
+			{
+				const btCollisionShape* collisionShape=callback.m_collisionObjects[i]->getCollisionShape();
+				int meshIndex=engine.GetCollisionShapeIndex(collisionShape);
+				if(meshIndex<0 || FindJob(pendingCuts, collisionShape)>=0)
+					continue;
+				unsigned int c=0;
+				while(c<cuts.size() && cuts[c].shape!=collisionShape)
+					c++;
+				if(c==cuts.size())
+				{
+					MeshCut meshCut;
+					meshCut.shape=collisionShape;
+					meshCut.meshIndex=meshIndex;
+					meshCut.model=cuttableMeshes[meshIndex].VertexModel(engine.GetObjectModelMatrix(meshIndex));
+					cuts.push_back(meshCut);
+					segments.push_back(vector<unsigned int>());
+				}
+				segments[c].push_back(s);
+			}
+		}
+		for(unsigned int c=0;c<cuts.size();c++)
+		{
+			BuildPolyline(cuts[c], segments[c], swipeWS);
+			if(slabCut)
+			{
+				CutPlane chordPlane=Mesh::CalculateCutPlane(swipeWS[segments[c].front()], swipeWS[segments[c].back()+1], cuts[c].model);
+				float spacing=SLAB_SPACING*cuttableMeshes[cuts[c].meshIndex].BoundingRadius();
+				cuts[c].slabPlanes=MeshSlicer::SlabPlanes(chordPlane, spacing, SLAB_COUNT);
+			}
+			cuts[c].result.grazed=MissesBoundingSphere(cuts[c]);
+			FindBakedSplit(cuts[c]);
+		}
+	}
+	//Whether all planes of the cut pass outside the bounding sphere of the mesh: Bullet reports hits against the convex hull
+	//and its margin, which the planes may just graze.
+	bool MissesBoundingSphere(const MeshCut & meshCut)
+	{
+		Mesh & mesh=cuttableMeshes[meshCut.meshIndex];
+		float radius=mesh.BoundingRadius();
+		const vector<CutPlane> & planes=meshCut.slabPlanes.empty()? meshCut.polyline.planes : meshCut.slabPlanes;
+		for(unsigned int i=0;i<planes.size();i++)
+		{
+			const CutPlane & plane=planes[i];
+			if(glm::abs(glm::dot(plane.normal, mesh.origin-plane.point))<=radius)
+				return false;
+		}
+		return true;
+	}
+	//In pre-fracture mode, looks for the baked split of the mesh matching the cut; only the cuts by a single plane can match, and
+	//slabs never do.
+	//The plane is in the frame of the vertices, which for the model and its baked pieces is the frame of the model.
+	void FindBakedSplit(MeshCut & meshCut) const
+	{
+		meshCut.bakedSplit=-1;
+		meshCut.bakedFlip=false;
+		const Mesh & mesh=cuttableMeshes[meshCut.meshIndex];
+		if(!preFracture || !mesh.fracture || meshCut.polyline.planes.size()!=1 || !meshCut.slabPlanes.empty())
+			return;
+		meshCut.bakedSplit=mesh.fracture->FindSplit(mesh.fractureNode, meshCut.polyline.planes[0], meshCut.bakedFlip);
+	}
+	//Converts the segments crossing the mesh to object space. Joined segments that are almost aligned are merged, since their planes
+	//would divide the mesh in slivers (or not at all, if they are the same plane).
+	//The slicer handles at most SLICE_MAX_PLANES planes, so on longer swipes the adjacent planes closest in direction are merged
+	//too, each pair into the plane of the chord they span, until the polyline fits.
+	//The impulse is perpendicular to the chord going from the first to the last point of the segments.
+	static void BuildPolyline(MeshCut & meshCut, const vector<unsigned int> & segments, const vector<glm::vec4> & swipeWS)
+	{
+		glm::mat4 invModel=glm::inverse(meshCut.model);
+		CutPolyline & polyline=meshCut.polyline;
+		vector<unsigned int> firstSegments;
+		vector<unsigned int> lastSegments;
+		for(unsigned int i=0;i<segments.size();i++)
+		{
+			unsigned int s=segments[i];
+			CutPlane plane=Mesh::CalculateCutPlane(swipeWS[s], swipeWS[s+1], meshCut.model);
+			bool joined=i>0 && segments[i-1]==s-1;
+			if(joined && glm::dot(polyline.planes.back().normal, plane.normal)>=POLYLINE_MERGE_COS)
+			{
+				polyline.planes.back()=Mesh::CalculateCutPlane(swipeWS[firstSegments.back()], swipeWS[s+1], meshCut.model);
+				lastSegments.back()=s;
+				continue;
+			}
+			if(i>0)
+				polyline.joined.back()=joined;
+			polyline.planes.push_back(plane);
+			polyline.starts.push_back(glm::vec3(invModel*swipeWS[s]));
+			polyline.joined.push_back(false);
+			firstSegments.push_back(s);
+			lastSegments.push_back(s);
+		}
+		while(polyline.planes.size()>SLICE_MAX_PLANES)
+		{
+			unsigned int closest=0;
+			for(unsigned int i=1;i+1<polyline.planes.size();i++)
+				if(glm::dot(polyline.planes[i].normal, polyline.planes[i+1].normal)>glm::dot(polyline.planes[closest].normal, polyline.planes[closest+1].normal))
+					closest=i;
+			polyline.planes[closest]=Mesh::CalculateCutPlane(swipeWS[firstSegments[closest]], swipeWS[lastSegments[closest+1]+1], meshCut.model);
+			polyline.joined[closest]=polyline.joined[closest+1];
+			lastSegments[closest]=lastSegments[closest+1];
+			polyline.planes.erase(polyline.planes.begin()+closest+1);
+			polyline.starts.erase(polyline.starts.begin()+closest+1);
+			polyline.joined.erase(polyline.joined.begin()+closest+1);
+			firstSegments.erase(firstSegments.begin()+closest+1);
+			lastSegments.erase(lastSegments.begin()+closest+1);
+		}
+		glm::vec4 chordStart=swipeWS[segments.front()];
+		glm::vec4 chordEnd=swipeWS[segments.back()+1];
+		meshCut.cutNormal=glm::vec3(-1*(chordEnd.y-chordStart.y), chordEnd.x-chordStart.x, 0.0f);
+	}
+	//Computes the geometry of the given cut; the mesh is passed by its vertices and indices, since the Mesh object may move meanwhile.
+	//The vertices are the ones of its pool with the given pool indices (see Mesh::GatherVertices); origin is its center of mass
+	//and axes its principal axes, which give the frame of its convex hull.
+	//The hulls of the pieces are clipped from the convex hull of the mesh, which is deleted only after the job (see WaitForMeshJobs).
+	//twins is the adjacency of the mesh and tree its tree of triangles, null if it has none; attributes are the ones of its vertices.
+	static void ComputeCut(const Vertex* poolVertices, const GLuint* poolIndices, size_t vertexCount, glm::vec3 origin, glm::mat3 axes, const unsigned int* indices, size_t indexCount, const int* twins, const TriangleTree* tree, unsigned int attributes, MeshCut & meshCut, ThreadPool* pool, CutWorkspace* workspaces)
+	{
+		const btConvexHullShape* hull=nullptr;
+		if(meshCut.shape->getShapeType()==CONVEX_HULL_SHAPE_PROXYTYPE)
+			hull=static_cast<const btConvexHullShape*>(meshCut.shape);
+		CutWorkspace & workspace=workspaces[ThreadPool::GetCurrentWorker()];
+		const Vertex* vertices=Mesh::GatherVertices(poolVertices, poolIndices, vertexCount, workspace.vertices);
+		if(!meshCut.slabPlanes.empty())
+		{
+			MeshSlicer & slicer=workspace.slicer;
+			slicer.SetHull(hull, origin, axes);
+			slicer.SetAdjacency(twins);
+			slicer.SetTree(tree);
+			slicer.SetAttributes(attributes);
+			slicer.Slice(vertices, vertexCount, indices, indexCount, meshCut.slabPlanes, meshCut.slice);
+		}
+		else if(meshCut.polyline.planes.size()==1)
+		{
+			MeshCutter & cutter=workspace.cutter;
+			cutter.SetThreadPool(pool);
+			cutter.SetHull(hull, origin, axes);
+			cutter.SetAdjacency(twins);
+			cutter.SetTree(tree);
+			cutter.SetAttributes(attributes);
+			cutter.Cut(vertices, vertexCount, indices, indexCount, meshCut.polyline.planes[0], meshCut.result);
+		}
+		else
+		{
+			MeshSlicer & slicer=workspace.slicer;
+			slicer.SetHull(hull, origin, axes);
+			slicer.SetAdjacency(twins);
+			slicer.SetTree(tree);
+			slicer.SetAttributes(attributes);
+			slicer.Cut(vertices, vertexCount, indices, indexCount, meshCut.polyline, meshCut.result);
+		}
+	}
+	//Starts the cut on the thread pool.
+	//The job works on the pool, indices and adjacency of the mesh in place; the mesh is not deleted until the job has finished
+	//(see WaitForMeshJobs), and its buffers keep their address when the Mesh object is moved inside the vector. The pool is
+	//append-only, so the cuts of the other meshes sharing it don't move its vertices either.
+	PendingCut StartCut(const MeshCut & meshCut)
+	{
+		const Mesh & mesh=cuttableMeshes[meshCut.meshIndex];
+		const Vertex* poolVertices=mesh.pool->vertices.data();
+		const GLuint* poolIndices=mesh.poolIndices.empty()? nullptr : mesh.poolIndices.data();
+		size_t vertexCount=mesh.vertexCount;
+		glm::vec3 origin=mesh.origin;
+		glm::mat3 axes=mesh.axes;
+		const unsigned int* indices=mesh.indices.data();
+		size_t indexCount=mesh.indices.size();
+		const int* twins=mesh.adjacency.Twins();
+		//The job holds the tree, which the Mesh object shares.
+		shared_ptr<const TriangleTree> tree=mesh.tree;
+		unsigned int attributes=mesh.attributes;
+		ThreadPool* pool=threadPool.get();
+		CutWorkspace* workspaces=cutWorkspaces.get();
+		PendingCut pendingCut;
+		pendingCut.cut=make_shared<MeshCut>(meshCut);
+		pendingCut.frames=0;
+		shared_ptr<MeshCut> cut=pendingCut.cut;
+		pendingCut.done=threadPool->Submit([cut, poolVertices, poolIndices, vertexCount, origin, axes, indices, indexCount, twins, tree, attributes, pool, workspaces]()
+		{
+			ComputeCut(poolVertices, poolIndices, vertexCount, origin, axes, indices, indexCount, twins, tree.get(), attributes, *cut, pool, workspaces);
+		});
+		return pendingCut;
+	}
+	//Two planes match if the angle between their normals and the distance of the second point from the first plane
+	//are within the speculative cut tolerances, scaled by the given factor.
+	static bool PlanesMatch(const CutPlane & a, const CutPlane & b, float toleranceFactor=1.0f)
+	{
+		float cosTolerance=1.0f-(1.0f-SPECULATIVE_CUT_COS_TOLERANCE)*toleranceFactor;
+		return glm::dot(a.normal, b.normal)>=cosTolerance &&
+				glm::abs(glm::dot(a.normal, b.point-a.point))<=SPECULATIVE_CUT_DISTANCE_TOLERANCE*toleranceFactor;
+	}
+	static bool PolylinesMatch(const CutPolyline & a, const CutPolyline & b, float toleranceFactor=1.0f)
+	{
+		if(a.planes.size()!=b.planes.size())
+			return false;
+		for(unsigned int i=0;i<a.planes.size();i++)
+			if(!PlanesMatch(a.planes[i], b.planes[i], toleranceFactor))
+				return false;
+		return true;
+	}
+	//If the mesh of the given cut has a speculative cut with matching planes, it is removed from the speculative ones and
+	//returned, with the impulse of the final cut; otherwise the speculative cut, if any, is retired.
+	bool TakeSpeculativeCut(const MeshCut & meshCut, PendingCut & speculative)
+	{
+		int speculativeIndex=FindJob(speculativeCuts, meshCut.shape);
+		if(speculativeIndex<0)
+			return false;
+		bool match=PolylinesMatch(speculativeCuts[speculativeIndex].cut->polyline, meshCut.polyline);
+		if(match)
+		{
+			speculative=std::move(speculativeCuts[speculativeIndex]);
+			speculative.cut->cutNormal=meshCut.cutNormal;
+			speculative.frames=0;
+		}
+		else
+			retiredCuts.push_back(std::move(speculativeCuts[speculativeIndex]));
+		speculativeCuts.erase(speculativeCuts.begin()+speculativeIndex);
+		return match;
+	}
+	static int FindJob(const vector<PendingCut> & jobs, const btCollisionShape* shape)
+	{
+		for(unsigned int i=0;i<jobs.size();i++)
+			if(jobs[i].cut->shape==shape)
+				return i;
+		return -1;
+	}
+	//Waits for the jobs of the given shape (all of them, if shape is null) and drops them.
+	static void WaitForJobs(vector<PendingCut> & jobs, const btCollisionShape* shape)
+	{
+		for(unsigned int i=0;i<jobs.size();)
+		{
+			if(shape==nullptr || jobs[i].cut->shape==shape)
+			{
+				jobs[i].done.wait();
+				jobs.erase(jobs.begin()+i);
+			}
+			else
+				i++;
+		}
+	}
+	//Called before a mesh is removed from the scene: no job may still be reading its geometry.
+	//Decimations work on a copy of the geometry, so they are just dropped; their shape could be reused by a new mesh.
+	void WaitForMeshJobs(const btCollisionShape* shape)
+	{
+		WaitForJobs(pendingCuts, shape);
+		WaitForJobs(speculativeCuts, shape);
+		WaitForJobs(retiredCuts, shape);
+		for(unsigned int i=0;i<pendingDecimations.size();)
+		{
+			if(pendingDecimations[i].shape==shape)
+				pendingDecimations.erase(pendingDecimations.begin()+i);
+			else
+				i++;
+		}
+	}
+	//Fraction of the screen height covered by a sphere of the given radius, centered at the given world position.
+	float ScreenSize(float radius, glm::vec4 positionWS) const
+	{
+		float depth=-(view*positionWS).z;
+		if(depth<=0.0f)
+			return 0.0f;
+		return radius*projection[1][1]/depth;
+	}
+	//Starts the decimation of the mesh of the given shape on the thread pool, if it is small on the screen or a small part of its
+	//model, and has enough triangles.
+	//The job simplifies a copy of the mesh, with a pool of its own, and rebuilds its adjacency and tree if the mesh has them; the
+	//convex hull is left as it is.
+	void StartDecimation(const btCollisionShape* shape, glm::vec4 positionWS)
+	{
+		int meshIndex=engine.GetCollisionShapeIndex(shape);
+		if(!decimation || meshIndex<0)
+			return;
+		Mesh & mesh=cuttableMeshes[meshIndex];
+		size_t triangleCount=mesh.indices.size()/3;
+		float radius=mesh.BoundingRadius();
+		if(triangleCount<=DECIMATE_MIN_TRIANGLES)
+			return;
+		if(ScreenSize(radius, positionWS)>=DECIMATE_SCREEN_SIZE && mesh.modelFraction>=DECIMATE_MODEL_FRACTION)
+			return;
+		size_t targetTriangles=max((size_t)DECIMATE_MIN_TRIANGLES, (size_t)(triangleCount*DECIMATE_RATIO));
+		float maxError=DECIMATE_MAX_ERROR*radius*radius*radius*radius;
+		bool adjacency=!mesh.adjacency.Empty();
+		bool tree=mesh.tree!=nullptr;
+		PendingDecimation pendingDecimation;
+		pendingDecimation.shape=shape;
+		vector<Vertex> scratch;
+		const Vertex* vertices=mesh.LocalVertices(scratch);
+		pendingDecimation.mesh=make_shared<Mesh>(vector<Vertex>(vertices, vertices+mesh.vertexCount), mesh.indices, mesh.textures, false);
+		pendingDecimation.mesh->origin=mesh.origin;
+		pendingDecimation.mesh->axes=mesh.axes;
+		pendingDecimation.mesh->modelFraction=mesh.modelFraction;
+		pendingDecimation.mesh->attributes=mesh.attributes;
+		//The simplified mesh still covers the piece, so it keeps its baked splits.
+		pendingDecimation.mesh->fracture=mesh.fracture;
+		pendingDecimation.mesh->fractureNode=mesh.fractureNode;
+		shared_ptr<Mesh> simplified=pendingDecimation.mesh;
+		CutWorkspace* workspaces=cutWorkspaces.get();
+		pendingDecimation.done=threadPool->Submit([simplified, targetTriangles, maxError, adjacency, tree, workspaces]()
+		{
+			MeshDecimator & decimator=workspaces[ThreadPool::GetCurrentWorker()].decimator;
+			simplified->Decimate(decimator, targetTriangles, maxError);
+			if(adjacency)
+				simplified->BuildAdjacency();
+			if(tree)
+				simplified->BuildTree();
+		});
+		pendingDecimations.push_back(std::move(pendingDecimation));
+	}
+	//Swaps in the simplified meshes of the completed decimations. A mesh with a cut job is left alone until the job is over,
+	//since the job reads its geometry in place; if the cut is committed, the mesh is replaced and its decimation dropped.
+	void CommitDecimations()
+	{
+		for(unsigned int i=0;i<pendingDecimations.size();)
+		{
+			PendingDecimation & pendingDecimation=pendingDecimations[i];
+			const btCollisionShape* shape=pendingDecimation.shape;
+			if(pendingDecimation.done.wait_for(chrono::seconds(0))!=future_status::ready ||
+				FindJob(pendingCuts, shape)>=0 || FindJob(speculativeCuts, shape)>=0 || FindJob(retiredCuts, shape)>=0)
+			{
+				i++;
+				continue;
+			}
+			pendingDecimation.done.get();
+			int meshIndex=engine.GetCollisionShapeIndex(shape);
+			if(meshIndex>=0)
+			{
+				Mesh & mesh=cuttableMeshes[meshIndex];
+				mesh.Delete();
+				mesh=std::move(*pendingDecimation.mesh);
+				mesh.Upload();
+			}
+			pendingDecimations.erase(pendingDecimations.begin()+i);
+		}
+	}
+	//Replaces the cut mesh with its two pieces, both in the meshes vector and in the physics simulation.
+	//The pieces are placed according to the current transform of the mesh, which in async mode may have moved since the cut was submitted;
+	//the geometry does not depend on it, since it is computed in object space.
+	void CommitMeshCut(MeshCut & cut)
+	{
+		int meshIndex=engine.GetCollisionShapeIndex(cut.shape);
+		if(meshIndex<0)
+			return;
+		if(!cut.slabPlanes.empty())
+		{
+			CommitMeshSlice(cut, meshIndex);
+			return;
+		}
+		//The swipe has crossed the convex hull, but not the mesh.
+		if(cut.result.grazed || cut.result.positive.indices.empty() || cut.result.negative.indices.empty())
+		{
+			grazes++;
+			return;
+		}
+		btConvexHullShape* positiveConvexHullShape;
+		btConvexHullShape* negativeConvexHullShape;
+		glm::vec4 positiveMeshPositionWS;
+		glm::vec4 negativeMeshPositionWS;
+		Mesh positiveMesh;
+		Mesh negativeMesh;
+		float positiveWeightFactor;
+		float negativeWeightFactor;
+		glm::vec3 positiveInertia;
+		glm::vec3 negativeInertia;
+		cuttableMeshes[meshIndex].CommitCut(cut.result,
+											positiveMesh,
+											negativeMesh,
+											positiveMeshPositionWS, 
+											negativeMeshPositionWS, 
+											engine.GetObjectModelMatrix(meshIndex), 
+											positiveConvexHullShape, 
+											negativeConvexHullShape, 
+											positiveWeightFactor, 
+											negativeWeightFactor,
+											positiveInertia,
+											negativeInertia);
+		ReplaceMesh(cut, meshIndex, positiveMesh, positiveMeshPositionWS, positiveConvexHullShape, positiveWeightFactor, positiveInertia, negativeMesh, negativeMeshPositionWS, negativeConvexHullShape, negativeWeightFactor, negativeInertia);
+	}
+	//Replaces the sliced mesh with its slabs, as CommitMeshCut does with the two pieces of a cut; a slice leaving a single slab
+	//has grazed the mesh.
+	void CommitMeshSlice(MeshCut & cut, int meshIndex)
+	{
+		if(cut.slice.cells.size()<2)
+		{
+			grazes++;
+			return;
+		}
+		vector<Mesh> meshes;
+		vector<glm::vec4> meshPositionsWS;
+		vector<btConvexHullShape*> convexHullShapes;
+		vector<float> weightFactors;
+		vector<glm::vec3> inertias;
+		cuttableMeshes[meshIndex].CommitSlice(cut.slice, meshes, meshPositionsWS, engine.GetObjectModelMatrix(meshIndex), convexHullShapes, weightFactors, inertias);
+		vector<glm::mat3> rotations(meshes.size());
+		for(unsigned int i=0;i<meshes.size();i++)
+			rotations[i]=glm::transpose(cuttableMeshes[meshIndex].axes)*meshes[i].axes;
+		WaitForMeshJobs(cut.shape);
+		engine.SliceShapeWithImpulse(meshIndex, meshPositionsWS, convexHullShapes, weightFactors, inertias, rotations);
+		cuttableMeshes[meshIndex].Delete();
+		iter_swap(cuttableMeshes.begin()+meshIndex, cuttableMeshes.end()-1);
+		cuttableMeshes.pop_back();
+		for(unsigned int i=0;i<meshes.size();i++)
+			cuttableMeshes.push_back(std::move(meshes[i]));
+		for(unsigned int i=0;i<convexHullShapes.size();i++)
+			StartDecimation(convexHullShapes[i], meshPositionsWS[i]);
+	}
+	//Replaces the mesh with the pieces of the baked split matching the cut: they are placed according to the current transform of
+	//the mesh, with the hulls and mass properties computed when the fracture was baked.
+	void CommitBakedCut(const MeshCut & cut)
+	{
+		int meshIndex=engine.GetCollisionShapeIndex(cut.shape);
+		if(meshIndex<0)
+			return;
+		const Mesh & mesh=cuttableMeshes[meshIndex];
+		shared_ptr<FractureHierarchy> fracture=mesh.fracture;
+		const FractureSplit & split=fracture->nodes[mesh.fractureNode].splits[cut.bakedSplit];
+		//The positive piece is the one on the positive side of the swipe.
+		int nodes[2]={split.positive, split.negative};
+		if(cut.bakedFlip)
+			swap(nodes[0], nodes[1]);
+		glm::mat4 model=mesh.VertexModel(engine.GetObjectModelMatrix(meshIndex));
+		Mesh meshes[2];
+		glm::vec4 positionsWS[2];
+		btConvexHullShape* shapes[2];
+		for(int s=0;s<2;s++)
+		{
+			const FractureNode & node=fracture->nodes[nodes[s]];
+			meshes[s]=FractureHierarchy::Piece(fracture, nodes[s], mesh.textures);
+			meshes[s].modelFraction=mesh.modelFraction*node.weightFactor;
+			positionsWS[s]=model*glm::vec4(node.centroid, 1.0f);
+			shapes[s]=HullClipper::CreateShape(node.hullPoints);
+		}
+		const FractureNode & positive=fracture->nodes[nodes[0]];
+		const FractureNode & negative=fracture->nodes[nodes[1]];
+		ReplaceMesh(cut, meshIndex, meshes[0], positionsWS[0], shapes[0], positive.weightFactor, positive.inertia, meshes[1], positionsWS[1], shapes[1], negative.weightFactor, negative.inertia);
+	}
+	//Replaces the cut mesh with its two pieces, in the meshes vector and in the physics simulation, which takes the shapes.
+	//The bodies of the pieces are turned from the one of the mesh to their principal axes (see Mesh::axes).
+	void ReplaceMesh(const MeshCut & cut, int meshIndex, Mesh & positiveMesh, glm::vec4 positiveMeshPositionWS, btConvexHullShape* positiveConvexHullShape, float positiveWeightFactor, glm::vec3 positiveInertia, Mesh & negativeMesh, glm::vec4 negativeMeshPositionWS, btConvexHullShape* negativeConvexHullShape, float negativeWeightFactor, glm::vec3 negativeInertia)
+	{
+		glm::mat3 toParent=glm::transpose(cuttableMeshes[meshIndex].axes);
+		WaitForMeshJobs(cut.shape);
+		engine.CutShapeWithImpulse(cut.cutNormal, meshIndex, negativeWeightFactor, negativeMeshPositionWS, negativeConvexHullShape, negativeInertia, toParent*negativeMesh.axes, positiveWeightFactor, positiveMeshPositionWS, positiveConvexHullShape, positiveInertia, toParent*positiveMesh.axes);
+		//Delete the old mesh
+		cuttableMeshes[meshIndex].Delete();
+		iter_swap(cuttableMeshes.begin()+meshIndex, cuttableMeshes.end()-1);
+		cuttableMeshes.pop_back();
+		cuttableMeshes.push_back(std::move(positiveMesh));
+		cuttableMeshes.push_back(std::move(negativeMesh));
+		StartDecimation(positiveConvexHullShape, positiveMeshPositionWS);
+		StartDecimation(negativeConvexHullShape, negativeMeshPositionWS);
+	}
 };
@@ -0,0 +1,1003 @@
+/*
+MeshSlicer class:
+This class cuts a mesh by several planes at once: the planes divide the space in cells, each one identified by the mask of the
+planes having it in their positive half space, and a mesh is produced for each cell that contains part of the cut mesh.
+Each triangle is visited once: if its vertices lie in the same cell it is copied, otherwise it is clipped by the planes that cross
+it, and each convex piece goes to its cell. The section of each plane is chained into loops and triangulated as in MeshCutter;
+each triangle of the section is then clipped by the other planes in the same way. The edges of the section triangles lying on the
+segments of the loops are the chords of the surface triangles, so the caps share their points with the surface, and the diagonals
+inside the section are shared by the two section triangles on them.
+Every point generated by the clipping is identified by how it was built (the line it lies on and the plane that crossed it),
+so the pieces sharing it find it already computed; for example, the point on an edge of the mesh is computed once for all the
+triangles and cells using it.
+Cells can be merged in groups, producing a mesh for each group: the sections between cells of the same group are not generated.
+This is how a mesh is cut along a polyline (CutPolyline): the cells are grouped by their side of the polyline.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <glm/glm.hpp>
+#include <utils/log.h>
+#include <utils/vertex.h>
+#include <utils/classify.h>
+#include <utils/cut.h>
+#include <utils/hull.h>
+#include <utils/arena.h>
+#include <utils/triangulate.h>
+
+//Cells are identified by a mask of bits, one for each plane.
+#define SLICE_MAX_PLANES 32
+//A triangle clipped by all planes has at most a vertex more for each plane.
+#define SLICE_MAX_POLYGON (3+SLICE_MAX_PLANES)
+
+//Identifier of a point generated by the slice; cap is 0 for the point on the surface, p+1 for its copy on the section of plane p.
+struct SliceKey
+{
+	unsigned int type;
+	unsigned int x, y, z;
+	unsigned int cap;
+
+	bool operator==(const SliceKey & other) const
+	{
+		return type==other.type && x==other.x && y==other.y && z==other.z && cap==other.cap;
+	}
+};
+
+namespace std
+{
+	template<>
+	struct hash<SliceKey>
+	{
+		size_t operator()(const SliceKey & key) const
+		{
+			size_t seed=key.type;
+			seed^=std::hash<unsigned int>{}(key.x)+0x9e3779b9+(seed<<6)+(seed>>2);
+			seed^=std::hash<unsigned int>{}(key.y)+0x9e3779b9+(seed<<6)+(seed>>2);
+			seed^=std::hash<unsigned int>{}(key.z)+0x9e3779b9+(seed<<6)+(seed>>2);
+			seed^=std::hash<unsigned int>{}(key.cap)+0x9e3779b9+(seed<<6)+(seed>>2);
+			return seed;
+		}
+	};
+}
+
+//The mesh of one of the cells produced by a slice; mask is the group of the cell, when cells are grouped.
+struct SliceCell
+{
+	unsigned int mask;
+	CutSide side;
+};
+
+//Gives the group of the cell with the given mask; point is a point of the mesh inside the cell.
+typedef function<unsigned int(unsigned int mask, glm::vec3 point)> CellGrouping;
+
+//A cut along a polyline, in object space. Each segment cuts on its own plane, which holds the end of the segment;
+//joined tells, for each segment, whether the next one starts where it ends.
+//Distances from the segments are measured on the xy plane, the one the cutting planes are perpendicular to.
+struct CutPolyline
+{
+	vector<CutPlane> planes;
+	vector<glm::vec3> starts;
+	vector<bool> joined;
+
+	//The side of a point is its side with respect to the plane of the closest segment. When the closest point is the joint
+	//between two segments, the sum of their normals is used: this way the polyline divides the space in two parts exactly.
+	bool PositiveSide(glm::vec3 point) const
+	{
+		float closestDistance=-1.0f;
+		glm::vec3 normal(0.0f);
+		glm::vec3 closestPoint(0.0f);
+		glm::vec2 position(point);
+		for(unsigned int i=0;i<planes.size();i++)
+		{
+			glm::vec2 start(starts[i]);
+			glm::vec2 segment=glm::vec2(planes[i].point)-start;
+			float segmentLength=glm::dot(segment, segment);
+			float t=segmentLength>0.0f? glm::clamp(glm::dot(position-start, segment)/segmentLength, 0.0f, 1.0f) : 0.0f;
+			glm::vec2 difference=position-(start+segment*t);
+			float distance=glm::dot(difference, difference);
+			if(closestDistance>=0.0f && distance>=closestDistance)
+				continue;
+			closestDistance=distance;
+			normal=planes[i].normal;
+			closestPoint=t==0.0f? starts[i] : planes[i].point;
+			if(t==0.0f && i>0 && joined[i-1])
+				normal+=planes[i-1].normal;
+			else if(t==1.0f && i+1<planes.size() && joined[i])
+				normal+=planes[i+1].normal;
+		}
+		return glm::dot(normal, point-closestPoint)>0.0f;
+	}
+};
+
+struct SliceResult
+{
+	vector<SliceCell> cells;
+};
+
+class MeshSlicer
+{
+public:
+	//Points are built in these ways; x, y and z hold:
+	enum PointType
+	{
+		POINT_VERTEX=0,		//the index of a vertex of the mesh
+		POINT_EDGE=1,		//the indices of the vertices of an edge (lower first) and the plane crossing it
+		POINT_INTERIOR=2,	//a triangle and the two planes crossing inside it (lower first)
+		POINT_DIAGONAL=3,	//the points of a diagonal of a section (lower first), then its plane and the one crossing it, in 16 bits each
+		POINT_CORNER=4		//the three planes meeting in the point, in increasing order
+	};
+	//Each edge of a polygon lies on one of these lines:
+	enum LineType
+	{
+		LINE_EDGE=0,		//an edge of the mesh (x, y)
+		LINE_CHORD=1,		//the intersection between the triangle x and the plane y
+		LINE_DIAGONAL=2,	//the diagonal of the section of plane z between the points x and y, inside the section
+		LINE_WALL=3			//the intersection between the section of plane x and the plane y
+	};
+
+	MeshSlicer(): hull(nullptr), hullOrigin(0.0f), hullAxes(1.0f), twins(nullptr), tree(nullptr), attributes(VERTEX_ALL_ATTRIBUTES) {}
+
+	//As in MeshCutter, with the convex hull of the sliced mesh the hulls of the cells are obtained by clipping it.
+	void SetHull(const btConvexHullShape* hull, glm::vec3 origin=glm::vec3(0.0f), glm::mat3 axes=glm::mat3(1.0f))
+	{
+		this->hull=hull;
+		hullOrigin=origin;
+		hullAxes=axes;
+	}
+	//If the sliced mesh has adjacency, the cells get theirs too; the slicer doesn't walk the mesh, so it is built again from
+	//the triangles of each cell.
+	void SetAdjacency(const int* twins)
+	{
+		this->twins=twins;
+	}
+	//Likewise, the slicer doesn't descend the tree of the sliced mesh, but if there is one the large cells get theirs.
+	void SetTree(const TriangleTree* tree)
+	{
+		this->tree=tree;
+	}
+	//As in MeshCutter, the new vertices of the cells get only the attributes of the sliced mesh.
+	void SetAttributes(unsigned int attributes)
+	{
+		this->attributes=attributes;
+	}
+
+	//Cuts the given mesh by all planes, storing the mesh of each non empty cell inside result.
+	//As in MeshCutter, the vertices of each cell stay in the frame of the sliced mesh, and its convex hull points are computed.
+	//If grouping is given, a mesh is produced for each group of cells instead.
+	//The masks hold at most SLICE_MAX_PLANES planes: with more, the mesh is not sliced and result has no cells, since the cells
+	//would ignore the planes past the limit while the grouping still sees them.
+	void Slice(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, const vector<CutPlane> & planes, SliceResult & result, const CellGrouping* grouping=nullptr)
+	{
+		result.cells.clear();
+		if(planes.size()>SLICE_MAX_PLANES)
+			return;
+		this->vertices=vertices;
+		this->vertexCount=vertexCount;
+		this->indices=indices;
+		this->planes=&planes;
+		this->grouping=grouping;
+		planeCount=planes.size();
+		cells=&result.cells;
+		arena.Reset();
+		cellIndices.Reset(&arena, SLICE_MAX_PLANES);
+		groupIndices.Reset(&arena, SLICE_MAX_PLANES);
+		cellVertexMaps.clear();
+		cellIntegrals.clear();
+		points.clear();
+		pointIndices.Reset(&arena, vertexCount);
+
+		Log log=Log();
+		log.InitLog("Slice");
+		distances=arena.Allocate<float>(planeCount*vertexCount);
+		masks=arena.Allocate<unsigned int>(vertexCount);
+		fill(masks, masks+vertexCount, 0u);
+		for(unsigned int p=0;p<planeCount;p++)
+		{
+			float* planeDistances=distances+p*vertexCount;
+			PlaneClassifier::SignedDistances(vertices, vertexCount, planes[p].normal, planes[p].point, planeDistances);
+			for(size_t v=0;v<vertexCount;v++)
+				if(planeDistances[v]>0.f)
+					masks[v]|=1u<<p;
+		}
+
+		//Surface: each triangle is copied to its cell, or clipped by the planes crossing it.
+		for(unsigned int p=0;p<planeCount;p++)
+			sections[p].clear();
+		size_t triangleCount=indexCount/3;
+		for(size_t t=0;t<triangleCount;t++)
+		{
+			unsigned int a=indices[3*t];
+			unsigned int b=indices[3*t+1];
+			unsigned int c=indices[3*t+2];
+			unsigned int allPositive=masks[a] & masks[b] & masks[c];
+			unsigned int crossing=(masks[a] | masks[b] | masks[c]) & ~allPositive;
+			polygon.count=0;
+			polygon.Add(PolygonVertex(VertexPoint(a), Line(LINE_EDGE, a, b, 0)));
+			polygon.Add(PolygonVertex(VertexPoint(b), Line(LINE_EDGE, b, c, 0)));
+			polygon.Add(PolygonVertex(VertexPoint(c), Line(LINE_EDGE, c, a, 0)));
+			if(crossing==0)
+			{
+				AddPolygon(GetCell(allPositive, polygon), allPositive, polygon);
+				continue;
+			}
+			for(unsigned int p=0;p<planeCount;p++)
+				if(crossing & (1u<<p))
+					sections[p].push_back(t);
+			ClipPolygon(allPositive, crossing, (unsigned int)t, -1);
+		}
+
+		//Sections: the triangles of the section of each plane are clipped by all the other planes, and each piece closes the cells
+		//on both sides. Pieces next to a cell without surface triangles (one bounded by planes alone) are dropped, since the cell
+		//has no mesh to close.
+		//Where the sections of two planes meet, each one is split at the points where its own diagonals cross the other plane: the
+		//pieces are added once all sections are clipped, with the points of both sections on their common edges (see AddCapPieces).
+		capPieces.clear();
+		wallPoints.clear();
+		for(unsigned int p=0;p<planeCount;p++)
+		{
+			if(sections[p].empty())
+				continue;
+			TriangulateSection(p);
+			unsigned int otherPlanes=(planeCount==32? 0xFFFFFFFFu : (1u<<planeCount)-1) & ~(1u<<p);
+			for(size_t i=0;i<capTriangles.size();i+=3)
+			{
+				polygon.count=0;
+				for(int corner=0;corner<3;corner++)
+				{
+					unsigned int source=capTriangles[i+corner];
+					unsigned int target=capTriangles[i+(corner+1)%3];
+					polygon.Add(PolygonVertex(loopPointIndices[source], CapLine(source, target, p)));
+				}
+				ClipPolygon(0, otherPlanes, p, (int)p);
+			}
+		}
+		AddCapPieces();
+
+		log.EndLog();
+
+		if(hull)
+			ClipHulls();
+		for(unsigned int i=0;i<cells->size();i++)
+		{
+			CutSide & side=(*cells)[i].side;
+			if(side.area>0.0f)
+				side.centroid/=side.area;
+			MeshCutter::ApplyVolumeIntegrals(side, cellIntegrals[i], VolumeApex());
+			MeshCutter::CollectHullPoints(side, hullClipper);
+			if(twins)
+				side.adjacency.Build(side.vertices.data(), side.vertices.size(), side.indices.data(), side.indices.size());
+			//The cells are created anew by each slice, so there is no tree to rebuild in place.
+			shared_ptr<TriangleTree> spare;
+			if(tree)
+				MeshCutter::BuildTree(side, spare);
+		}
+	}
+	//Planes parallel to the given one, spaced by spacing and centred on its point: they cut a mesh in count+1 slabs.
+	static vector<CutPlane> SlabPlanes(const CutPlane & plane, float spacing, unsigned int count)
+	{
+		vector<CutPlane> slabPlanes(count);
+		for(unsigned int i=0;i<count;i++)
+		{
+			slabPlanes[i].normal=plane.normal;
+			slabPlanes[i].point=plane.point+plane.normal*(spacing*((float)i-(count-1)*0.5f));
+		}
+		return slabPlanes;
+	}
+	//Cuts the given mesh along the polyline, storing the two sides inside result as MeshCutter does; a side is empty, and the
+	//result grazed, if the polyline doesn't divide the mesh, or if it has more than SLICE_MAX_PLANES segments (see Slice).
+	void Cut(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, const CutPolyline & polyline, CutResult & result)
+	{
+		CellGrouping sides=[&polyline](unsigned int, glm::vec3 point) { return polyline.PositiveSide(point)? 0u : 1u; };
+		SliceResult slice;
+		Slice(vertices, vertexCount, indices, indexCount, polyline.planes, slice, &sides);
+		result.positive=CutSide();
+		result.negative=CutSide();
+		for(unsigned int i=0;i<slice.cells.size();i++)
+			(slice.cells[i].mask==0? result.positive : result.negative)=std::move(slice.cells[i].side);
+		result.grazed=result.positive.indices.empty() || result.negative.indices.empty();
+	}
+
+private:
+	struct SliceLine
+	{
+		unsigned int type;
+		unsigned int x, y, z;
+	};
+	//A point generated by the slice; the vertices of the mesh it lies between (if any) decide its side
+	//with respect to the planes not crossing them, so that it always agrees with its neighbours.
+	struct SlicePoint
+	{
+		SliceKey key;
+		Vertex vertex;
+		unsigned int support[3];
+		int supportCount;
+	};
+	struct WallPoint
+	{
+		unsigned int wall;
+		float position;
+		int point;
+
+		bool operator<(const WallPoint & other) const
+		{
+			if(wall!=other.wall)
+				return wall<other.wall;
+			if(position!=other.position)
+				return position<other.position;
+			return point<other.point;
+		}
+		bool operator==(const WallPoint & other) const
+		{
+			return wall==other.wall && point==other.point;
+		}
+	};
+	//A point of the section being triangulated: the segments leaving it and reaching it (-1 if there is none), and the triangle
+	//of the one leaving it.
+	struct SectionLink
+	{
+		int next;
+		int previous;
+		unsigned int triangle;
+		bool chained;
+
+		SectionLink(): next(-1), previous(-1), triangle(0), chained(false) {}
+	};
+	//Vertex of a clipped polygon, together with the line of the edge leading to the next vertex.
+	struct PolygonVertex
+	{
+		int point;
+		SliceLine line;
+
+		PolygonVertex() {}
+		PolygonVertex(int point, SliceLine line): point(point), line(line) {}
+	};
+	//A convex polygon being clipped, with the mask of its cell: each plane adds at most a vertex to it, so its vertices fit
+	//in a fixed array.
+	struct Polygon
+	{
+		PolygonVertex vertices[SLICE_MAX_POLYGON];
+		unsigned int count;
+		unsigned int mask;
+
+		Polygon(): count(0), mask(0) {}
+		void Add(const PolygonVertex & vertex)
+		{
+			vertices[count++]=vertex;
+		}
+	};
+	//A section piece waiting to be added to the cells on its two sides (see AddCapPieces).
+	struct CapPiece
+	{
+		Polygon polygon;
+		unsigned int section;
+		unsigned int positiveCell;
+		unsigned int negativeCell;
+	};
+
+	const Vertex* vertices;
+	size_t vertexCount;
+	const unsigned int* indices;
+	const vector<CutPlane>* planes;
+	const CellGrouping* grouping;
+	unsigned int planeCount;
+	//Signed distance of each vertex from each plane, plane by plane.
+	float* distances;
+	//For each vertex, the planes having it in their positive half space.
+	unsigned int* masks;
+	Arena arena;
+	const btConvexHullShape* hull;
+	glm::vec3 hullOrigin;
+	glm::mat3 hullAxes;
+	const int* twins;
+	const TriangleTree* tree;
+	unsigned int attributes;
+	HullClipper hullClipper;
+	vector<glm::vec3> parentHullPoints;
+	vector<glm::vec3> cellPoints;
+	vector<unsigned int> cellCounts;
+	//Triangles crossed by each plane.
+	vector<unsigned int> sections[SLICE_MAX_PLANES];
+	vector<SlicePoint> points;
+	ArenaHashMap<SliceKey, int> pointIndices;
+	vector<SliceCell>* cells;
+	//Index of the produced mesh of each cell with surface triangles, and of each group.
+	ArenaHashMap<unsigned int, unsigned int> cellIndices;
+	ArenaHashMap<unsigned int, unsigned int> groupIndices;
+	//For each produced mesh, the index of each of its points.
+	vector<ArenaHashMap<SliceKey, unsigned int>> cellVertexMaps;
+	//For each produced mesh, the integrals of its volume: its sections lie on different planes, so all its triangles contribute.
+	vector<VolumeIntegrals> cellIntegrals;
+	Polygon polygon;
+	vector<Polygon> pieces;
+	vector<Polygon> nextPieces;
+	//The segments of the section being triangulated, by their points; seams are crossed by the positions of the chain ends.
+	ArenaHashMap<int, SectionLink> sectionLinks;
+	ArenaHashMap<glm::vec3, int> chainStarts;
+	ArenaHashMap<glm::vec3, int> chainEnds;
+	//Loops of the section: loop l is made of the points loopPointIndices[loopStarts[l]] to loopPointIndices[loopStarts[l+1]-1],
+	//projected on the plane in loopPoints. For each of them, loopNext is the next one if a segment joins them (UINT_MAX if the
+	//edge closes an open chain) and loopTriangles the triangle of that segment (-1 if there is none).
+	vector<int> loopPointIndices;
+	vector<unsigned int> loopStarts;
+	vector<glm::vec2> loopPoints;
+	vector<unsigned int> loopNext;
+	vector<int> loopTriangles;
+	//Triangles of the section, as indices of loopPointIndices; they are wound the same way, around the normal of plane p if
+	//capFacesNormal[p] (u, v and the normal are a right-handed frame), the opposite way otherwise.
+	vector<unsigned int> capTriangles;
+	bool capFacesNormal[SLICE_MAX_PLANES];
+	vector<CapPiece> capPieces;
+	vector<WallPoint> wallPoints;
+	//Points of the section piece being added, with the points of the walls on its edges.
+	vector<int> capPoints;
+	vector<unsigned int> polygonIndices;
+	PolygonTriangulator triangulator;
+
+	static SliceKey Key(unsigned int type, unsigned int x, unsigned int y, unsigned int z)
+	{
+		SliceKey key;
+		key.type=type;
+		key.x=x;
+		key.y=y;
+		key.z=z;
+		key.cap=0;
+		return key;
+	}
+	static SliceLine Line(unsigned int type, unsigned int x, unsigned int y, unsigned int z)
+	{
+		SliceLine line;
+		line.type=type;
+		line.x=x;
+		line.y=y;
+		line.z=z;
+		return line;
+	}
+	float Distance(unsigned int p, unsigned int v)
+	{
+		return distances[p*vertexCount+v];
+	}
+	float Distance(unsigned int p, glm::vec3 position)
+	{
+		const CutPlane & plane=(*planes)[p];
+		return ((plane.normal.x*position.x+plane.normal.y*position.y)+plane.normal.z*position.z)-glm::dot(plane.normal, plane.point);
+	}
+	//Returns the index of the point with the given key, adding it if it is new; isNew tells whether it must still be computed.
+	int FindPoint(const SliceKey & key, bool & isNew)
+	{
+		int & pointIndex=pointIndices.Insert(key, isNew);
+		if(!isNew)
+			return pointIndex;
+		int index=points.size();
+		pointIndex=index;
+		points.push_back(SlicePoint());
+		points[index].key=key;
+		points[index].supportCount=0;
+		return index;
+	}
+	int VertexPoint(unsigned int v)
+	{
+		bool isNew;
+		int index=FindPoint(Key(POINT_VERTEX, v, 0, 0), isNew);
+		if(isNew)
+		{
+			points[index].vertex=vertices[v];
+			points[index].support[0]=v;
+			points[index].supportCount=1;
+		}
+		return index;
+	}
+	//The point of the edge (a, b) on plane p is interpolated from the vertex with the lower index, as in MeshCutter.
+	int EdgePoint(unsigned int a, unsigned int b, unsigned int p)
+	{
+		if(a>b)
+			swap(a, b);
+		bool isNew;
+		int index=FindPoint(Key(POINT_EDGE, a, b, p), isNew);
+		if(isNew)
+		{
+			float intFactor=Distance(p, a)/(Distance(p, a)-Distance(p, b));
+			points[index].vertex=Vertex::Interpolate(vertices[a], vertices[b], intFactor, attributes);
+			points[index].support[0]=a;
+			points[index].support[1]=b;
+			points[index].supportCount=2;
+		}
+		return index;
+	}
+	//The two edges of triangle t crossed by plane p.
+	void SectionEdges(unsigned int t, unsigned int p, unsigned int* first, unsigned int* second)
+	{
+		int found=0;
+		for(int e=0;e<3;e++)
+		{
+			unsigned int a=indices[3*t+e];
+			unsigned int b=indices[3*t+(e+1)%3];
+			if(((masks[a]>>p) & 1)!=((masks[b]>>p) & 1))
+			{
+				unsigned int* edge=found==0? first : second;
+				edge[0]=a;
+				edge[1]=b;
+				found++;
+			}
+		}
+	}
+	//The segment of the section of plane p inside triangle t, between the points on the two edges crossed by the plane. It is
+	//oriented as in MeshCutter, so that all the loops of the section are wound the same way: if the first crossed edge, in the
+	//winding of the triangle, leaves the positive side, the segment goes from the second edge to the first.
+	void SectionSegment(unsigned int t, unsigned int p, int & start, int & end)
+	{
+		unsigned int first[2], second[2];
+		SectionEdges(t, p, first, second);
+		int firstPoint=EdgePoint(first[0], first[1], p);
+		int secondPoint=EdgePoint(second[0], second[1], p);
+		bool firstLeavesPositive=((masks[first[0]]>>p) & 1)!=0;
+		start=firstLeavesPositive? secondPoint : firstPoint;
+		end=firstLeavesPositive? firstPoint : secondPoint;
+	}
+	//The point following the given one along the section, across seams as in MeshCutter; -1 at the end of an open chain.
+	int NextSectionPoint(int point)
+	{
+		int next=sectionLinks.Find(point)->next;
+		if(next<0 || sectionLinks.Find(next)->next>=0)
+			return next;
+		int* joined=chainStarts.Find(points[next].vertex.Position);
+		return joined && *joined!=next? *joined : next;
+	}
+	//The point preceding the given one along the section, across seams; -1 at the start of an open chain.
+	int PreviousSectionPoint(int point)
+	{
+		int previous=sectionLinks.Find(point)->previous;
+		if(previous>=0)
+			return previous;
+		int* joined=chainEnds.Find(points[point].vertex.Position);
+		return joined && *joined!=point? sectionLinks.Find(*joined)->previous : -1;
+	}
+	//Chains the segments of the section of plane p into loops and triangulates them, as MeshCutter::TriangulateSection does;
+	//the triangles are stored in capTriangles, as indices of loopPointIndices.
+	void TriangulateSection(unsigned int p)
+	{
+		sectionLinks.Reset(&arena, 2*sections[p].size());
+		chainStarts.Reset(&arena, 16);
+		chainEnds.Reset(&arena, 16);
+		for(size_t s=0;s<sections[p].size();s++)
+		{
+			int start, end;
+			SectionSegment(sections[p][s], p, start, end);
+			bool isNew;
+			SectionLink & startLink=sectionLinks.Insert(start, isNew);
+			if(isNew)
+				startLink=SectionLink();
+			startLink.next=end;
+			startLink.triangle=sections[p][s];
+			SectionLink & endLink=sectionLinks.Insert(end, isNew);
+			if(isNew)
+				endLink=SectionLink();
+			endLink.previous=start;
+		}
+		sectionLinks.ForEach([this](int point, SectionLink & link)
+		{
+			bool isNew;
+			if(link.previous<0)
+				chainStarts.Insert(points[point].vertex.Position, isNew)=point;
+			if(link.next<0)
+				chainEnds.Insert(points[point].vertex.Position, isNew)=point;
+		});
+
+		const CutPlane & plane=(*planes)[p];
+		glm::vec3 u=glm::normalize(glm::cross(plane.normal, fabs(plane.normal.x)<0.9f? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f)));
+		glm::vec3 v=glm::cross(plane.normal, u);
+		loopPointIndices.clear();
+		loopStarts.assign(1, 0);
+		loopPoints.clear();
+		loopNext.clear();
+		loopTriangles.clear();
+		capTriangles.clear();
+		for(size_t s=0;s<sections[p].size();s++)
+		{
+			int segmentStart, segmentEnd;
+			SectionSegment(sections[p][s], p, segmentStart, segmentEnd);
+			if(sectionLinks.Find(segmentStart)->chained)
+				continue;
+			int start=segmentStart;
+			for(size_t steps=0;steps<sectionLinks.Size();steps++)
+			{
+				int previous=PreviousSectionPoint(start);
+				if(previous<0 || previous==segmentStart || sectionLinks.Find(previous)->chained)
+					break;
+				start=previous;
+			}
+			unsigned int first=loopPointIndices.size();
+			int point=start;
+			while(true)
+			{
+				SectionLink & link=*sectionLinks.Find(point);
+				link.chained=true;
+				glm::vec3 position=points[point].vertex.Position-plane.point;
+				loopPointIndices.push_back(point);
+				loopPoints.push_back(glm::vec2(glm::dot(position, u), glm::dot(position, v)));
+				loopTriangles.push_back(link.next>=0? (int)link.triangle : -1);
+				int next=NextSectionPoint(point);
+				bool closed=next==start;
+				if(next<0 || sectionLinks.Find(next)->chained)
+				{
+					//A chain that doesn't close is closed by the edge between its ends, which lies on no segment.
+					loopNext.push_back(closed? first : UINT_MAX);
+					if(!closed)
+						loopTriangles.back()=-1;
+					break;
+				}
+				loopNext.push_back(loopPointIndices.size());
+				point=next;
+			}
+			if(loopPointIndices.size()-first<3)
+			{
+				loopPointIndices.resize(first);
+				loopPoints.resize(first);
+				loopNext.resize(first);
+				loopTriangles.resize(first);
+			}
+			else
+				loopStarts.push_back(loopPointIndices.size());
+		}
+		triangulator.Triangulate(loopPoints, loopStarts, capTriangles);
+		float area=0.0f;
+		for(size_t i=0;i<capTriangles.size();i+=3)
+		{
+			glm::vec2 a=loopPoints[capTriangles[i]];
+			glm::vec2 b=loopPoints[capTriangles[i+1]];
+			glm::vec2 c=loopPoints[capTriangles[i+2]];
+			area+=(b.x-a.x)*(c.y-a.y)-(b.y-a.y)*(c.x-a.x);
+		}
+		capFacesNormal[p]=area>=0.0f;
+	}
+	//The line of the edge of a section triangle of plane p, between the given vertices of the loops: the chord of the surface
+	//triangle of the segment, if the edge lies on one, a diagonal of the section otherwise.
+	SliceLine CapLine(unsigned int source, unsigned int target, unsigned int p)
+	{
+		if(loopNext[source]==target && loopTriangles[source]>=0)
+			return Line(LINE_CHORD, loopTriangles[source], p, 0);
+		if(loopNext[target]==source && loopTriangles[target]>=0)
+			return Line(LINE_CHORD, loopTriangles[target], p, 0);
+		int a=loopPointIndices[source];
+		int b=loopPointIndices[target];
+		return Line(LINE_DIAGONAL, min(a, b), max(a, b), p);
+	}
+	//The side of a point with respect to plane p. If all the vertices of the mesh around the point are on the same side,
+	//the point is on that side too; otherwise its distance is computed.
+	bool PositiveSide(int point, unsigned int p)
+	{
+		const SlicePoint & slicePoint=points[point];
+		if(slicePoint.supportCount>0)
+		{
+			unsigned int bit=1u<<p;
+			unsigned int side=masks[slicePoint.support[0]] & bit;
+			bool agree=true;
+			for(int i=1;i<slicePoint.supportCount;i++)
+				agree=agree && (masks[slicePoint.support[i]] & bit)==side;
+			if(agree)
+				return side!=0;
+		}
+		return Distance(p, slicePoint.vertex.Position)>0.f;
+	}
+	//The point where plane p crosses the edge of a polygon going from a to b.
+	int Intersection(const PolygonVertex & a, const PolygonVertex & b, unsigned int p)
+	{
+		const SliceLine & line=a.line;
+		if(line.type==LINE_EDGE)
+			return EdgePoint(line.x, line.y, p);
+		SliceKey key;
+		if(line.type==LINE_CHORD)
+			key=Key(POINT_INTERIOR, line.x, min(line.y, p), max(line.y, p));
+		else if(line.type==LINE_DIAGONAL)
+			key=Key(POINT_DIAGONAL, line.x, line.y, (line.z<<16) | p);
+		else
+		{
+			//The same corner is reached by the sections of all three planes.
+			unsigned int corner[3]={line.x, line.y, p};
+			sort(corner, corner+3);
+			key=Key(POINT_CORNER, corner[0], corner[1], corner[2]);
+		}
+		bool isNew;
+		int index=FindPoint(key, isNew);
+		if(isNew)
+		{
+			const Vertex & aVertex=points[a.point].vertex;
+			const Vertex & bVertex=points[b.point].vertex;
+			float aDistance=Distance(p, aVertex.Position);
+			float bDistance=Distance(p, bVertex.Position);
+			float intFactor=aDistance!=bDistance? aDistance/(aDistance-bDistance) : 0.5f;
+			intFactor=glm::clamp(intFactor, 0.0f, 1.0f);
+			points[index].vertex=Vertex::Interpolate(aVertex, bVertex, intFactor, attributes);
+			if(line.type==LINE_CHORD)
+			{
+				for(int i=0;i<3;i++)
+					points[index].support[i]=indices[3*line.x+i];
+				points[index].supportCount=3;
+			}
+		}
+		return index;
+	}
+	//Clips the polygon by the given planes; the pieces go to the cells given by their sides and by mask.
+	//context is the triangle of a surface polygon, or the plane of a section polygon (section is its plane too, -1 for the surface).
+	void ClipPolygon(unsigned int mask, unsigned int crossing, unsigned int context, int section)
+	{
+		pieces.resize(1);
+		pieces[0]=polygon;
+		pieces[0].mask=mask;
+		for(unsigned int p=0;p<planeCount;p++)
+		{
+			if(!(crossing & (1u<<p)))
+				continue;
+			nextPieces.clear();
+			for(size_t i=0;i<pieces.size();i++)
+				SplitPiece(pieces[i], p, section<0? Line(LINE_CHORD, context, p, 0) : Line(LINE_WALL, context, p, 0));
+			swap(pieces, nextPieces);
+		}
+		for(size_t i=0;i<pieces.size();i++)
+		{
+			if(section<0)
+			{
+				AddPolygon(GetCell(pieces[i].mask, pieces[i]), pieces[i].mask, pieces[i]);
+				continue;
+			}
+			unsigned int positiveMask=pieces[i].mask | (1u<<section);
+			unsigned int negativeMask=pieces[i].mask & ~(1u<<section);
+			int positiveCell=FindCell(positiveMask);
+			int negativeCell=FindCell(negativeMask);
+			if(positiveCell<0 || negativeCell<0 || positiveCell==negativeCell)
+				continue;
+			CapPiece capPiece;
+			capPiece.polygon=pieces[i];
+			capPiece.section=section;
+			capPiece.positiveCell=positiveCell;
+			capPiece.negativeCell=negativeCell;
+			capPieces.push_back(capPiece);
+			for(size_t v=0;v<pieces[i].count;v++)
+			{
+				const SliceLine & line=pieces[i].vertices[v].line;
+				if(line.type!=LINE_WALL)
+					continue;
+				AddWallPoint(line, pieces[i].vertices[v].point);
+				AddWallPoint(line, pieces[i].vertices[(v+1)%pieces[i].count].point);
+			}
+		}
+	}
+	//The points of the edges of the section pieces lying on a wall, the line where the sections of two planes meet; a wall is
+	//identified by its two planes, in 16 bits each, and its points are sorted by their position along it.
+	WallPoint MakeWallPoint(const SliceLine & line, int point)
+	{
+		unsigned int first=min(line.x, line.y);
+		unsigned int second=max(line.x, line.y);
+		WallPoint wallPoint;
+		wallPoint.wall=(first<<16) | second;
+		wallPoint.position=glm::dot(points[point].vertex.Position, glm::cross((*planes)[first].normal, (*planes)[second].normal));
+		wallPoint.point=point;
+		return wallPoint;
+	}
+	void AddWallPoint(const SliceLine & line, int point)
+	{
+		wallPoints.push_back(MakeWallPoint(line, point));
+	}
+	//Adds the section pieces to the cells on both sides. An edge of a piece lying on a wall gets all the points of the wall
+	//between its ends, so that the pieces of the two sections meeting there share their vertices. The fan of each piece starts
+	//from a corner whose edges got no points, if there is one, so that it has no degenerate triangles.
+	void AddCapPieces()
+	{
+		sort(wallPoints.begin(), wallPoints.end());
+		wallPoints.erase(unique(wallPoints.begin(), wallPoints.end()), wallPoints.end());
+		for(size_t i=0;i<capPieces.size();i++)
+		{
+			const Polygon & piece=capPieces[i].polygon;
+			unsigned int section=capPieces[i].section;
+			size_t corners[SLICE_MAX_POLYGON+1];
+			capPoints.clear();
+			for(size_t v=0;v<piece.count;v++)
+			{
+				corners[v]=capPoints.size();
+				capPoints.push_back(piece.vertices[v].point);
+				const SliceLine & line=piece.vertices[v].line;
+				if(line.type==LINE_WALL)
+					AddWallPoints(line, piece.vertices[v].point, piece.vertices[(v+1)%piece.count].point);
+			}
+			corners[piece.count]=capPoints.size();
+			size_t apex=0;
+			for(size_t v=0;v<piece.count;v++)
+			{
+				size_t previous=(v+piece.count-1)%piece.count;
+				if(corners[v+1]-corners[v]==1 && corners[previous+1]-corners[previous]==1)
+				{
+					apex=corners[v];
+					break;
+				}
+			}
+			rotate(capPoints.begin(), capPoints.begin()+apex, capPoints.end());
+			unsigned int positiveMask=piece.mask | (1u<<section);
+			unsigned int negativeMask=piece.mask & ~(1u<<section);
+			AddPolygon(capPieces[i].positiveCell, positiveMask, capPoints.data(), capPoints.size(), section);
+			AddPolygon(capPieces[i].negativeCell, negativeMask, capPoints.data(), capPoints.size(), section);
+		}
+	}
+	//Appends to capPoints the points of the given wall strictly between a and b, in order from a to b.
+	void AddWallPoints(const SliceLine & line, int a, int b)
+	{
+		vector<WallPoint>::iterator aIt=lower_bound(wallPoints.begin(), wallPoints.end(), MakeWallPoint(line, a));
+		vector<WallPoint>::iterator bIt=lower_bound(wallPoints.begin(), wallPoints.end(), MakeWallPoint(line, b));
+		if(aIt<bIt)
+			for(vector<WallPoint>::iterator it=aIt+1;it<bIt;it++)
+				capPoints.push_back(it->point);
+		else
+			for(vector<WallPoint>::iterator it=aIt;it>bIt+1;it--)
+				capPoints.push_back((it-1)->point);
+	}
+	//Splits a convex polygon by plane p; the new edge, on the plane, lies on the given line.
+	void SplitPiece(const Polygon & piece, unsigned int p, SliceLine splitLine)
+	{
+		const PolygonVertex* polygonVertices=piece.vertices;
+		size_t count=piece.count;
+		bool anyPositive=false, anyNegative=false;
+		bool sides[SLICE_MAX_POLYGON];
+		for(size_t i=0;i<count;i++)
+		{
+			sides[i]=PositiveSide(polygonVertices[i].point, p);
+			anyPositive=anyPositive || sides[i];
+			anyNegative=anyNegative || !sides[i];
+		}
+		if(!anyNegative || !anyPositive)
+		{
+			nextPieces.push_back(piece);
+			nextPieces.back().mask=piece.mask | (anyPositive? 1u<<p : 0);
+			return;
+		}
+		nextPieces.resize(nextPieces.size()+2);
+		Polygon & positivePiece=nextPieces[nextPieces.size()-2];
+		Polygon & negativePiece=nextPieces[nextPieces.size()-1];
+		positivePiece.count=negativePiece.count=0;
+		positivePiece.mask=piece.mask | (1u<<p);
+		negativePiece.mask=piece.mask;
+		for(size_t i=0;i<count;i++)
+		{
+			const PolygonVertex & a=polygonVertices[i];
+			const PolygonVertex & b=polygonVertices[(i+1)%count];
+			bool aSide=sides[i];
+			bool bSide=sides[(i+1)%count];
+			(aSide? positivePiece : negativePiece).Add(a);
+			if(aSide!=bSide)
+			{
+				//The piece of a leaves the edge along the plane, the piece of b goes on along the edge.
+				int point=Intersection(a, b, p);
+				(aSide? positivePiece : negativePiece).Add(PolygonVertex(point, splitLine));
+				(bSide? positivePiece : negativePiece).Add(PolygonVertex(point, a.line));
+			}
+		}
+	}
+	//The produced mesh of the cell with the given mask; it is created at the first surface polygon of the cell, and with a grouping,
+	//the polygon tells the group.
+	unsigned int GetCell(unsigned int mask, const Polygon & piece)
+	{
+		unsigned int* cellIndex=cellIndices.Find(mask);
+		if(cellIndex)
+			return *cellIndex;
+		unsigned int group=mask;
+		if(grouping)
+		{
+			glm::vec3 center(0.0f);
+			for(size_t i=0;i<piece.count;i++)
+				center+=points[piece.vertices[i].point].vertex.Position;
+			group=(*grouping)(mask, center/(float)piece.count);
+		}
+		bool isNew;
+		unsigned int & index=groupIndices.Insert(group, isNew);
+		if(isNew)
+		{
+			index=cells->size();
+			cells->push_back(SliceCell());
+			cells->back().mask=group;
+			cellVertexMaps.push_back(ArenaHashMap<SliceKey, unsigned int>());
+			cellVertexMaps.back().Reset(&arena, vertexCount/SLICE_MAX_PLANES);
+			cellIntegrals.push_back(VolumeIntegrals());
+		}
+		cellIndices.Insert(mask, isNew)=index;
+		return index;
+	}
+	//The hull of each cell is the hull of the sliced mesh clipped by all planes; when cells are grouped, the hull of a group
+	//is the hull of the union of the hulls of its cells.
+	void ClipHulls()
+	{
+		HullClipper::ShapePoints(*hull, parentHullPoints, hullOrigin, hullAxes);
+		cellCounts.assign(cells->size(), 0);
+		cellIndices.ForEach([this](unsigned int mask, unsigned int cellIndex)
+		{
+			cellPoints=parentHullPoints;
+			for(unsigned int p=0;p<planeCount && !cellPoints.empty();p++)
+			{
+				glm::vec3 normal=(mask & (1u<<p))? (*planes)[p].normal : -(*planes)[p].normal;
+				hullClipper.Clip(cellPoints, normal, (*planes)[p].point);
+			}
+			vector<glm::vec3> & cellHullPoints=(*cells)[cellIndex].side.hullPoints;
+			cellHullPoints.insert(cellHullPoints.end(), cellPoints.begin(), cellPoints.end());
+			cellCounts[cellIndex]++;
+		});
+		for(unsigned int i=0;i<cells->size();i++)
+			if(cellCounts[i]>1)
+				hullClipper.Reduce((*cells)[i].side.hullPoints);
+	}
+	//The apex of the tetrahedra of the volume integrals: the point of the first plane, which is close to the mesh.
+	glm::vec3 VolumeApex()
+	{
+		return planeCount>0? (*planes)[0].point : glm::vec3(0.0f);
+	}
+	int FindCell(unsigned int mask)
+	{
+		unsigned int* cellIndex=cellIndices.Find(mask);
+		return cellIndex? (int)*cellIndex : -1;
+	}
+	//Adds a surface polygon to the given produced mesh.
+	void AddPolygon(unsigned int cellIndex, unsigned int mask, const Polygon & piece)
+	{
+		int polygonPoints[SLICE_MAX_POLYGON];
+		for(size_t i=0;i<piece.count;i++)
+			polygonPoints[i]=piece.vertices[i].point;
+		AddPolygon(cellIndex, mask, polygonPoints, piece.count, -1);
+	}
+	//Adds a convex polygon to the given produced mesh, as a fan of triangles. Section polygons get the normal of the section
+	//seen from the cell with the given mask, and their winding is reversed when needed to face it: all the triangles of a section
+	//are wound the same way (see capFacesNormal), so even the degenerate ones the triangulation may produce close the cells.
+	void AddPolygon(unsigned int cellIndex, unsigned int mask, const int* polygonPoints, size_t count, int section)
+	{
+		CutSide & side=(*cells)[cellIndex].side;
+		ArenaHashMap<SliceKey, unsigned int> & vertexMap=cellVertexMaps[cellIndex];
+		glm::vec3 sectionNormal(0.0f);
+		bool reverse=false;
+		if(section>=0)
+		{
+			bool facesNormal=(mask & (1u<<section))==0;
+			sectionNormal=facesNormal? (*planes)[section].normal : -(*planes)[section].normal;
+			reverse=facesNormal!=capFacesNormal[section];
+		}
+		polygonIndices.resize(count);
+		for(size_t i=0;i<count;i++)
+		{
+			const SlicePoint & point=points[polygonPoints[reverse? count-1-i : i]];
+			SliceKey key=point.key;
+			key.cap=section+1;
+			bool isNew;
+			unsigned int & vertexIndex=vertexMap.Insert(key, isNew);
+			if(!isNew)
+			{
+				polygonIndices[i]=vertexIndex;
+				continue;
+			}
+			unsigned int index=side.vertices.size();
+			vertexIndex=index;
+			if(section<0)
+				side.vertices.push_back(point.vertex);
+			else
+				side.vertices.push_back(Vertex(point.vertex.Position, sectionNormal, glm::vec2(0.0f)));
+			polygonIndices[i]=index;
+		}
+		glm::vec3 apex=VolumeApex();
+		for(size_t i=1;i+1<count;i++)
+		{
+			side.indices.push_back(polygonIndices[0]);
+			side.indices.push_back(polygonIndices[i]);
+			side.indices.push_back(polygonIndices[i+1]);
+			glm::vec3 a=side.vertices[polygonIndices[0]].Position;
+			glm::vec3 b=side.vertices[polygonIndices[i]].Position;
+			glm::vec3 c=side.vertices[polygonIndices[i+1]].Position;
+			cellIntegrals[cellIndex].AddTriangle(a-apex, b-apex, c-apex);
+			//Section triangles don't count in the area.
+			if(section<0)
+			{
+				float triangleArea=glm::length(glm::cross(b-a, c-a))*0.5f;
+				side.centroid+=triangleArea*(a+b+c)/3.0f;
+				side.area+=triangleArea;
+			}
+		}
+	}
+};
@@ -0,0 +1,795 @@
+/*
+MeshReader and MeshWriter classes:
+A baked mesh file (.mesh) holds a mesh as it is in memory: a header, the vertices (see Vertex), then the indices of the
+triangles. GL_Ninja --bake writes the one of each model next to its OBJ file. The reader reads it in blocks, and the writer
+writes it incrementally, so a mesh never has to fit in memory: the indices go to a temporary file next to the output, and they
+are appended to the vertices when the writer is closed.
+
+StreamingCutter class:
+Cuts a mesh stored in a baked mesh file, writing the two sides to two new files, with a bounded amount of memory; it is meant
+for meshes too large for MeshCutter, which keeps the whole mesh and about three times as much in temporaries.
+1) The vertices are read in blocks and classified (see PlaneClassifier); each one is written to the file of its side, and its
+   side is kept in a bit set.
+2) The triangles are read in blocks: the ones on a side are written to its file, their indices mapped by counting the vertices
+   of the same side before them in the bit set; the ones crossed by the plane are split as MeshCutter does, and the vertices
+   created on their edges are kept in memory, welded by edge, with the segments of the section.
+3) The section is chained into loops, across the seams of the mesh, and triangulated, and the new vertices are appended to
+   the files.
+So the memory used is a few blocks, 1.5 bits for each vertex of the mesh, and the vertices of the section. The positions of the
+vertices of the triangles are read through a small cache of blocks of vertices, which works well as long as the triangles
+use vertices close to each other in the file, as the ones sorted by a TriangleTree do.
+The files are read and written in blocks through stdio rather than mapped in memory, since mapping them on Windows would need
+windows.h, which the application doesn't include.
+The mass properties and the hull points of the sides are computed on the way. Intersections closer than CUT_SNAP_EPSILON to a
+vertex are snapped to it, as MeshCutter does, and the triangles that collapse are dropped; the sides have no adjacency nor tree.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdio.h>
+#include <stdint.h>
+#include <float.h>
+#include <limits.h>
+#include <glm/glm.hpp>
+#include <btConvexHullShape.h>
+#include <utils/log.h>
+#include <utils/vertex.h>
+#include <utils/classify.h>
+#include <utils/predicates.h>
+#include <utils/integrals.h>
+#include <utils/triangulate.h>
+#include <utils/hull.h>
+#include <utils/cut.h>
+
+#ifdef _WIN32
+	#define STREAM_SEEK _fseeki64
+	#define STREAM_TELL _ftelli64
+#else
+	#define STREAM_SEEK fseeko
+	#define STREAM_TELL ftello
+#endif
+
+//Identifies the baked mesh files, and their version.
+#define MESH_FILE_MAGIC 0x4853454Du
+#define MESH_FILE_VERSION 1u
+//Vertices and triangles read at once by the streaming cut, and triangles written at once to each side.
+#define STREAM_BLOCK_VERTICES 65536
+#define STREAM_BLOCK_TRIANGLES 65536
+//The cache of the vertices of the triangles: number of blocks, and vertices in each block.
+#define STREAM_CACHE_BLOCKS 16
+#define STREAM_CACHE_BLOCK_VERTICES 4096
+//The points collected for the hull of a side are simplified to HULL_POINT_BUDGET ones each time they exceed this number.
+#define STREAM_HULL_POINTS 8192
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	//Attributes of the vertices (see Mesh::attributes).
+	uint32_t attributes;
+	uint32_t reserved;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+};
+
+class MeshReader
+{
+public:
+	MeshFileHeader header;
+
+	MeshReader(): file(nullptr), failed(false), useCount(0) {}
+	~MeshReader()
+	{
+		Close();
+	}
+	//Opens the file, checking that its size matches the header; the vertices must be few enough to be indexed by the edge keys
+	//of the cuts (31 bits).
+	bool Open(const string & path)
+	{
+		Close();
+		file=fopen(path.c_str(), "rb");
+		if(!file)
+			return false;
+		bool valid=fread(&header, sizeof(header), 1, file)==1 && header.magic==MESH_FILE_MAGIC && header.version==MESH_FILE_VERSION &&
+			header.vertexCount<(1ULL<<31) && header.indexCount%3==0;
+		if(valid && STREAM_SEEK(file, 0, SEEK_END)==0)
+			valid=(uint64_t)STREAM_TELL(file)==sizeof(header)+header.vertexCount*sizeof(Vertex)+header.indexCount*sizeof(unsigned int);
+		if(!valid)
+		{
+			cout << "Invalid mesh file " << path << endl;
+			Close();
+			return false;
+		}
+		cache.resize(STREAM_CACHE_BLOCKS);
+		for(unsigned int i=0;i<cache.size();i++)
+		{
+			cache[i].block=UINT64_MAX;
+			cache[i].lastUse=0;
+			cache[i].vertices.resize(STREAM_CACHE_BLOCK_VERTICES);
+		}
+		failed=false;
+		return true;
+	}
+	void Close()
+	{
+		if(file)
+			fclose(file);
+		file=nullptr;
+		cache.clear();
+	}
+	bool ReadVertices(uint64_t first, size_t count, Vertex* vertices)
+	{
+		return Read(sizeof(header)+first*sizeof(Vertex), count*sizeof(Vertex), vertices);
+	}
+	bool ReadIndices(uint64_t first, size_t count, unsigned int* indices)
+	{
+		return Read(sizeof(header)+header.vertexCount*sizeof(Vertex)+first*sizeof(unsigned int), count*sizeof(unsigned int), indices);
+	}
+	//A vertex, read through the cache; the least recently used block is replaced. If the read fails, Failed becomes true.
+	Vertex GetVertex(unsigned int vertex)
+	{
+		uint64_t block=vertex/STREAM_CACHE_BLOCK_VERTICES;
+		unsigned int oldest=0;
+		for(unsigned int i=0;i<cache.size();i++)
+		{
+			if(cache[i].block==block)
+			{
+				cache[i].lastUse=++useCount;
+				return cache[i].vertices[vertex%STREAM_CACHE_BLOCK_VERTICES];
+			}
+			if(cache[i].lastUse<cache[oldest].lastUse)
+				oldest=i;
+		}
+		CacheBlock & cacheBlock=cache[oldest];
+		uint64_t first=block*STREAM_CACHE_BLOCK_VERTICES;
+		size_t count=(size_t)min((uint64_t)STREAM_CACHE_BLOCK_VERTICES, header.vertexCount-first);
+		cacheBlock.block=block;
+		cacheBlock.lastUse=++useCount;
+		if(!ReadVertices(first, count, cacheBlock.vertices.data()))
+		{
+			failed=true;
+			cacheBlock.block=UINT64_MAX;
+			return Vertex();
+		}
+		return cacheBlock.vertices[vertex%STREAM_CACHE_BLOCK_VERTICES];
+	}
+	bool Failed() const
+	{
+		return failed;
+	}
+
+private:
+	struct CacheBlock
+	{
+		uint64_t block;
+		uint64_t lastUse;
+		vector<Vertex> vertices;
+	};
+	FILE* file;
+	bool failed;
+	vector<CacheBlock> cache;
+	uint64_t useCount;
+
+	bool Read(uint64_t offset, size_t size, void* data)
+	{
+		if(size==0)
+			return true;
+		if(!file || STREAM_SEEK(file, offset, SEEK_SET)!=0 || fread(data, size, 1, file)!=1)
+		{
+			failed=true;
+			return false;
+		}
+		return true;
+	}
+};
+
+class MeshWriter
+{
+public:
+	MeshWriter(): file(nullptr), indexFile(nullptr), failed(false) {}
+	~MeshWriter()
+	{
+		Discard();
+	}
+	//The file of the baked mesh of a model is next to its OBJ file, with the extension .mesh.
+	static string BakedPath(const string & modelPath)
+	{
+		size_t dot=modelPath.find_last_of('.');
+		size_t slash=modelPath.find_last_of('/');
+		if(dot==string::npos || (slash!=string::npos && dot<slash))
+			return modelPath+".mesh";
+		return modelPath.substr(0, dot)+".mesh";
+	}
+	//Writes a whole mesh at once.
+	static bool Write(const string & path, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, unsigned int attributes)
+	{
+		MeshWriter writer;
+		if(!writer.Open(path, attributes))
+			return false;
+		writer.WriteVertices(vertices, vertexCount);
+		writer.WriteIndices(indices, indexCount);
+		return writer.Close();
+	}
+	bool Open(const string & path, unsigned int attributes)
+	{
+		Discard();
+		this->path=path;
+		file=fopen(path.c_str(), "wb");
+		indexFile=fopen(IndexPath().c_str(), "w+b");
+		header.magic=MESH_FILE_MAGIC;
+		header.version=MESH_FILE_VERSION;
+		header.attributes=attributes;
+		header.reserved=0;
+		header.vertexCount=0;
+		header.indexCount=0;
+		failed=false;
+		if(!file || !indexFile || fwrite(&header, sizeof(header), 1, file)!=1)
+		{
+			Discard();
+			return false;
+		}
+		return true;
+	}
+	//If a write fails (for instance when the disk is full), the writer remembers it, and Close fails.
+	void WriteVertices(const Vertex* vertices, size_t count)
+	{
+		if(count>0 && fwrite(vertices, sizeof(Vertex), count, file)!=count)
+			failed=true;
+		header.vertexCount+=count;
+	}
+	void WriteIndices(const unsigned int* indices, size_t count)
+	{
+		if(count>0 && fwrite(indices, sizeof(unsigned int), count, indexFile)!=count)
+			failed=true;
+		header.indexCount+=count;
+	}
+	uint64_t VertexCount() const
+	{
+		return header.vertexCount;
+	}
+	//Appends the indices to the vertices, in blocks, and completes the header; returns false if anything could not be written.
+	bool Close()
+	{
+		if(!file)
+			return false;
+		bool written=!failed && fflush(indexFile)==0 && STREAM_SEEK(indexFile, 0, SEEK_SET)==0;
+		vector<unsigned int> block(3*STREAM_BLOCK_TRIANGLES);
+		uint64_t copied=0;
+		size_t count;
+		while(written && (count=fread(block.data(), sizeof(unsigned int), block.size(), indexFile))>0)
+		{
+			written=fwrite(block.data(), sizeof(unsigned int), count, file)==count;
+			copied+=count;
+		}
+		written=written && copied==header.indexCount && !ferror(indexFile) && !ferror(file) && STREAM_SEEK(file, 0, SEEK_SET)==0 && fwrite(&header, sizeof(header), 1, file)==1;
+		written=fclose(file)==0 && written;
+		file=nullptr;
+		fclose(indexFile);
+		indexFile=nullptr;
+		remove(IndexPath().c_str());
+		if(!written)
+			remove(path.c_str());
+		return written;
+	}
+	//Closes the files without completing them, and deletes them.
+	void Discard()
+	{
+		if(file)
+		{
+			fclose(file);
+			remove(path.c_str());
+		}
+		if(indexFile)
+		{
+			fclose(indexFile);
+			remove(IndexPath().c_str());
+		}
+		file=nullptr;
+		indexFile=nullptr;
+	}
+
+private:
+	string path;
+	FILE* file;
+	FILE* indexFile;
+	bool failed;
+	MeshFileHeader header;
+
+	string IndexPath() const
+	{
+		return path+".indices";
+	}
+};
+
+class StreamingCutter
+{
+public:
+	enum Side
+	{
+		POSITIVE=0,
+		NEGATIVE=1
+	};
+
+	StreamingCutter(): source(nullptr), attributes(VERTEX_ALL_ATTRIBUTES), collectHullPoints(true) {}
+
+	//Cuts the mesh of the source by the plane, writing the positive and the negative side to the given files. The sides of result
+	//get the mass properties and the points of the convex hull (see CutSide), but no geometry. With the convex hull of the mesh,
+	//whose points are relative to hullOrigin, the hulls of the sides are clipped from it; otherwise they are collected from their
+	//vertices. If the plane grazes the mesh no file is written; false is returned if a file can't be read or written.
+	bool Cut(MeshReader & source, const CutPlane & plane, const string & positivePath, const string & negativePath, CutResult & result, const btConvexHullShape* hull=nullptr, glm::vec3 hullOrigin=glm::vec3(0.0f))
+	{
+		this->source=&source;
+		this->plane=plane;
+		attributes=source.header.attributes;
+		sides[POSITIVE]=&result.positive;
+		sides[NEGATIVE]=&result.negative;
+		for(int s=0;s<2;s++)
+		{
+			*sides[s]=CutSide();
+			integrals[s]=VolumeIntegrals();
+			blockIntegrals[s]=VolumeIntegrals();
+			blockCentroids[s]=glm::vec3(0.0f);
+			blockAreas[s]=0.0f;
+			newVertices[s].clear();
+			triangles[s].clear();
+			hullPoints[s].clear();
+		}
+		edgeVertices.clear();
+		collectHullPoints=hull==nullptr;
+		result.grazed=false;
+		if(!writers[POSITIVE].Open(positivePath, attributes) || !writers[NEGATIVE].Open(negativePath, attributes))
+		{
+			writers[POSITIVE].Discard();
+			return false;
+		}
+
+		Log log=Log();
+		log.InitLog("Streaming cut");
+		bool crossed=false;
+		bool read=ClassifyVertices(crossed) && SplitTriangles();
+		if(!read || !crossed)
+		{
+			writers[POSITIVE].Discard();
+			writers[NEGATIVE].Discard();
+			result.grazed=read;
+			log.EndLog();
+			return read;
+		}
+		AddSection();
+		for(int s=0;s<2;s++)
+		{
+			writers[s].WriteVertices(newVertices[s].data(), newVertices[s].size());
+			FlushTriangles(s);
+		}
+		bool written=writers[POSITIVE].Close();
+		written=writers[NEGATIVE].Close() && written;
+		log.EndLog();
+
+		for(int s=0;s<2;s++)
+		{
+			CutSide & side=*sides[s];
+			if(side.area>0.0f)
+				side.centroid/=side.area;
+			MeshCutter::ApplyVolumeIntegrals(side, integrals[s], glm::vec3(0.0f));
+		}
+		if(hull)
+		{
+			HullClipper::ShapePoints(*hull, parentHullPoints, hullOrigin);
+			hullClipper.Split(parentHullPoints, plane.normal, plane.point, result.positive.hullPoints, result.negative.hullPoints);
+		}
+		else
+		{
+			result.positive.hullPoints.swap(hullPoints[POSITIVE]);
+			result.negative.hullPoints.swap(hullPoints[NEGATIVE]);
+		}
+		//The points are relative to the centroid, and simplified to HULL_POINT_BUDGET.
+		MeshCutter::CollectHullPoints(result.positive, hullClipper);
+		MeshCutter::CollectHullPoints(result.negative, hullClipper);
+		return written;
+	}
+
+private:
+	//A vertex created on an edge crossed by the plane, or snapped to a vertex of the mesh, on the surface and on the section's
+	//face of each side (UINT_MAX until a segment reaches it), with the segments of the section leaving and reaching it (see
+	//SectionVertex); ULLONG_MAX where there is none.
+	struct EdgeVertex
+	{
+		unsigned int surface[2];
+		unsigned int section[2];
+		glm::vec3 position;
+		unsigned long long next;
+		unsigned long long previous;
+		bool chained;
+	};
+
+	MeshReader* source;
+	CutPlane plane;
+	unsigned int attributes;
+	CutSide* sides[2];
+	MeshWriter writers[2];
+	//Bit set of the vertices on the positive side, and the number of positive vertices before each of its words.
+	vector<uint64_t> positiveBits;
+	vector<uint32_t> positiveRanks;
+	//Vertices of the mesh on each side, written in pass 1: the new vertices follow them.
+	uint64_t copiedCount[2];
+	unordered_map<unsigned long long, EdgeVertex> edgeVertices;
+	vector<Vertex> newVertices[2];
+	vector<unsigned int> triangles[2];
+	VolumeIntegrals integrals[2];
+	//The sums of the current block of triangles, added to the ones of the sides at the end of the block, which loses less
+	//precision than adding each triangle to the sums of the whole mesh.
+	VolumeIntegrals blockIntegrals[2];
+	glm::vec3 blockCentroids[2];
+	float blockAreas[2];
+	bool collectHullPoints;
+	vector<glm::vec3> hullPoints[2];
+	vector<glm::vec3> parentHullPoints;
+	HullClipper hullClipper;
+	PolygonTriangulator triangulator;
+	vector<Vertex> vertexBlock;
+	vector<float> distances;
+	vector<Vertex> sideVertices[2];
+	vector<unsigned int> indexBlock;
+	vector<EdgeVertex*> loopEdges;
+	//The ends of the open chains of the section by position, to join the chains across the seams of the mesh, as MeshCutter does.
+	unordered_map<glm::vec3, unsigned long long> chainStarts;
+	unordered_map<glm::vec3, unsigned long long> chainEnds;
+	vector<glm::vec2> loopPoints;
+	vector<unsigned int> loopStarts;
+	vector<unsigned int> faceTriangles;
+
+	//Pass 1: crossed tells whether the vertices lie on both sides.
+	bool ClassifyVertices(bool & crossed)
+	{
+		uint64_t vertexCount=source->header.vertexCount;
+		size_t wordCount=(size_t)((vertexCount+63)/64);
+		positiveBits.assign(wordCount, 0);
+		positiveRanks.resize(wordCount);
+		vertexBlock.resize(STREAM_BLOCK_VERTICES);
+		distances.resize(STREAM_BLOCK_VERTICES);
+		float minDistance=FLT_MAX;
+		float maxDistance=-FLT_MAX;
+		for(uint64_t first=0;first<vertexCount;first+=STREAM_BLOCK_VERTICES)
+		{
+			size_t count=(size_t)min((uint64_t)STREAM_BLOCK_VERTICES, vertexCount-first);
+			if(!source->ReadVertices(first, count, vertexBlock.data()))
+				return false;
+			float blockMin, blockMax;
+			PlaneClassifier::SignedDistances(vertexBlock.data(), count, plane.normal, plane.point, distances.data(), blockMin, blockMax);
+			minDistance=min(minDistance, blockMin);
+			maxDistance=max(maxDistance, blockMax);
+			sideVertices[POSITIVE].clear();
+			sideVertices[NEGATIVE].clear();
+			for(size_t i=0;i<count;i++)
+			{
+				uint64_t vertex=first+i;
+				int side=distances[i]>0.f? POSITIVE : NEGATIVE;
+				if(side==POSITIVE)
+					positiveBits[vertex>>6]|=1ULL<<(vertex & 63);
+				sideVertices[side].push_back(vertexBlock[i]);
+				AddHullPoint(side, vertexBlock[i].Position);
+			}
+			for(int s=0;s<2;s++)
+				writers[s].WriteVertices(sideVertices[s].data(), sideVertices[s].size());
+		}
+		uint32_t rank=0;
+		for(size_t w=0;w<wordCount;w++)
+		{
+			positiveRanks[w]=rank;
+			rank+=PopCount(positiveBits[w]);
+		}
+		for(int s=0;s<2;s++)
+			copiedCount[s]=writers[s].VertexCount();
+		crossed=minDistance<=0.f && maxDistance>0.f;
+		return true;
+	}
+	//Pass 2
+	bool SplitTriangles()
+	{
+		uint64_t indexCount=source->header.indexCount;
+		indexBlock.resize(3*STREAM_BLOCK_TRIANGLES);
+		for(uint64_t first=0;first<indexCount;first+=indexBlock.size())
+		{
+			size_t count=(size_t)min((uint64_t)indexBlock.size(), indexCount-first);
+			if(!source->ReadIndices(first, count, indexBlock.data()))
+				return false;
+			for(size_t i=0;i<count;i+=3)
+			{
+				unsigned int a=indexBlock[i];
+				unsigned int b=indexBlock[i+1];
+				unsigned int c=indexBlock[i+2];
+				if(a>=source->header.vertexCount || b>=source->header.vertexCount || c>=source->header.vertexCount)
+					return false;
+				bool aPositive=IsPositive(a);
+				bool bPositive=IsPositive(b);
+				bool cPositive=IsPositive(c);
+				if(aPositive==bPositive && bPositive==cPositive)
+				{
+					int side=aPositive? POSITIVE : NEGATIVE;
+					AddTriangle(side, Rank(side, a), Rank(side, b), Rank(side, c), source->GetVertex(a).Position, source->GetVertex(b).Position, source->GetVertex(c).Position, true);
+				}
+				//The lone vertex on its side comes first, as in MeshCutter.
+				else if(aPositive==bPositive)
+					SplitTriangle(c, a, b, cPositive);
+				else if(aPositive==cPositive)
+					SplitTriangle(b, c, a, bPositive);
+				else
+					SplitTriangle(a, b, c, aPositive);
+			}
+			for(int s=0;s<2;s++)
+			{
+				integrals[s].Add(blockIntegrals[s]);
+				sides[s]->centroid+=blockCentroids[s];
+				sides[s]->area+=blockAreas[s];
+				blockIntegrals[s]=VolumeIntegrals();
+				blockCentroids[s]=glm::vec3(0.0f);
+				blockAreas[s]=0.0f;
+			}
+		}
+		return !source->Failed();
+	}
+	//The side of a gets the triangle a, ab, ca; the other side the triangles b, c, ca and b, ca, ab. Where an intersection is
+	//snapped to a vertex (see SnapEdge), some of the triangles collapse and are dropped (see AddTriangle), as in MeshCutter.
+	void SplitTriangle(unsigned int a, unsigned int b, unsigned int c, bool aPositive)
+	{
+		unsigned long long abKey=SnapEdge(a, b);
+		unsigned long long caKey=SnapEdge(c, a);
+		EdgeVertex & ab=GetEdgeVertex(abKey);
+		EdgeVertex & ca=GetEdgeVertex(caKey);
+		int aSide=aPositive? POSITIVE : NEGATIVE;
+		int bcSide=aPositive? NEGATIVE : POSITIVE;
+		//The side of a walks the new edge from ab to ca, so its face must walk it from ca to ab, the other side the opposite way.
+		//If both intersections are snapped to the same vertex, there is no segment.
+		if(abKey!=caKey)
+		{
+			EdgeVertex & segmentStart=aPositive? ca : ab;
+			EdgeVertex & segmentEnd=aPositive? ab : ca;
+			segmentStart.next=aPositive? abKey : caKey;
+			segmentEnd.previous=aPositive? caKey : abKey;
+			AddSectionVertices(ab);
+			AddSectionVertices(ca);
+		}
+		//The section's face doesn't count in the area; its integrals are added as a fan around the point of the plane.
+		blockIntegrals[aSide].AddTriangle(plane.point, ca.position, ab.position);
+		blockIntegrals[bcSide].AddTriangle(plane.point, ab.position, ca.position);
+		glm::vec3 aPosition=source->GetVertex(a).Position;
+		glm::vec3 bPosition=source->GetVertex(b).Position;
+		glm::vec3 cPosition=source->GetVertex(c).Position;
+		AddTriangle(aSide, Rank(aSide, a), ab.surface[aSide], ca.surface[aSide], aPosition, ab.position, ca.position, true);
+		AddTriangle(bcSide, Rank(bcSide, b), Rank(bcSide, c), ca.surface[bcSide], bPosition, cPosition, ca.position, true);
+		AddTriangle(bcSide, Rank(bcSide, b), ca.surface[bcSide], ab.surface[bcSide], bPosition, ca.position, ab.position, true);
+	}
+	//Factor of the intersection of the edge, interpolated from the vertex with the lower position, which is put in ends[0], as
+	//MeshCutter::EdgeIntersection does. The distances of the ends have the exact signs the classification gave them (see
+	//ExactPredicates), and the factor is kept in the edge even when they are rounded to a few units of FLT_MIN.
+	float EdgeIntersection(unsigned int a, unsigned int b, unsigned int ends[2])
+	{
+		ends[0]=a;
+		ends[1]=b;
+		glm::vec3 first=source->GetVertex(a).Position;
+		glm::vec3 second=source->GetVertex(b).Position;
+		if(second.x<first.x || (second.x==first.x && (second.y<first.y || (second.y==first.y && second.z<first.z))))
+		{
+			swap(ends[0], ends[1]);
+			swap(first, second);
+		}
+		float endDistances[2];
+		ExactPredicates::PlaneSide(plane.normal, plane.point, first, endDistances[0]);
+		ExactPredicates::PlaneSide(plane.normal, plane.point, second, endDistances[1]);
+		float denominator=endDistances[0]-endDistances[1];
+		return denominator!=0.0f? glm::clamp(endDistances[0]/denominator, 0.0f, 1.0f) : 0.5f;
+	}
+	//The key of the vertex of the section on the edge ab: the key of the edge, or the key of the edge from one of its ends to itself
+	//if the intersection is closer than CUT_SNAP_EPSILON to it, as in MeshCutter::SnapEdge. The choice depends only on the edge,
+	//so all the triangles sharing it agree.
+	unsigned long long SnapEdge(unsigned int a, unsigned int b)
+	{
+		unsigned int ends[2];
+		float intFactor=EdgeIntersection(a, b, ends);
+		float length=glm::length(source->GetVertex(ends[1]).Position-source->GetVertex(ends[0]).Position);
+		if(intFactor*length<CUT_SNAP_EPSILON)
+			return EdgeKey(ends[0], ends[0]);
+		if((1.0f-intFactor)*length<CUT_SNAP_EPSILON)
+			return EdgeKey(ends[1], ends[1]);
+		return EdgeKey(a, b);
+	}
+	//The vertices at the given key (see SnapEdge), created the first time it is reached. On the surface, a snapped vertex is the
+	//vertex of the mesh on its side, and a copy of it on the other side.
+	EdgeVertex & GetEdgeVertex(unsigned long long key)
+	{
+		pair<unordered_map<unsigned long long, EdgeVertex>::iterator, bool> inserted=edgeVertices.insert(make_pair(key, EdgeVertex()));
+		EdgeVertex & edgeVertex=inserted.first->second;
+		if(!inserted.second)
+			return edgeVertex;
+		unsigned int first=(unsigned int)(key>>31);
+		unsigned int second=(unsigned int)(key & 0x7FFFFFFFULL);
+		Vertex surface;
+		if(first==second)
+			surface=source->GetVertex(first);
+		else
+		{
+			unsigned int ends[2];
+			float intFactor=EdgeIntersection(first, second, ends);
+			surface=Vertex::Interpolate(source->GetVertex(ends[0]), source->GetVertex(ends[1]), intFactor, attributes);
+		}
+		edgeVertex.position=surface.Position;
+		edgeVertex.next=ULLONG_MAX;
+		edgeVertex.previous=ULLONG_MAX;
+		edgeVertex.chained=false;
+		for(int s=0;s<2;s++)
+		{
+			bool snappedSide=first==second && IsPositive(first)==(s==POSITIVE);
+			edgeVertex.surface[s]=snappedSide? Rank(s, first) : AddNewVertex(s, surface);
+			edgeVertex.section[s]=UINT_MAX;
+		}
+		return edgeVertex;
+	}
+	//The vertices of the section's faces, created when a segment first reaches the edge vertex: a snapped vertex may have none.
+	void AddSectionVertices(EdgeVertex & edgeVertex)
+	{
+		if(edgeVertex.section[POSITIVE]!=UINT_MAX)
+			return;
+		for(int s=0;s<2;s++)
+			edgeVertex.section[s]=AddNewVertex(s, Vertex(edgeVertex.position, s==POSITIVE? -plane.normal : plane.normal, glm::vec2(0.0f)));
+	}
+	unsigned int AddNewVertex(int side, const Vertex & vertex)
+	{
+		newVertices[side].push_back(vertex);
+		AddHullPoint(side, vertex.Position);
+		return (unsigned int)(copiedCount[side]+newVertices[side].size()-1);
+	}
+	//The vertex following the given one along the section, across seams; ULLONG_MAX at the end of an open chain. As in
+	//MeshCutter::NextSectionEdge, the end of a chain is replaced by the start of the chain it is joined to.
+	unsigned long long NextSectionEdge(unsigned long long edge)
+	{
+		unsigned long long next=edgeVertices[edge].next;
+		if(next==ULLONG_MAX || edgeVertices[next].next!=ULLONG_MAX)
+			return next;
+		unordered_map<glm::vec3, unsigned long long>::iterator joined=chainStarts.find(edgeVertices[next].position);
+		return joined!=chainStarts.end() && joined->second!=next? joined->second : next;
+	}
+	//The vertex preceding the given one along the section, across seams; ULLONG_MAX at the start of an open chain.
+	unsigned long long PreviousSectionEdge(unsigned long long edge)
+	{
+		const EdgeVertex & edgeVertex=edgeVertices[edge];
+		if(edgeVertex.previous!=ULLONG_MAX)
+			return edgeVertex.previous;
+		unordered_map<glm::vec3, unsigned long long>::iterator joined=chainEnds.find(edgeVertex.position);
+		return joined!=chainEnds.end() && joined->second!=edge? edgeVertices[joined->second].previous : ULLONG_MAX;
+	}
+	//Pass 3: the segments are chained into loops as in MeshCutter::TriangulateSection: from each vertex not chained yet, the
+	//chain is followed back to its start, then forward until it closes. The section's face of the negative side walks the
+	//triangles backwards.
+	void AddSection()
+	{
+		loopEdges.clear();
+		loopPoints.clear();
+		loopStarts.assign(1, 0);
+		faceTriangles.clear();
+		chainStarts.clear();
+		chainEnds.clear();
+		for(unordered_map<unsigned long long, EdgeVertex>::iterator it=edgeVertices.begin();it!=edgeVertices.end();++it)
+		{
+			//A vertex snapped only by triangles without a segment (see SplitTriangle) is not on a chain.
+			if(it->second.previous==ULLONG_MAX && it->second.next==ULLONG_MAX)
+				continue;
+			if(it->second.previous==ULLONG_MAX)
+				chainStarts[it->second.position]=it->first;
+			if(it->second.next==ULLONG_MAX)
+				chainEnds[it->second.position]=it->first;
+		}
+		glm::vec3 u=glm::normalize(glm::cross(plane.normal, fabs(plane.normal.x)<0.9f? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f)));
+		glm::vec3 v=glm::cross(plane.normal, u);
+		for(unordered_map<unsigned long long, EdgeVertex>::iterator it=edgeVertices.begin();it!=edgeVertices.end();++it)
+		{
+			if(it->second.chained)
+				continue;
+			unsigned long long start=it->first;
+			for(size_t steps=0;steps<edgeVertices.size();steps++)
+			{
+				unsigned long long previous=PreviousSectionEdge(start);
+				if(previous==ULLONG_MAX || previous==it->first || edgeVertices[previous].chained)
+					break;
+				start=previous;
+			}
+			unsigned int first=loopEdges.size();
+			unsigned long long edge=start;
+			while(true)
+			{
+				EdgeVertex & edgeVertex=edgeVertices[edge];
+				edgeVertex.chained=true;
+				glm::vec3 position=edgeVertex.position-plane.point;
+				loopEdges.push_back(&edgeVertex);
+				loopPoints.push_back(glm::vec2(glm::dot(position, u), glm::dot(position, v)));
+				unsigned long long next=NextSectionEdge(edge);
+				if(next==ULLONG_MAX || edgeVertices[next].chained)
+					break;
+				edge=next;
+			}
+			if(loopEdges.size()-first<3)
+			{
+				loopEdges.resize(first);
+				loopPoints.resize(first);
+			}
+			else
+				loopStarts.push_back(loopEdges.size());
+		}
+		triangulator.Triangulate(loopPoints, loopStarts, faceTriangles);
+		for(size_t i=0;i<faceTriangles.size();i+=3)
+		{
+			const EdgeVertex & a=*loopEdges[faceTriangles[i]];
+			const EdgeVertex & b=*loopEdges[faceTriangles[i+1]];
+			const EdgeVertex & c=*loopEdges[faceTriangles[i+2]];
+			AddTriangle(POSITIVE, a.section[POSITIVE], b.section[POSITIVE], c.section[POSITIVE], a.position, b.position, c.position, false);
+			AddTriangle(NEGATIVE, a.section[NEGATIVE], c.section[NEGATIVE], b.section[NEGATIVE], a.position, c.position, b.position, false);
+		}
+	}
+	//Adds the triangle to the block of its side, and to the sums of the block if it is on the surface. A triangle collapsed by
+	//snapping, which has two equal vertices, is dropped.
+	void AddTriangle(int side, unsigned int a, unsigned int b, unsigned int c, glm::vec3 aPosition, glm::vec3 bPosition, glm::vec3 cPosition, bool surface)
+	{
+		if(a==b || b==c || c==a)
+			return;
+		triangles[side].push_back(a);
+		triangles[side].push_back(b);
+		triangles[side].push_back(c);
+		if(surface)
+		{
+			float area=0.5f*glm::length(glm::cross(bPosition-aPosition, cPosition-aPosition));
+			blockCentroids[side]+=area*(aPosition+bPosition+cPosition)/3.0f;
+			blockAreas[side]+=area;
+			blockIntegrals[side].AddTriangle(aPosition, bPosition, cPosition);
+		}
+		if(triangles[side].size()>=3*STREAM_BLOCK_TRIANGLES)
+			FlushTriangles(side);
+	}
+	void FlushTriangles(int side)
+	{
+		writers[side].WriteIndices(triangles[side].data(), triangles[side].size());
+		triangles[side].clear();
+	}
+	//Without the hull of the mesh, the positions of the vertices of each side are collected, and simplified whenever they are too
+	//many: Simplify keeps the farthest point along fixed directions, so simplifying in steps gives the same points as at once.
+	void AddHullPoint(int side, glm::vec3 position)
+	{
+		if(!collectHullPoints)
+			return;
+		hullPoints[side].push_back(position);
+		if(hullPoints[side].size()>=STREAM_HULL_POINTS)
+			hullClipper.Simplify(hullPoints[side], HULL_POINT_BUDGET);
+	}
+	bool IsPositive(unsigned int vertex) const
+	{
+		return (positiveBits[vertex>>6]>>(vertex & 63)) & 1;
+	}
+	//Index of the vertex in the file of the given side: the number of vertices of the side before it.
+	unsigned int Rank(int side, unsigned int vertex) const
+	{
+		uint64_t below=positiveBits[vertex>>6] & ((1ULL<<(vertex & 63))-1);
+		unsigned int positiveBefore=positiveRanks[vertex>>6]+PopCount(below);
+		return side==POSITIVE? positiveBefore : vertex-positiveBefore;
+	}
+	static unsigned int PopCount(uint64_t bits)
+	{
+#if defined(__GNUC__)
+		return __builtin_popcountll(bits);
+#else
+		unsigned int count=0;
+		for(;bits;bits&=bits-1)
+			count++;
+		return count;
+#endif
+	}
+	static unsigned long long EdgeKey(unsigned int a, unsigned int b)
+	{
+		if(a>b)
+			swap(a, b);
+		return ((unsigned long long)a<<31) | b;
+	}
+};
@@ -0,0 +1,164 @@
+/*
+ThreadPool class:
+A fixed set of worker threads consuming a queue of jobs.
+Jobs can be submitted one by one (Submit returns a future for the result), or a loop can be split among the workers
+with ParallelFor; the thread calling ParallelFor takes part in the loop too, so it can be used from inside a job
+without waiting for free workers.
+Each worker knows its index (GetCurrentWorker), so data can be kept for each thread and reused by the jobs it runs.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+
+class ThreadPool
+{
+public:
+	//With threadCount equal to 0, a worker is created for each hardware thread but the calling one.
+	ThreadPool(unsigned int threadCount=0)
+	{
+		if(threadCount==0)
+		{
+			unsigned int hardwareThreads=thread::hardware_concurrency();
+			threadCount=hardwareThreads>1? hardwareThreads-1 : 1;
+		}
+		stopping=false;
+		for(unsigned int i=0;i<threadCount;i++)
+			workers.push_back(thread(&ThreadPool::WorkerLoop, this, i+1));
+	}
+
+	~ThreadPool()
+	{
+		{
+			unique_lock<mutex> lock(queueMutex);
+			stopping=true;
+		}
+		queueCondition.notify_all();
+		for(unsigned int i=0;i<workers.size();i++)
+			workers[i].join();
+	}
+
+	//Number of threads that can run a ParallelFor: the workers plus the calling thread.
+	unsigned int GetWorkerCount() const
+	{
+		return workers.size()+1;
+	}
+
+	//Index of the calling thread: from 1 to the number of workers for the workers of a pool, 0 for any other thread.
+	//A thread runs one job at a time, so the jobs can use it to pick data that no other running job is using.
+	static unsigned int GetCurrentWorker()
+	{
+		return CurrentWorker();
+	}
+
+	//Enqueues a job; the returned future holds its result (or the exception it has thrown).
+	template<class F>
+	future<typename result_of<F()>::type> Submit(F job)
+	{
+		typedef typename result_of<F()>::type R;
+		shared_ptr<packaged_task<R()>> task=make_shared<packaged_task<R()>>(job);
+		future<R> result=task->get_future();
+		Enqueue([task]() { (*task)(); });
+		return result;
+	}
+
+	//Calls body(i, worker) for each i in [0, count), splitting the items among the workers.
+	//worker is in [0, GetWorkerCount()) and no two concurrent calls of the same ParallelFor get the same value, so it can be
+	//used to index per-thread data. The method returns when all items have been processed.
+	void ParallelFor(size_t count, const function<void(size_t, unsigned int)> & body)
+	{
+		if(count==0)
+			return;
+		shared_ptr<ParallelForState> state=make_shared<ParallelForState>();
+		state->count=count;
+		state->next=0;
+		state->done=0;
+		state->nextWorker=1;
+		state->body=&body;
+		unsigned int helpers=min((size_t)workers.size(), count-1);
+		for(unsigned int i=0;i<helpers;i++)
+			Enqueue([state]() { RunParallelFor(*state, state->nextWorker++); });
+		RunParallelFor(*state, 0);
+		unique_lock<mutex> lock(state->doneMutex);
+		state->doneCondition.wait(lock, [&state]() { return state->done==state->count; });
+	}
+
+private:
+	struct ParallelForState
+	{
+		size_t count;
+		atomic<size_t> next;
+		size_t done;
+		atomic<unsigned int> nextWorker;
+		//Valid until all the items are done; helpers starting later find no item left and never use it.
+		const function<void(size_t, unsigned int)>* body;
+		mutex doneMutex;
+		condition_variable doneCondition;
+	};
+
+	vector<thread> workers;
+	queue<function<void()>> jobs;
+	mutex queueMutex;
+	condition_variable queueCondition;
+	bool stopping;
+
+	void Enqueue(function<void()> job)
+	{
+		{
+			unique_lock<mutex> lock(queueMutex);
+			jobs.push(std::move(job));
+		}
+		queueCondition.notify_one();
+	}
+
+	static void RunParallelFor(ParallelForState & state, unsigned int worker)
+	{
+		size_t processed=0;
+		for(size_t i=state.next++;i<state.count;i=state.next++)
+		{
+			(*state.body)(i, worker);
+			processed++;
+		}
+		if(processed>0)
+		{
+			unique_lock<mutex> lock(state.doneMutex);
+			state.done+=processed;
+			if(state.done==state.count)
+				state.doneCondition.notify_all();
+		}
+	}
+
+	static unsigned int & CurrentWorker()
+	{
+		static thread_local unsigned int currentWorker=0;
+		return currentWorker;
+	}
+
+	void WorkerLoop(unsigned int index)
+	{
+		CurrentWorker()=index;
+		while(true)
+		{
+			function<void()> job;
+			{
+				unique_lock<mutex> lock(queueMutex);
+				queueCondition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if(stopping && jobs.empty())
+					return;
+				job=std::move(jobs.front());
+				jobs.pop();
+			}
+			job();
+		}
+	}
+};
@@ -0,0 +1,205 @@
+/*
+TriangleTree class:
+A hierarchy of clusters over the triangles of a mesh, used by the cut to skip the triangles far from the plane.
+The triangles are sorted along a Morton curve of their centers, so that consecutive triangles are close to each other; then
+each run of TREE_LEAF_TRIANGLES triangles is a leaf cluster, and each cluster of a level merges two consecutive clusters of the
+level below, up to a single root. So every cluster is a range of consecutive triangles, and it stores their bounding box and
+the sums a cut needs from them: area, area weighted center and volume integrals (with the origin of object space as apex).
+When the box of a cluster lies entirely on a side of the cutting plane, the cut copies its triangles to that side and adds
+its sums, without classifying or measuring each triangle (see MeshCutter).
+Building the tree reorders the triangles of the mesh (and their adjacency, if any), so it is done before the mesh is uploaded;
+the pieces of a cut inherit the order of the cut mesh, so their trees are built without reordering.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include <utils/vertex.h>
+#include <utils/integrals.h>
+
+//Triangles of each leaf cluster.
+#define TREE_LEAF_TRIANGLES 64
+//Meshes with fewer triangles are not worth a tree.
+#define TREE_MIN_TRIANGLES 4096
+//The boxes are enlarged by this fraction of the size of the mesh, so that a box on a side of the plane is never contradicted
+//by the rounding of the distances of its vertices.
+#define TREE_BOX_PADDING 1e-4f
+
+struct TriangleCluster
+{
+	glm::vec3 boxMin;
+	glm::vec3 boxMax;
+	float area;
+	//Sum of the centers of the triangles, weighted by their area.
+	glm::vec3 weightedCenter;
+	VolumeIntegrals integrals;
+};
+
+class TriangleTree
+{
+public:
+	//Sorts the triangles of the mesh and builds the clusters over them; twins, if not null, is the adjacency of the mesh
+	//(see HalfEdgeMesh), which is updated to the new order of the triangles.
+	//The triangles of the pieces of a cut keep the order they had in the cut mesh, which is sorted already: for them, the sort
+	//can be skipped.
+	void Build(const Vertex* vertices, unsigned int* indices, size_t indexCount, int* twins, bool sortTriangles=true)
+	{
+		triangleCount=indexCount/3;
+		if(sortTriangles)
+			SortTriangles(vertices, indices, twins);
+
+		glm::vec3 meshMin(0.0f), meshMax(0.0f);
+		for(size_t i=0;i<triangleCount*3;i++)
+		{
+			glm::vec3 position=vertices[indices[i]].Position;
+			meshMin=i==0? position : glm::min(meshMin, position);
+			meshMax=i==0? position : glm::max(meshMax, position);
+		}
+		glm::vec3 padding(glm::length(meshMax-meshMin)*TREE_BOX_PADDING);
+
+		clusters.clear();
+		levelOffsets.assign(1, 0);
+		size_t leafCount=(triangleCount+TREE_LEAF_TRIANGLES-1)/TREE_LEAF_TRIANGLES;
+		for(size_t l=0;l<leafCount;l++)
+		{
+			TriangleCluster leaf;
+			leaf.area=0.0f;
+			leaf.weightedCenter=glm::vec3(0.0f);
+			size_t end=min(triangleCount, (l+1)*TREE_LEAF_TRIANGLES);
+			for(size_t t=l*TREE_LEAF_TRIANGLES;t<end;t++)
+			{
+				glm::vec3 a=vertices[indices[3*t]].Position;
+				glm::vec3 b=vertices[indices[3*t+1]].Position;
+				glm::vec3 c=vertices[indices[3*t+2]].Position;
+				glm::vec3 triangleMin=glm::min(a, glm::min(b, c));
+				glm::vec3 triangleMax=glm::max(a, glm::max(b, c));
+				leaf.boxMin=t==l*TREE_LEAF_TRIANGLES? triangleMin : glm::min(leaf.boxMin, triangleMin);
+				leaf.boxMax=t==l*TREE_LEAF_TRIANGLES? triangleMax : glm::max(leaf.boxMax, triangleMax);
+				float triangleArea=glm::length(glm::cross(b-a, c-a))*0.5f;
+				leaf.area+=triangleArea;
+				leaf.weightedCenter+=triangleArea*(a+b+c)/3.0f;
+				leaf.integrals.AddTriangle(a, b, c);
+			}
+			leaf.boxMin-=padding;
+			leaf.boxMax+=padding;
+			clusters.push_back(leaf);
+		}
+		levelOffsets.push_back(clusters.size());
+		while(LevelSize(Levels()-1)>1)
+		{
+			size_t below=Levels()-1;
+			for(size_t i=0;i<LevelSize(below);i+=2)
+			{
+				TriangleCluster cluster=Cluster(below, i);
+				if(i+1<LevelSize(below))
+				{
+					const TriangleCluster & next=Cluster(below, i+1);
+					cluster.boxMin=glm::min(cluster.boxMin, next.boxMin);
+					cluster.boxMax=glm::max(cluster.boxMax, next.boxMax);
+					cluster.area+=next.area;
+					cluster.weightedCenter+=next.weightedCenter;
+					cluster.integrals.Add(next.integrals);
+				}
+				clusters.push_back(cluster);
+			}
+			levelOffsets.push_back(clusters.size());
+		}
+	}
+	//Number of levels, the leaves being level 0.
+	unsigned int Levels() const
+	{
+		return levelOffsets.size()-1;
+	}
+	size_t LevelSize(unsigned int level) const
+	{
+		return levelOffsets[level+1]-levelOffsets[level];
+	}
+	const TriangleCluster & Cluster(unsigned int level, size_t i) const
+	{
+		return clusters[levelOffsets[level]+i];
+	}
+	//The triangles of the i-th cluster of the given level are the ones in [begin, end).
+	void ClusterTriangles(unsigned int level, size_t i, size_t & begin, size_t & end) const
+	{
+		begin=i*((size_t)TREE_LEAF_TRIANGLES<<level);
+		end=min(triangleCount, begin+((size_t)TREE_LEAF_TRIANGLES<<level));
+	}
+	//1 if the box of the cluster lies in the positive half space of the plane, -1 if in the negative one, 0 if the plane crosses it.
+	static int ClusterSide(const TriangleCluster & cluster, glm::vec3 planeNormal, glm::vec3 planePoint)
+	{
+		glm::vec3 center=(cluster.boxMin+cluster.boxMax)*0.5f;
+		glm::vec3 halfSize=(cluster.boxMax-cluster.boxMin)*0.5f;
+		float distance=glm::dot(planeNormal, center-planePoint);
+		float radius=glm::dot(glm::abs(planeNormal), halfSize);
+		if(distance>radius)
+			return 1;
+		if(distance<-radius)
+			return -1;
+		return 0;
+	}
+
+private:
+	//All clusters, level by level; the clusters of level l are the ones in [levelOffsets[l], levelOffsets[l+1]).
+	vector<TriangleCluster> clusters;
+	vector<size_t> levelOffsets;
+	size_t triangleCount;
+
+	//Spreads the lowest 10 bits of x, so that there are two zero bits between each of them.
+	static uint32_t SpreadBits(uint32_t x)
+	{
+		x=(x | (x<<16)) & 0x030000FF;
+		x=(x | (x<<8)) & 0x0300F00F;
+		x=(x | (x<<4)) & 0x030C30C3;
+		x=(x | (x<<2)) & 0x09249249;
+		return x;
+	}
+	//Sorts the triangles by the Morton code of their centers, quantised to 10 bits per axis inside the box of the centers;
+	//equal codes keep the original order.
+	void SortTriangles(const Vertex* vertices, unsigned int* indices, int* twins)
+	{
+		vector<glm::vec3> centers(triangleCount);
+		glm::vec3 centersMin(0.0f), centersMax(0.0f);
+		for(size_t t=0;t<triangleCount;t++)
+		{
+			centers[t]=(vertices[indices[3*t]].Position+vertices[indices[3*t+1]].Position+vertices[indices[3*t+2]].Position)/3.0f;
+			centersMin=t==0? centers[t] : glm::min(centersMin, centers[t]);
+			centersMax=t==0? centers[t] : glm::max(centersMax, centers[t]);
+		}
+		glm::vec3 scale=1023.0f/glm::max(centersMax-centersMin, glm::vec3(1e-20f));
+		vector<uint64_t> keys(triangleCount);
+		for(size_t t=0;t<triangleCount;t++)
+		{
+			glm::vec3 cell=(centers[t]-centersMin)*scale;
+			uint32_t code=(SpreadBits((uint32_t)cell.x)<<2) | (SpreadBits((uint32_t)cell.y)<<1) | SpreadBits((uint32_t)cell.z);
+			keys[t]=((uint64_t)code<<32) | t;
+		}
+		sort(keys.begin(), keys.end());
+
+		//New position of each triangle.
+		vector<size_t> positions(triangleCount);
+		for(size_t i=0;i<triangleCount;i++)
+			positions[(size_t)(keys[i] & 0xFFFFFFFFu)]=i;
+		vector<unsigned int> sortedIndices(indices, indices+triangleCount*3);
+		vector<int> sortedTwins;
+		if(twins)
+			sortedTwins.assign(twins, twins+triangleCount*3);
+		for(size_t t=0;t<triangleCount;t++)
+		{
+			for(size_t k=0;k<3;k++)
+			{
+				size_t h=3*positions[t]+k;
+				indices[h]=sortedIndices[3*t+k];
+				if(!twins)
+					continue;
+				int twin=sortedTwins[3*t+k];
+				twins[h]=twin<0? -1 : (int)(3*positions[twin/3]+twin%3);
+			}
+		}
+	}
+};
@@ -0,0 +1,275 @@
+/*
+PolygonTriangulator class:
+This class triangulates the section of a cut by ear clipping. The input is a set of closed loops lying on a plane, given in
+2D coordinates: the loops wound like the largest one are outer boundaries (islands), the ones wound the opposite way are holes,
+each belonging to the smallest boundary that contains it.
+Each hole is first joined to its boundary by a bridge, a pair of coincident edges walked in opposite directions, so that the
+boundary and its holes become a single polygon; then ears are clipped from it one by one. An ear is a convex vertex whose
+triangle with its two neighbours contains no other vertex of the polygon; only reflex vertices can lie inside it, so convex ones
+are not tested. Sections are usually convex or nearly so, and then most vertices are ears at the first attempt.
+The triangles are wound like the outer boundaries.
+*/
+
+#pragma once
+
+using namespace std;
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <glm/glm.hpp>
+
+class PolygonTriangulator
+{
+public:
+	//Loop l is made of points[loopStarts[l]] to points[loopStarts[l+1]-1], in order. The triangles are appended to triangles,
+	//as triples of indices of points.
+	void Triangulate(const vector<glm::vec2> & points, const vector<unsigned int> & loopStarts, vector<unsigned int> & triangles)
+	{
+		unsigned int loopCount=loopStarts.size()-1;
+		loopAreas.resize(loopCount);
+		unsigned int largest=0;
+		for(unsigned int l=0;l<loopCount;l++)
+		{
+			loopAreas[l]=0.0f;
+			for(unsigned int i=loopStarts[l];i<loopStarts[l+1];i++)
+			{
+				unsigned int next=i+1<loopStarts[l+1]? i+1 : loopStarts[l];
+				loopAreas[l]+=Cross(points[i], points[next]);
+			}
+			loopAreas[l]*=0.5f;
+			if(fabs(loopAreas[l])>fabs(loopAreas[largest]))
+				largest=l;
+		}
+		if(loopCount==0 || loopAreas[largest]==0.0f)
+			return;
+		//The polygons are clipped counterclockwise: if the boundaries are clockwise, the y axis is flipped.
+		float flip=loopAreas[largest]>0.0f? 1.0f : -1.0f;
+		coordinates.resize(points.size());
+		for(unsigned int i=0;i<points.size();i++)
+			coordinates[i]=glm::vec2(points[i].x, points[i].y*flip);
+
+		//Each hole goes to the smallest boundary containing its first point; holes outside all boundaries are dropped.
+		holeOwners.assign(loopCount, -1);
+		for(unsigned int h=0;h<loopCount;h++)
+		{
+			if(loopAreas[h]*flip>=0.0f)
+				continue;
+			for(unsigned int l=0;l<loopCount;l++)
+			{
+				if(loopAreas[l]*flip<=0.0f || (holeOwners[h]>=0 && fabs(loopAreas[l])>=fabs(loopAreas[holeOwners[h]])))
+					continue;
+				if(LoopContains(loopStarts, l, coordinates[loopStarts[h]]))
+					holeOwners[h]=l;
+			}
+		}
+
+		for(unsigned int l=0;l<loopCount;l++)
+		{
+			if(loopAreas[l]*flip<=0.0f)
+				continue;
+			nodes.clear();
+			int start=AddLoop(loopStarts, l);
+			//Holes are bridged from the rightmost one, so that the bridges don't cross each other.
+			holes.clear();
+			for(unsigned int h=0;h<loopCount;h++)
+				if(holeOwners[h]==(int)l)
+					holes.push_back(AddLoop(loopStarts, h));
+			for(unsigned int i=0;i<holes.size();i++)
+				holes[i]=Rightmost(holes[i]);
+			sort(holes.begin(), holes.end(), [this](int a, int b) { return Position(a).x>Position(b).x; });
+			for(unsigned int i=0;i<holes.size();i++)
+				start=BridgeHole(holes[i], start);
+			ClipEars(start, triangles);
+		}
+	}
+
+private:
+	//Vertex of the polygon being clipped, in a circular doubly linked list.
+	struct Node
+	{
+		unsigned int point;
+		int previous;
+		int next;
+	};
+
+	vector<glm::vec2> coordinates;
+	vector<float> loopAreas;
+	vector<int> holeOwners;
+	vector<int> holes;
+	vector<Node> nodes;
+
+	static float Cross(glm::vec2 a, glm::vec2 b)
+	{
+		return a.x*b.y-a.y*b.x;
+	}
+	//Twice the signed area of the triangle a, b, c: positive if it is counterclockwise.
+	static float Area(glm::vec2 a, glm::vec2 b, glm::vec2 c)
+	{
+		return Cross(b-a, c-a);
+	}
+	//Whether p lies inside the counterclockwise triangle a, b, c or on its border.
+	static bool InTriangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 p)
+	{
+		return Area(a, b, p)>=0.0f && Area(b, c, p)>=0.0f && Area(c, a, p)>=0.0f;
+	}
+	glm::vec2 Position(int node) const
+	{
+		return coordinates[nodes[node].point];
+	}
+	//Even-odd test of the point against the given loop.
+	bool LoopContains(const vector<unsigned int> & loopStarts, unsigned int l, glm::vec2 point) const
+	{
+		bool inside=false;
+		for(unsigned int i=loopStarts[l];i<loopStarts[l+1];i++)
+		{
+			glm::vec2 a=coordinates[i];
+			glm::vec2 b=coordinates[i+1<loopStarts[l+1]? i+1 : loopStarts[l]];
+			if((a.y>point.y)!=(b.y>point.y) && point.x<a.x+(point.y-a.y)*(b.x-a.x)/(b.y-a.y))
+				inside=!inside;
+		}
+		return inside;
+	}
+	//Adds the loop to the nodes as a circular list, returning its first node.
+	int AddLoop(const vector<unsigned int> & loopStarts, unsigned int l)
+	{
+		int first=nodes.size();
+		int count=loopStarts[l+1]-loopStarts[l];
+		for(int i=0;i<count;i++)
+		{
+			Node node;
+			node.point=loopStarts[l]+i;
+			node.previous=first+(i+count-1)%count;
+			node.next=first+(i+1)%count;
+			nodes.push_back(node);
+		}
+		return first;
+	}
+	int Rightmost(int start) const
+	{
+		int rightmost=start;
+		for(int node=nodes[start].next;node!=start;node=nodes[node].next)
+			if(Position(node).x>Position(rightmost).x)
+				rightmost=node;
+		return rightmost;
+	}
+	//Joins the hole, starting from its rightmost node, to the polygon: a horizontal ray is cast towards the right, and the hole
+	//is bridged to the end of the nearest edge it hits, or to the reflex vertex closest to the ray that hides it.
+	//The node of the polygon and the one of the hole are duplicated, so the bridge is walked once in each direction.
+	int BridgeHole(int hole, int start)
+	{
+		glm::vec2 m=Position(hole);
+		int bridge=-1;
+		float nearest=0.0f;
+		glm::vec2 hit;
+		int node=start;
+		do
+		{
+			int next=nodes[node].next;
+			glm::vec2 a=Position(node);
+			glm::vec2 b=Position(next);
+			if(a.y!=b.y && (a.y<=m.y)==(b.y>=m.y))
+			{
+				float x=a.x+(m.y-a.y)*(b.x-a.x)/(b.y-a.y);
+				if(x>=m.x && (bridge<0 || x<nearest))
+				{
+					nearest=x;
+					hit=glm::vec2(x, m.y);
+					bridge=a.x>b.x? node : next;
+				}
+			}
+			node=next;
+		}
+		while(node!=start);
+		if(bridge<0)
+			return start;
+		//Reflex vertices inside the triangle between the hole, the hit and the chosen end would hide it: the one closest in angle
+		//to the ray is visible.
+		glm::vec2 end=Position(bridge);
+		glm::vec2 a=m, b=hit, c=end;
+		if(Area(a, b, c)<0.0f)
+			swap(b, c);
+		float bestCos=-2.0f;
+		node=start;
+		do
+		{
+			glm::vec2 p=Position(node);
+			if(node!=bridge && p!=m && p!=end && Area(Position(nodes[node].previous), p, Position(nodes[node].next))<=0.0f && InTriangle(a, b, c, p))
+			{
+				glm::vec2 direction=p-m;
+				float cosine=direction.x/glm::length(direction);
+				if(cosine>bestCos)
+				{
+					bestCos=cosine;
+					bridge=node;
+				}
+			}
+			node=nodes[node].next;
+		}
+		while(node!=start);
+
+		int holeCopy=nodes.size();
+		int bridgeCopy=holeCopy+1;
+		Node holeNode=nodes[hole];
+		Node bridgeNode=nodes[bridge];
+		nodes.push_back(holeNode);
+		nodes.push_back(bridgeNode);
+		//bridge -> hole ... (around the hole) ... -> holeCopy -> bridgeCopy -> the node after bridge
+		int holePrevious=nodes[hole].previous;
+		int bridgeNext=nodes[bridge].next;
+		nodes[bridge].next=hole;
+		nodes[hole].previous=bridge;
+		nodes[holePrevious].next=holeCopy;
+		nodes[holeCopy].previous=holePrevious;
+		nodes[holeCopy].next=bridgeCopy;
+		nodes[bridgeCopy].previous=holeCopy;
+		nodes[bridgeCopy].next=bridgeNext;
+		nodes[bridgeNext].previous=bridgeCopy;
+		return start;
+	}
+	bool IsEar(int node) const
+	{
+		glm::vec2 a=Position(nodes[node].previous);
+		glm::vec2 b=Position(node);
+		glm::vec2 c=Position(nodes[node].next);
+		if(Area(a, b, c)<=0.0f)
+			return false;
+		for(int other=nodes[nodes[node].next].next;other!=nodes[node].previous;other=nodes[other].next)
+		{
+			glm::vec2 p=Position(other);
+			if(p==a || p==b || p==c)
+				continue;
+			if(Area(Position(nodes[other].previous), p, Position(nodes[other].next))<=0.0f && InTriangle(a, b, c, p))
+				return false;
+		}
+		return true;
+	}
+	//Clips the ears of the polygon starting at the given node. If no ear is left (the polygon is degenerate, or it intersects
+	//itself), a vertex is clipped anyway, so the section is always closed.
+	void ClipEars(int node, vector<unsigned int> & triangles)
+	{
+		int count=1;
+		for(int other=nodes[node].next;other!=node;other=nodes[other].next)
+			count++;
+		int attempts=0;
+		while(count>2)
+		{
+			if(count>3 && attempts<count && !IsEar(node))
+			{
+				node=nodes[node].next;
+				attempts++;
+				continue;
+			}
+			int previous=nodes[node].previous;
+			int next=nodes[node].next;
+			triangles.push_back(nodes[previous].point);
+			triangles.push_back(nodes[node].point);
+			triangles.push_back(nodes[next].point);
+			nodes[previous].next=next;
+			nodes[next].previous=previous;
+			count--;
+			attempts=0;
+			node=next;
+		}
+	}
+};
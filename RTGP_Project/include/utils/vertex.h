@@ -1,62 +1,118 @@
+/*
+Vertex class:
+The vertex of a mesh, in the layout uploaded to the gpu: 20 bytes instead of the 56 of five float vectors.
+The position is kept in floats, since the cuts compute and compare positions; the normal is encoded in two 16 bit values by
+the octahedral mapping (the unit sphere is projected on an octahedron, whose lower half is folded over the upper one), and the
+texture coordinates are two half floats. The tangent frame is not stored: no shader reads it.
+*/
+
 #pragma once
+#include<stdint.h>
+#include<math.h>
 #include<glm/glm.hpp>
 #include<unordered_map>
 
-class HalfEdge;
+//Attributes of a mesh besides the position, as a mask chosen when the mesh is loaded: the cuts interpolate only these ones,
+//and leave the others null.
+#define VERTEX_NORMAL 1u
+#define VERTEX_TEXCOORDS 2u
+#define VERTEX_ALL_ATTRIBUTES (VERTEX_NORMAL | VERTEX_TEXCOORDS)
+
 class Vertex {
 public:
     // vertex coordinates
     glm::vec3 Position;
-    // Normal
-    glm::vec3 Normal;
-    // Texture coordinates
-    glm::vec2 TexCoords;
-    // Tangent
-    glm::vec3 Tangent;
-    // Bitangent
-    glm::vec3 Bitangent;
+    // Normal, octahedral encoded: two snorm 16 bit values (see SetNormal)
+    uint32_t PackedNormal;
+    // Texture coordinates, as two half floats
+    uint32_t PackedTexCoords;
 	
 	Vertex(){}
 
-    Vertex(glm::vec3 Position, glm::vec3 Normal, glm::vec2 TexCoords, glm::vec3 Tangent, glm::vec3 Bitangent)
+    Vertex(glm::vec3 Position, glm::vec3 Normal, glm::vec2 TexCoords)
     {
         this->Position=Position;
-        this->Normal=Normal;
-        this->TexCoords=TexCoords;
-        this->Tangent=Tangent;
-        this->Bitangent=Bitangent;
+        SetNormal(Normal);
+        SetTexCoords(TexCoords);
     }
 
-	float PositiveOrNegativeSide(glm::vec3 planeNormal, glm::vec3 planePoint)
+	//The normal does not need to be normalised; a null normal is decoded as (0, 0, 1).
+	void SetNormal(glm::vec3 normal)
+	{
+		float length=fabs(normal.x)+fabs(normal.y)+fabs(normal.z);
+		glm::vec2 encoded(0.0f);
+		if(length>0.0f)
+		{
+			encoded=glm::vec2(normal.x, normal.y)/length;
+			if(normal.z<0.0f)
+				encoded=glm::vec2((1.0f-fabs(encoded.y))*SignNotZero(encoded.x), (1.0f-fabs(encoded.x))*SignNotZero(encoded.y));
+		}
+		PackedNormal=glm::packSnorm2x16(encoded);
+	}
+	//Unit normal; the same decoding is done by the vertex shaders.
+	glm::vec3 GetNormal() const
+	{
+		glm::vec2 encoded=glm::unpackSnorm2x16(PackedNormal);
+		glm::vec3 normal(encoded.x, encoded.y, 1.0f-fabs(encoded.x)-fabs(encoded.y));
+		float fold=glm::max(-normal.z, 0.0f);
+		normal.x+=normal.x>=0.0f? -fold : fold;
+		normal.y+=normal.y>=0.0f? -fold : fold;
+		return glm::normalize(normal);
+	}
+	void SetTexCoords(glm::vec2 texCoords)
+	{
+		PackedTexCoords=glm::packHalf2x16(texCoords);
+	}
+	glm::vec2 GetTexCoords() const
+	{
+		return glm::unpackHalf2x16(PackedTexCoords);
+	}
+	//The vertex at the given fraction of the segment from a to b. Only the given attributes are decoded and interpolated, so
+	//each mask compiles to a loop that doesn't touch the others.
+	template<unsigned int Attributes>
+	static Vertex Interpolate(const Vertex & a, const Vertex & b, float intFactor)
+	{
+		Vertex vertex;
+		vertex.Position=b.Position*intFactor+a.Position*(1.0f-intFactor);
+		vertex.PackedNormal=0;
+		vertex.PackedTexCoords=0;
+		if(Attributes & VERTEX_NORMAL)
+			vertex.SetNormal(b.GetNormal()*intFactor+a.GetNormal()*(1.0f-intFactor));
+		if(Attributes & VERTEX_TEXCOORDS)
+			vertex.SetTexCoords(b.GetTexCoords()*intFactor+a.GetTexCoords()*(1.0f-intFactor));
+		return vertex;
+	}
+	//The same, with the mask known only at runtime.
+	static Vertex Interpolate(const Vertex & a, const Vertex & b, float intFactor, unsigned int attributes)
+	{
+		switch(attributes & VERTEX_ALL_ATTRIBUTES)
+		{
+			case VERTEX_NORMAL:
+				return Interpolate<VERTEX_NORMAL>(a, b, intFactor);
+			case VERTEX_TEXCOORDS:
+				return Interpolate<VERTEX_TEXCOORDS>(a, b, intFactor);
+			case VERTEX_ALL_ATTRIBUTES:
+				return Interpolate<VERTEX_ALL_ATTRIBUTES>(a, b, intFactor);
+			default:
+				return Interpolate<0>(a, b, intFactor);
+		}
+	}
+
+	float PositiveOrNegativeSide(glm::vec3 planeNormal, glm::vec3 planePoint) const
 	{
-		glm::vec3 vertexToCutPlane=glm::vec3(Position.x-planePoint.x, Position.y-planePoint.y, 0);
+		glm::vec3 vertexToCutPlane=Position-planePoint;
 		return glm::dot(planeNormal, vertexToCutPlane);
 	}
 	
   	bool Equals(Vertex other)
   	{
 		float epsilon=0.001f;
-		glm::vec3 otherPosition=other.Position;
-		float deltaX=fabs(Position.x-otherPosition.x);
-		float deltaY=fabs(Position.y-otherPosition.y);
-		float deltaZ=fabs(Position.z-otherPosition.z);
-		float deltaXNormal=fabs(Normal.x-other.Normal.x);
-		float deltaYNormal=fabs(Normal.y-other.Normal.y);
-		float deltaZNormal=fabs(Normal.z-other.Normal.z);
-		float deltaU=fabs(TexCoords.x-other.TexCoords.x);
-		float deltaV=fabs(TexCoords.y-other.TexCoords.y);
-		float deltaXTangent=fabs(Tangent.x-other.Tangent.x);
-		float deltaYTangent=fabs(Tangent.y-other.Tangent.y);
-		float deltaZTangent=fabs(Tangent.z-other.Tangent.z);
-		float deltaXBitangent=fabs(Bitangent.x-other.Bitangent.x);
-		float deltaYBitangent=fabs(Bitangent.y-other.Bitangent.y);
-		float deltaZBitangent=fabs(Bitangent.z-other.Bitangent.z);
-
-		return (deltaX<=epsilon) && (deltaY<=epsilon) && (deltaZ<=epsilon) &&
-				(deltaXNormal<=epsilon) && (deltaYNormal<=epsilon) && (deltaZNormal<=epsilon) &&
-				(deltaU<=epsilon) && (deltaV<=epsilon) &&
-				(deltaXTangent<=epsilon) && (deltaYTangent<=epsilon) && (deltaZTangent<=epsilon) &&
-				(deltaXBitangent<=epsilon) && (deltaYBitangent<=epsilon) && (deltaZBitangent<=epsilon);
+		glm::vec3 deltaPosition=glm::abs(Position-other.Position);
+		glm::vec3 deltaNormal=glm::abs(GetNormal()-other.GetNormal());
+		glm::vec2 deltaTexCoords=glm::abs(GetTexCoords()-other.GetTexCoords());
+		return (deltaPosition.x<=epsilon) && (deltaPosition.y<=epsilon) && (deltaPosition.z<=epsilon) &&
+				(deltaNormal.x<=epsilon) && (deltaNormal.y<=epsilon) && (deltaNormal.z<=epsilon) &&
+				(deltaTexCoords.x<=epsilon) && (deltaTexCoords.y<=epsilon);
   	}
 	
 	
@@ -68,4 +124,27 @@ public:
 		float deltaZ=fabs(Position.z-other.Position.z);
 		return (deltaX<=epsilon) && (deltaY<=epsilon) && (deltaZ<=epsilon);
     }
+
+private:
+	static float SignNotZero(float x)
+	{
+		return x>=0.0f? 1.0f : -1.0f;
+	}
 };
+
+static_assert(sizeof(Vertex)==20, "Vertex must match the attribute layout of Mesh");
+
+namespace std
+{
+	template<>
+	struct hash<glm::vec3>
+	{
+		size_t operator()(const glm::vec3& v) const
+		{
+			size_t seed=std::hash<float>{}(v.x);
+			seed^=std::hash<float>{}(v.y)+0x9e3779b9+(seed<<6)+(seed>>2);
+			seed^=std::hash<float>{}(v.z)+0x9e3779b9+(seed<<6)+(seed>>2);
+			return seed;
+		}
+	};
+}